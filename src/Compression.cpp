@@ -0,0 +1,88 @@
+#include "Compression.h"
+
+#if defined(HAS_ZLIB) && defined(_MSC_VER)
+#pragma comment(lib, "zlib.lib")
+#endif
+
+#ifdef HAS_ZLIB
+
+static const size_t OUTPUT_CHUNK_SIZE = 16384;
+
+bool isCompressionAvailable() { return true; }
+
+StreamCompressor::StreamCompressor() {
+  _isReady = deflateInit(&_stream, Z_DEFAULT_COMPRESSION) == Z_OK;
+}
+
+StreamCompressor::~StreamCompressor() {
+  if (_isReady) deflateEnd(&_stream);
+}
+
+bool StreamCompressor::compress(const char *data, size_t length,
+                                std::string &output) {
+  if (!_isReady) return false;
+
+  _stream.next_in = reinterpret_cast<Bytef *>(const_cast<char *>(data));
+  _stream.avail_in = static_cast<uInt>(length);
+
+  // Keep going until deflate() stops filling the output completely.
+  do {
+    const auto oldSize = output.size();
+    output.resize(oldSize + OUTPUT_CHUNK_SIZE);
+    _stream.next_out = reinterpret_cast<Bytef *>(&output[oldSize]);
+    _stream.avail_out = static_cast<uInt>(OUTPUT_CHUNK_SIZE);
+
+    const auto result = deflate(&_stream, Z_SYNC_FLUSH);
+    output.resize(output.size() - _stream.avail_out);
+    if (result == Z_STREAM_ERROR) return false;
+  } while (_stream.avail_out == 0);
+
+  return true;
+}
+
+StreamDecompressor::StreamDecompressor() {
+  _isReady = inflateInit(&_stream) == Z_OK;
+}
+
+StreamDecompressor::~StreamDecompressor() {
+  if (_isReady) inflateEnd(&_stream);
+}
+
+bool StreamDecompressor::decompress(const char *data, size_t length,
+                                    std::string &output) {
+  if (!_isReady) return false;
+
+  _stream.next_in = reinterpret_cast<Bytef *>(const_cast<char *>(data));
+  _stream.avail_in = static_cast<uInt>(length);
+
+  do {
+    const auto oldSize = output.size();
+    output.resize(oldSize + OUTPUT_CHUNK_SIZE);
+    _stream.next_out = reinterpret_cast<Bytef *>(&output[oldSize]);
+    _stream.avail_out = static_cast<uInt>(OUTPUT_CHUNK_SIZE);
+
+    const auto result = inflate(&_stream, Z_SYNC_FLUSH);
+    output.resize(output.size() - _stream.avail_out);
+    if (result != Z_OK && result != Z_BUF_ERROR) return false;
+  } while (_stream.avail_out == 0);
+
+  return true;
+}
+
+#else
+
+bool isCompressionAvailable() { return false; }
+
+StreamCompressor::StreamCompressor() {}
+StreamCompressor::~StreamCompressor() {}
+bool StreamCompressor::compress(const char *, size_t, std::string &) {
+  return false;
+}
+
+StreamDecompressor::StreamDecompressor() {}
+StreamDecompressor::~StreamDecompressor() {}
+bool StreamDecompressor::decompress(const char *, size_t, std::string &) {
+  return false;
+}
+
+#endif
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <string>
+
+// Compression needs zlib's headers and library.  Builds without them still
+// work; they just never ask for, or agree to, compressed connections.
+#ifdef __has_include
+#if __has_include(<zlib.h>)
+#include <zlib.h>
+#define HAS_ZLIB
+#endif
+#endif
+
+bool isCompressionAvailable();
+
+// Deflates an outgoing stream.  Each call ends with a sync flush, so that
+// everything compressed so far can be decompressed as soon as it arrives.
+class StreamCompressor {
+ public:
+  StreamCompressor();
+  ~StreamCompressor();
+  StreamCompressor(const StreamCompressor &) = delete;
+  StreamCompressor &operator=(const StreamCompressor &) = delete;
+
+  // Appends the compressed data to the output.
+  bool compress(const char *data, size_t length, std::string &output);
+
+ private:
+#ifdef HAS_ZLIB
+  z_stream _stream{};
+#endif
+  bool _isReady{false};
+};
+
+// Inflates an incoming stream, which may arrive in pieces of any size.
+class StreamDecompressor {
+ public:
+  StreamDecompressor();
+  ~StreamDecompressor();
+  StreamDecompressor(const StreamDecompressor &) = delete;
+  StreamDecompressor &operator=(const StreamDecompressor &) = delete;
+
+  // Appends the decompressed data to the output.
+  bool decompress(const char *data, size_t length, std::string &output);
+
+ private:
+#ifdef HAS_ZLIB
+  z_stream _stream{};
+#endif
+  bool _isReady{false};
+};
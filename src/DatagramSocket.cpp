@@ -0,0 +1,80 @@
+#include "DatagramSocket.h"
+
+#include <charconv>
+
+#include "messageCodes.h"
+
+bool DatagramSocket::open(u_short port) {
+  close();
+  _raw = socket(AF_INET, SOCK_DGRAM, 0);
+  if (_raw == INVALID_SOCKET) return false;
+
+  auto address = sockaddr_in{};
+  address.sin_family = AF_INET;
+  address.sin_addr.s_addr = INADDR_ANY;
+  address.sin_port = htons(port);
+  if (bind(_raw, (sockaddr *)&address, sizeof(address)) == SOCKET_ERROR) {
+    close();
+    return false;
+  }
+
+  makeSocketNonBlocking(_raw);
+  return true;
+}
+
+void DatagramSocket::close() {
+  if (_raw == INVALID_SOCKET) return;
+  closeRawSocket(_raw);
+  _raw = INVALID_SOCKET;
+}
+
+void DatagramSocket::sendTo(const sockaddr_in &destination,
+                            const std::string &data) const {
+  if (!isOpen()) return;
+  // If it's lost, so be it.
+  sendto(_raw, data.data(), static_cast<int>(data.size()), SOCKET_SEND_FLAGS,
+         (const sockaddr *)&destination, sizeof(destination));
+}
+
+bool DatagramSocket::receive(std::string &data, sockaddr_in &sender) const {
+  if (!isOpen()) return false;
+
+  static const size_t BUFFER_SIZE = 65536;  // The largest possible datagram
+  if (_receiveBuffer.empty()) _receiveBuffer.resize(BUFFER_SIZE);
+  auto senderLength = static_cast<SockAddrLength>(sizeof(sender));
+  const auto length =
+      recvfrom(_raw, _receiveBuffer.data(), static_cast<int>(BUFFER_SIZE), 0,
+               (sockaddr *)&sender, &senderLength);
+  // Errors, e.g. an ICMP "port unreachable" reported by Windows, are treated
+  // as the end of the queue; anything else waiting is read next time.
+  if (length == SOCKET_ERROR) return false;
+  data.assign(_receiveBuffer.data(), static_cast<size_t>(length));
+  return true;
+}
+
+void DatagramHeader::appendTo(std::string &datagram) const {
+  datagram.append(std::to_string(token));
+  datagram.push_back(MSG_DELIM);
+  datagram.append(std::to_string(sequence));
+  datagram.push_back(MSG_DELIM);
+}
+
+bool DatagramHeader::readFrom(const char *&cursor, const char *end) {
+  auto result = std::from_chars(cursor, end, token);
+  if (result.ec != std::errc{} || result.ptr == end ||
+      *result.ptr != MSG_DELIM)
+    return false;
+
+  result = std::from_chars(result.ptr + 1, end, sequence);
+  if (result.ec != std::errc{} || result.ptr == end ||
+      *result.ptr != MSG_DELIM)
+    return false;
+
+  cursor = result.ptr + 1;
+  return true;
+}
+
+bool isSameAddress(const sockaddr_in &lhs, const sockaddr_in &rhs) {
+  return lhs.sin_addr.s_addr == rhs.sin_addr.s_addr &&
+         lhs.sin_port == rhs.sin_port;
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "socketPlatform.h"
+
+// A UDP socket, for frequent updates that are worthless once superseded, e.g.,
+// movement.  Unlike on a TCP stream, one that's lost doesn't hold up the rest.
+// Anything that must arrive is still sent over TCP.
+class DatagramSocket {
+ public:
+  // Comfortably below the MTU of most paths, so datagrams aren't fragmented
+  static const size_t MAX_DATAGRAM_SIZE = 1200;
+
+  DatagramSocket() {}
+  ~DatagramSocket() { close(); }
+  DatagramSocket(const DatagramSocket &) = delete;
+  DatagramSocket &operator=(const DatagramSocket &) = delete;
+
+  // A port of 0 means any.  Returns false if the socket couldn't be opened.
+  bool open(u_short port = 0);
+  void close();
+  bool isOpen() const { return _raw != INVALID_SOCKET; }
+  SOCKET getRaw() const { return _raw; }
+
+  void sendTo(const sockaddr_in &destination, const std::string &data) const;
+  // Non-blocking.  Returns false if there's nothing waiting.  Only one thread
+  // may receive.
+  bool receive(std::string &data, sockaddr_in &sender) const;
+
+ private:
+  SOCKET _raw{INVALID_SOCKET};
+  // Large enough for any datagram, and kept so that it's allocated only once
+  mutable std::vector<char> _receiveBuffer;
+};
+
+// Each datagram begins with a header, then contains whole messages.  From a
+// client, the token identifies the user, having been given to them over TCP.
+// Sequence numbers increase with each datagram, so that one arriving after a
+// later one can be discarded.
+struct DatagramHeader {
+  uint64_t token{0};
+  uint32_t sequence{0};
+
+  void appendTo(std::string &datagram) const;
+  // On success, moves the cursor past the header.
+  bool readFrom(const char *&cursor, const char *end);
+
+  // Allowing for wrap-around
+  static bool isNewer(uint32_t sequence, uint32_t than) {
+    return static_cast<int32_t>(sequence - than) > 0;
+  }
+};
+
+bool isSameAddress(const sockaddr_in &lhs, const sockaddr_in &rhs);
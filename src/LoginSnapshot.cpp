@@ -0,0 +1,195 @@
+#include "LoginSnapshot.h"
+
+#include "Message.h"
+#include "MessageParser.h"
+#include "MessageSchema.h"
+#include "util.h"
+
+namespace {
+class ArgWriter {
+ public:
+  template <typename T>
+  ArgWriter &operator<<(const T &arg) {
+    if (_hasArgs) _args.push_back(MSG_DELIM);
+    appendArg(_args, arg);
+    _hasArgs = true;
+    return *this;
+  }
+  std::string str() const { return _args; }
+
+ private:
+  std::string _args;
+  bool _hasArgs{false};
+};
+
+// Every element takes at least a delimiter, so a count can't exceed what's
+// left of the message.
+bool readCount(MessageParser &parser, size_t &count) {
+  return parser.readNextArg(count) && count <= parser.restOfMessage().size();
+}
+
+void writeItems(ArgWriter &args,
+                const std::vector<LoginSnapshot::Item> &items) {
+  args << items.size();
+  for (const auto &item : items)
+    args << item.slot << item.id << item.quantity << item.health
+         << (item.isSoulbound ? 1 : 0) << item.suffix;
+}
+
+bool readItems(MessageParser &parser, std::vector<LoginSnapshot::Item> &items) {
+  auto count = size_t{0};
+  if (!readCount(parser, count)) return false;
+  items.resize(count);
+  for (auto &item : items) {
+    auto isSoulbound = 0;
+    if (!parser.readNextArg(item.slot) || !parser.readNextArg(item.id) ||
+        !parser.readNextArg(item.quantity) ||
+        !parser.readNextArg(item.health) || !parser.readNextArg(isSoulbound) ||
+        !parser.readNextArg(item.suffix))
+      return false;
+    item.isSoulbound = isSoulbound != 0;
+  }
+  return true;
+}
+
+void writeIDs(ArgWriter &args, const std::vector<std::string> &ids) {
+  args << ids.size();
+  for (const auto &id : ids) args << id;
+}
+
+bool readIDs(MessageParser &parser, std::vector<std::string> &ids) {
+  auto count = size_t{0};
+  if (!readCount(parser, count)) return false;
+  ids.resize(count);
+  for (auto &id : ids)
+    if (!parser.readNextArg(id)) return false;
+  return true;
+}
+
+template <typename T>
+void writePairs(ArgWriter &args, const T &pairs) {
+  args << pairs.size();
+  for (const auto &pair : pairs) args << pair.first << pair.second;
+}
+
+template <typename T>
+bool readPairs(MessageParser &parser, T &pairs) {
+  auto count = size_t{0};
+  if (!readCount(parser, count)) return false;
+  pairs.resize(count);
+  for (auto &pair : pairs)
+    if (!parser.readNextArg(pair.first) || !parser.readNextArg(pair.second))
+      return false;
+  return true;
+}
+}  // namespace
+
+void LoginSnapshot::exploration(const ExplorationMap &map) {
+  _explorationWidth = map.size();
+  _explorationHeight = map.empty() ? 0 : map.front().size();
+  _explorationRuns.clear();
+
+  auto currentRunIsExplored = false;
+  auto currentRunLength = size_t{0};
+  for (const auto &column : map)
+    for (auto isExplored : column) {
+      if (isExplored != currentRunIsExplored) {
+        _explorationRuns.push_back(currentRunLength);
+        currentRunIsExplored = isExplored;
+        currentRunLength = 0;
+      }
+      ++currentRunLength;
+    }
+  _explorationRuns.push_back(currentRunLength);
+}
+
+LoginSnapshot::ExplorationMap LoginSnapshot::exploration() const {
+  auto map = ExplorationMap(_explorationWidth,
+                            std::vector<bool>(_explorationHeight, false));
+  if (_explorationHeight == 0) return map;
+
+  auto chunkIndex = size_t{0};
+  auto isExplored = false;
+  const auto numChunks = _explorationWidth * _explorationHeight;
+  for (auto runLength : _explorationRuns) {
+    for (auto i = size_t{0}; i != runLength && chunkIndex < numChunks; ++i) {
+      if (isExplored)
+        map[chunkIndex / _explorationHeight][chunkIndex % _explorationHeight] =
+            true;
+      ++chunkIndex;
+    }
+    isExplored = !isExplored;
+  }
+  return map;
+}
+
+Message LoginSnapshot::toMessage() const {
+  auto args = ArgWriter{};
+  args << VERSION;
+
+  writeItems(args, inventory);
+  writeItems(args, gear);
+
+  writeIDs(args, recipes);
+  writeIDs(args, constructions);
+  writeIDs(args, spells);
+
+  writePairs(args, talentRanks);
+  writePairs(args, pointsInTrees);
+
+  args << quests.size();
+  for (const auto &quest : quests) {
+    args << quest.id << (quest.canBeFinished ? 1 : 0);
+    writePairs(args, quest.progress);
+  }
+
+  args << _explorationWidth << _explorationHeight;
+  args << _explorationRuns.size();
+  for (auto runLength : _explorationRuns) args << runLength;
+
+  return {SV_LOGIN_SNAPSHOT, args.str()};
+}
+
+bool LoginSnapshot::readFrom(MessageParser &parser) {
+  auto version = 0;
+  if (!parser.readNextArg(version) || version != VERSION) return false;
+
+  if (!readItems(parser, inventory) || !readItems(parser, gear)) return false;
+
+  if (!readIDs(parser, recipes) || !readIDs(parser, constructions) ||
+      !readIDs(parser, spells))
+    return false;
+
+  if (!readPairs(parser, talentRanks) || !readPairs(parser, pointsInTrees))
+    return false;
+
+  auto numQuests = size_t{0};
+  if (!readCount(parser, numQuests)) return false;
+  quests.resize(numQuests);
+  for (auto &quest : quests) {
+    auto canBeFinished = 0;
+    if (!parser.readNextArg(quest.id) || !parser.readNextArg(canBeFinished) ||
+        !readPairs(parser, quest.progress))
+      return false;
+    quest.canBeFinished = canBeFinished != 0;
+  }
+
+  auto numRuns = size_t{0};
+  if (!parser.readNextArg(_explorationWidth) ||
+      !parser.readNextArg(_explorationHeight) || !readCount(parser, numRuns))
+    return false;
+  _explorationRuns.resize(numRuns);
+  for (auto &runLength : _explorationRuns)
+    if (!parser.readNextArg(runLength)) return false;
+
+  return parser.hasReadAllArgs();
+}
+
+Message MessageSchema<SV_LOGIN_SNAPSHOT>::build(const LoginSnapshot &snapshot) {
+  return snapshot.toMessage();
+}
+
+bool MessageSchema<SV_LOGIN_SNAPSHOT>::read(MessageParser &parser,
+                                            LoginSnapshot &snapshot) {
+  return snapshot.readFrom(parser);
+}
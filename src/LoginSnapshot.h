@@ -0,0 +1,59 @@
+#pragma once
+
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "combatTypes.h"
+
+struct Message;
+class MessageParser;
+
+// What a user knows about themselves on logging in, gathered into a single
+// SV_LOGIN_SNAPSHOT rather than a message per item, recipe, talent and map
+// column.  The server builds it once, and the client applies it all at once.
+//
+// The arguments are the version, then each section in turn.  Every list is
+// preceded by its length.
+struct LoginSnapshot {
+  // To be bumped whenever the layout changes
+  static constexpr int VERSION = 1;
+
+  struct Item {
+    size_t slot{0};
+    std::string id;
+    size_t quantity{0};
+    Hitpoints health{0};
+    bool isSoulbound{false};
+    std::string suffix;
+  };
+  std::vector<Item> inventory, gear;  // Occupied slots only
+
+  std::vector<std::string> recipes, constructions, spells;
+
+  using NamedValues = std::vector<std::pair<std::string, int> >;
+  NamedValues talentRanks, pointsInTrees;
+
+  struct QuestState {
+    std::string id;
+    bool canBeFinished{false};
+    std::vector<std::pair<size_t, int> > progress;  // By objective index
+  };
+  std::vector<QuestState> quests;
+
+  // Chunks explored, column by column
+  using ExplorationMap = std::vector<std::vector<bool> >;
+  void exploration(const ExplorationMap &map);
+  ExplorationMap exploration() const;
+
+  Message toMessage() const;
+  // From the arguments of SV_LOGIN_SNAPSHOT.  Fails if they are malformed, or
+  // from another version.
+  bool readFrom(MessageParser &parser);
+
+ private:
+  // Alternating runs of unexplored and explored chunks, starting with
+  // unexplored, in column-major order.  Most of the map is one or the other.
+  size_t _explorationWidth{0}, _explorationHeight{0};
+  std::vector<size_t> _explorationRuns;
+};
@@ -1,6 +1,132 @@
 #include "Message.h"
 
+#include "util.h"
+
+static void appendNumber(std::string &buffer, int number) {
+  if (number < 0) {
+    buffer.push_back('-');
+    number = -number;
+  }
+  char digits[12];
+  auto numDigits = 0;
+  do {
+    digits[numDigits++] = '0' + number % 10;
+    number /= 10;
+  } while (number > 0);
+  while (numDigits > 0) buffer.push_back(digits[--numDigits]);
+}
+
+Message Message::UserLocation(MessageCode code, const std::string &username,
+                              const MapPoint &location) {
+  auto msg = Message{code};
+  msg._isLocation = true;
+  msg._username = username;
+  msg._location = location;
+  return msg;
+}
+
+Message Message::EntityLocation(MessageCode code, Serial serial,
+                                const MapPoint &location) {
+  auto msg = Message{code};
+  msg._isLocation = true;
+  msg._serial = serial;
+  msg._location = location;
+  return msg;
+}
+
+std::string Message::compile() const {
+  auto compiled = std::string{};
+  compiled.reserve(args.size() + 8);
+  appendTo(compiled);
+  return compiled;
+}
+
+void Message::appendTo(std::string &buffer, WireProtocol protocol,
+                       LocationBaselines *baselines) const {
+  if (protocol == BINARY_PROTOCOL) {
+    appendBinaryTo(buffer, baselines);
+    return;
+  }
+
+  buffer.push_back(MSG_START);
+  appendNumber(buffer, code);
+  const auto &argsToAppend = textArgs();
+  if (!argsToAppend.empty()) {
+    buffer.push_back(MSG_DELIM);
+    buffer.append(argsToAppend);
+  }
+  buffer.push_back(MSG_END);
+}
+
+const std::string &Message::textArgs() const {
+  if (!_isLocation) return args;
+
+  if (_formattedLocation.empty()) {
+    if (isUserLocationCode(code))
+      _formattedLocation = makeArgs(_username, _location.x, _location.y);
+    else
+      _formattedLocation = makeArgs(_serial, _location.x, _location.y);
+  }
+  return _formattedLocation;
+}
+
+void Message::appendBinaryTo(std::string &buffer,
+                             LocationBaselines *baselines) const {
+  buffer.push_back(MSG_START_BINARY);
+  const auto bodyStart = buffer.size();
+
+  if (!_isLocation) {
+    appendVarint(buffer, static_cast<size_t>(code) << FRAME_FORM_BITS |
+                             TEXT_ARGS);
+    buffer.append(args);
+  } else {
+    const auto isUser = isUserLocationCode(code);
+    const auto location = QuantizedPoint{_location};
+    auto coordinates = location;
+    auto form = ABSOLUTE_LOCATION;
+    if (baselines) {
+      const auto key = isUser ? LocationBaselines::userKey(_username)
+                              : LocationBaselines::entityKey(_serial.asNumber());
+      if (baselines->shouldSendDelta(key, location, coordinates))
+        form = LOCATION_DELTA;
+    }
+
+    appendVarint(buffer, static_cast<size_t>(code) << FRAME_FORM_BITS | form);
+    if (isUser) {
+      appendVarint(buffer, _username.size());
+      buffer.append(_username);
+    } else
+      appendVarint(buffer, _serial.asNumber());
+    appendCoordinate(buffer, coordinates.x);
+    appendCoordinate(buffer, coordinates.y);
+  }
+
+  // The length goes before the body, but isn't known until it's been written.
+  auto length = std::string{};
+  appendVarint(length, buffer.size() - bodyStart);
+  buffer.insert(bodyStart, length);
+}
+
+SharedMessage SharedMessage::From(const Message &msg) {
+  auto shared = SharedMessage{};
+  shared._message = msg;
+  return shared;
+}
+
+std::shared_ptr<const std::string> SharedMessage::encoded(
+    WireProtocol protocol) const {
+  if (protocol == BINARY_PROTOCOL && _message._isLocation) return {};
+
+  auto &encoding = _encodings[protocol];
+  if (!encoding) {
+    auto buffer = std::string{};
+    _message.appendTo(buffer, protocol);
+    encoding = std::make_shared<const std::string>(std::move(buffer));
+  }
+  return encoding;
+}
+
 std::ostream& operator<<(std::ostream& lhs, const Message& rhs) {
-  lhs << rhs.code << "(" << rhs.args << ")";
+  lhs << rhs.code << "(" << rhs.textArgs() << ")";
   return lhs;
 }
@@ -1,9 +1,14 @@
 #ifndef MESSAGE_H
 #define MESSAGE_H
 
+#include <memory>
 #include <sstream>
 #include <string>
+#include <utility>
 
+#include "Point.h"
+#include "Serial.h"
+#include "WireProtocol.h"
 #include "messageCodes.h"
 
 struct Message {
@@ -13,17 +18,54 @@ struct Message {
   template <typename T>
   Message(MessageCode codeArg, const T& singleArg)
       : code(codeArg), args(toString(singleArg)) {}
-  Message(MessageCode codeArg = NO_CODE, const std::string argsArg = {})
-      : code(codeArg), args(argsArg) {}
+  Message(MessageCode codeArg = NO_CODE, std::string argsArg = {})
+      : code(codeArg), args(std::move(argsArg)) {}
 
-  std::string compile() const {
-    std::ostringstream oss;
-    oss << MSG_START << code;
-    if (args != "") oss << MSG_DELIM << args;
-    oss << MSG_END;
+  // Location updates make up most of the server's traffic.  These keep the
+  // location numeric, so that it's only formatted as text if a recipient
+  // needs it.
+  static Message UserLocation(MessageCode code, const std::string& username,
+                              const MapPoint& location);
+  static Message EntityLocation(MessageCode code, Serial serial,
+                                const MapPoint& location);
 
-    return oss.str();
-  }
+  std::string compile() const;
+  // Append the compiled message to an existing buffer, e.g., an outbound queue.
+  // Given a connection's baselines, binary locations may be sent as deltas.
+  void appendTo(std::string& buffer, WireProtocol protocol = TEXT_PROTOCOL,
+                LocationBaselines* baselines = nullptr) const;
+  const std::string& textArgs() const;
+
+ private:
+  friend class SharedMessage;
+
+  bool _isLocation{false};
+  std::string _username;  // If a user's location
+  Serial _serial;         // If another entity's location
+  MapPoint _location;
+  mutable std::string _formattedLocation;  // Cached, for text recipients
+
+  void appendBinaryTo(std::string& buffer, LocationBaselines* baselines) const;
+};
+
+// A message with many recipients.  It is encoded at most once for each wire
+// protocol, and that encoding is shared, read-only, by every outbound queue it
+// is appended to.  Meant to be used by a single thread, e.g., a broadcast.
+class SharedMessage {
+ public:
+  // Not a constructor, so that sendMessage({...}) still means a Message.
+  static SharedMessage From(const Message& msg);
+  const Message& message() const { return _message; }
+
+  // Null for location messages, whose binary encoding depends on what each
+  // connection has already been sent.
+  std::shared_ptr<const std::string> encoded(WireProtocol protocol) const;
+
+ private:
+  SharedMessage() {}
+
+  Message _message;
+  mutable std::shared_ptr<const std::string> _encodings[2];  // By protocol
 };
 
 std::ostream& operator<<(std::ostream& lhs, const Message& rhs);
@@ -1,9 +1,70 @@
 #include "MessageParser.h"
 
-bool MessageParser::hasAnotherMessage() { return iss.peek() == MSG_START; }
+#include <algorithm>
+
+bool MessageParser::hasAnotherMessage() {
+  if (_messageEnd) {
+    _cursor = _messageEnd + 1;
+    _messageEnd = nullptr;
+  }
+
+  // Discard anything malformed before the next message
+  _cursor = std::find(_cursor, _end, MSG_START);
+  if (_cursor == _end) return false;
+
+  const auto *messageEnd = std::find(_cursor, _end, MSG_END);
+  if (messageEnd == _end) return false;  // Incomplete
+
+  _messageEnd = messageEnd;
+  return true;
+}
 
 MessageCode MessageParser::nextMessage() {
-  auto code = int{};
-  iss >> _delimiter >> code >> _delimiter;
+  ++_cursor;  // Skip MSG_START
+
+  auto code = int{NO_CODE};
+  const auto result = std::from_chars(_cursor, _messageEnd, code);
+  if (result.ec != std::errc{}) code = NO_CODE;
+
+  _delimiter = *result.ptr;
+  _cursor = result.ptr + 1;
   return static_cast<MessageCode>(code);
 }
+
+std::string_view MessageParser::restOfMessage() const {
+  if (!_messageEnd || _cursor > _messageEnd) return {};
+  return {_cursor, static_cast<size_t>(_messageEnd - _cursor + 1)};
+}
+
+bool MessageParser::nextArg(ArgPosition argPosition, std::string_view &arg) {
+  if (_delimiter == MSG_END) return false;  // There are no more
+
+  const auto *argEnd = _messageEnd;
+  if (argPosition != Last) {
+    argEnd = std::find(_cursor, _messageEnd, MSG_DELIM);
+    const auto isTooFewArguments =
+        argEnd == _messageEnd && argPosition == NotLast;
+    if (isTooFewArguments) return false;
+  }
+
+  arg = {_cursor, static_cast<size_t>(argEnd - _cursor)};
+  _delimiter = *argEnd;
+  _cursor = argEnd + 1;
+  return true;
+}
+
+bool MessageParser::parseSingleArg(std::string &arg, ArgPosition argPosition) {
+  auto view = std::string_view{};
+  if (!nextArg(argPosition, view)) return false;
+  arg.assign(view.data(), view.size());
+  return true;
+}
+
+bool MessageParser::parseSingleArg(std::string_view &arg,
+                                   ArgPosition argPosition) {
+  return nextArg(argPosition, arg);
+}
+
+bool MessageParser::parseSingleArg(Serial &arg, ArgPosition argPosition) {
+  return parseSingleArg(arg._raw, argPosition);
+}
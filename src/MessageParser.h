@@ -1,43 +1,76 @@
 #pragma once
 
-#include <sstream>
+#include <charconv>
+#include <streambuf>
+#include <string>
+#include <string_view>
 
+#include "Serial.h"
 #include "messageCodes.h"
 
-// This class manages an input stream containing network Messages, and provides
-// functions to read them.  The number and types of arguments are flexible.
+// This class reads network Messages from a contiguous block of memory, and
+// provides functions to read their arguments.  The number and types of
+// arguments are flexible.  A cursor walks the block: numbers are parsed with
+// std::from_chars, and strings can be viewed rather than copied.  The messages
+// are read in place, and must outlive the parser.
 class MessageParser {
  public:
-  MessageParser(const std::string &input) : iss(input) {}
+  MessageParser(const char *messages, size_t length)
+      : _begin(messages), _cursor(messages), _end(messages + length) {}
 
+  // Moves to the next complete message, skipping any of the current one that
+  // wasn't read.
   bool hasAnotherMessage();
   MessageCode nextMessage();
   char getLastDelimiterRead() const { return _delimiter; }  // TODO: remove
 
-  template <typename T1>
-  bool readArgs(T1 &arg1);
+  // The unread arguments of the current message, up to and including MSG_END
+  std::string_view restOfMessage() const;
+  // Once there are no more messages, anything after this is incomplete.
+  size_t lengthParsed() const { return _cursor - _begin; }
+  // Up to and including the current message, however much of it was read
+  size_t lengthUpToEndOfMessage() const {
+    return _messageEnd ? _messageEnd + 1 - _begin : lengthParsed();
+  }
 
-  template <typename T1, typename T2>
-  bool readArgs(T1 &arg1, T2 &arg2);
-
-  template <typename T1, typename T2, typename T3>
-  bool readArgs(T1 &arg1, T2 &arg2, T3 &arg3);
-
-  template <typename T1, typename T2, typename T3, typename T4>
-  bool readArgs(T1 &arg1, T2 &arg2, T3 &arg3, T4 &arg4);
+  // Each argument is read up to the next MSG_DELIM, except the last, which is
+  // read up to MSG_END.
+  template <typename... Args>
+  bool readArgs(Args &... args);
+  // For lists of unknown length: a single argument, whether or not it's the
+  // last.
+  template <typename T>
+  bool readNextArg(T &arg) {
+    return parseSingleArg(arg, EitherLastOrNot);
+  }
+  bool hasReadAllArgs() const { return _delimiter == MSG_END; }
 
-  std::istringstream iss;  // TODO: make private
+  // A read-only stream view of existing memory, for code that still reads
+  // messages with stream extraction.
+  class ArrayBuffer : public std::streambuf {
+   public:
+    void view(std::string_view data) {
+      auto *begin = const_cast<char *>(data.data());
+      setg(begin, begin, begin + data.size());
+    }
+  };
 
  private:
+  const char *_begin;
+  const char *_cursor;
+  const char *_end;
+  const char *_messageEnd{nullptr};  // The MSG_END of the current message
   char _delimiter{0};
 
-  enum ArgPosition { NotLast, Last };
+  enum ArgPosition { NotLast, Last, EitherLastOrNot };
 
-  template <typename T>
-  void parseSingleArg(T &arg, ArgPosition argPosition);
+  bool nextArg(ArgPosition argPosition, std::string_view &arg);
 
-  template <>
-  void parseSingleArg(std::string &arg, ArgPosition argPosition);
+  template <typename T>
+  bool parseSingleArg(T &arg, ArgPosition argPosition);
+  bool parseSingleArg(std::string &arg, ArgPosition argPosition);
+  bool parseSingleArg(std::string_view &arg, ArgPosition argPosition);
+  bool parseSingleArg(Serial &arg, ArgPosition argPosition);
 };
 
 #include "MessageParser.inl"
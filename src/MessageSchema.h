@@ -0,0 +1,135 @@
+#pragma once
+
+#include "Message.h"
+#include "MessageParser.h"
+#include "util.h"
+
+// The arguments of a message, declared once and shared by the sender and the
+// receiver, so that the two can't disagree about their order or types.
+//
+//   user.sendMessage(MessageSchema<SV_ENTITY_HEALTH>::build(serial, health));
+//   ...
+//   if (!MessageSchema<SV_ENTITY_HEALTH>::read(parser, serial, health)) break;
+//
+// Codes without a declaration below are still built with makeArgs() and read
+// with MessageParser::readArgs().
+template <MessageCode CODE>
+struct MessageSchema;
+
+template <typename... Fields>
+void appendFields(std::string &args, const Fields &... fields) {
+  auto isFirst = true;
+  ((isFirst ? void() : args.push_back(MSG_DELIM), appendArg(args, fields),
+    isFirst = false),
+   ...);
+}
+
+template <MessageCode CODE, typename... Fields>
+struct MessageFields {
+  static const MessageCode code = CODE;
+
+  static Message build(const Fields &... fields) {
+    auto args = std::string{};
+    appendFields(args, fields...);
+    return {CODE, std::move(args)};
+  }
+
+  static bool read(MessageParser &parser, Fields &... fields) {
+    return parser.readArgs(fields...);
+  }
+};
+
+#define DECLARE_MESSAGE_SCHEMA(CODE, ...) \
+  template <>                             \
+  struct MessageSchema<CODE> : MessageFields<CODE, __VA_ARGS__> {}
+
+// Messages whose leading fields are followed by a group of fields repeated
+// any number of times, e.g., one group for each slot that has changed.
+//
+//   auto builder = MessageSchema<SV_INVENTORY>::Builder{serial};
+//   builder.add(slot, id, quantity, health, isSoulbound, suffix);
+//   user.sendMessage(builder.build());
+//   ...
+//   if (!MessageSchema<SV_INVENTORY>::readLeadingFields(parser, serial)) break;
+//   while (MessageSchema<SV_INVENTORY>::readNextGroup(parser, slot, ...)) ...
+template <typename... Fields>
+struct LeadingFields {};
+
+template <MessageCode CODE, typename Leading, typename... Repeated>
+struct RepeatedMessageFields;
+
+template <MessageCode CODE, typename... Leading, typename... Repeated>
+struct RepeatedMessageFields<CODE, LeadingFields<Leading...>, Repeated...> {
+  static const MessageCode code = CODE;
+
+  class Builder {
+   public:
+    explicit Builder(const Leading &... fields) {
+      appendFields(_args, fields...);
+    }
+    void add(const Repeated &... fields) {
+      _args.push_back(MSG_DELIM);
+      appendFields(_args, fields...);
+      ++_numGroups;
+    }
+    size_t numGroups() const { return _numGroups; }
+    Message build() { return {CODE, std::move(_args)}; }
+
+   private:
+    std::string _args;
+    size_t _numGroups{0};
+  };
+
+  static bool readLeadingFields(MessageParser &parser, Leading &... fields) {
+    return (parser.readNextArg(fields) && ...);
+  }
+  // False once every group has been read, or if one is malformed
+  static bool readNextGroup(MessageParser &parser, Repeated &... fields) {
+    if (parser.hasReadAllArgs()) return false;
+    return (parser.readNextArg(fields) && ...);
+  }
+};
+
+#define DECLARE_REPEATED_MESSAGE_SCHEMA(CODE, LEADING, ...) \
+  template <>                                               \
+  struct MessageSchema<CODE>                                \
+      : RepeatedMessageFields<CODE, LeadingFields<LEADING>, __VA_ARGS__> {}
+
+// Health and energy
+DECLARE_MESSAGE_SCHEMA(SV_ENTITY_HEALTH, Serial, Hitpoints);
+DECLARE_MESSAGE_SCHEMA(SV_ENTITY_ENERGY, Serial, Energy);
+DECLARE_MESSAGE_SCHEMA(SV_PLAYER_HEALTH, std::string, Hitpoints);
+DECLARE_MESSAGE_SCHEMA(SV_PLAYER_ENERGY, std::string, Energy);
+DECLARE_MESSAGE_SCHEMA(SV_MAX_HEALTH, std::string, Hitpoints);
+DECLARE_MESSAGE_SCHEMA(SV_MAX_ENERGY, std::string, Energy);
+
+// Damage and healing, for floating combat text
+DECLARE_MESSAGE_SCHEMA(SV_PLAYER_DAMAGED, std::string, Hitpoints);
+DECLARE_MESSAGE_SCHEMA(SV_PLAYER_HEALED, std::string, Hitpoints);
+DECLARE_MESSAGE_SCHEMA(SV_OBJECT_DAMAGED, Serial, Hitpoints);
+DECLARE_MESSAGE_SCHEMA(SV_OBJECT_HEALED, Serial, Hitpoints);
+
+// Attacks
+DECLARE_MESSAGE_SCHEMA(SV_PLAYER_HIT_PLAYER, std::string, std::string);
+DECLARE_MESSAGE_SCHEMA(SV_PLAYER_HIT_ENTITY, std::string, Serial);
+DECLARE_MESSAGE_SCHEMA(SV_ENTITY_HIT_PLAYER, Serial, std::string);
+DECLARE_MESSAGE_SCHEMA(SV_ENTITY_HIT_ENTITY, Serial, Serial);
+
+// Several values at once: the leading username, then pairs of
+// SV_PLAYER_HEALTH, SV_PLAYER_ENERGY, SV_MAX_HEALTH or SV_MAX_ENERGY and the
+// new value
+DECLARE_REPEATED_MESSAGE_SCHEMA(SV_PLAYER_VITALS, std::string, int, unsigned);
+
+// Inventory: the container's serial, then slot, ID, quantity, item health,
+// isSoulbound and suffix ID for each slot that has changed
+DECLARE_REPEATED_MESSAGE_SCHEMA(SV_INVENTORY, Serial, size_t, std::string,
+                                size_t, Hitpoints, int, std::string);
+
+// Laid out by LoginSnapshot itself, which is also what is read into
+struct LoginSnapshot;
+template <>
+struct MessageSchema<SV_LOGIN_SNAPSHOT> {
+  static const MessageCode code = SV_LOGIN_SNAPSHOT;
+  static Message build(const LoginSnapshot &snapshot);
+  static bool read(MessageParser &parser, LoginSnapshot &snapshot);
+};
@@ -0,0 +1,344 @@
+#include "OutboundQueue.h"
+
+#ifndef _WIN32
+#include <sys/uio.h>
+#endif
+
+#include "Message.h"
+
+std::atomic<size_t> OutboundQueue::_totalMessagesShed{0};
+std::atomic<size_t> OutboundQueue::_largestBacklog{0};
+
+bool OutboundQueue::append(const Message &msg, size_t *bytesAppended) {
+  std::lock_guard<std::mutex> lock(_mutex);
+
+  if (!hasRoomFor(msg)) return false;
+
+  auto &lane = _lanes[laneOf(msg.code)];
+  const auto approximateLength = msg.args.size() + 8;
+  auto &chunk = chunkWithSpaceFor(lane.chunks, approximateLength);
+  const auto oldLength = chunk.size();
+  msg.appendTo(chunk, _protocol, &_locationBaselines);
+  lane.bytes += chunk.size() - oldLength;
+  if (bytesAppended) *bytesAppended += chunk.size() - oldLength;
+  onBacklogChanged();
+
+  return shouldAskForEarlyFlush();
+}
+
+bool OutboundQueue::append(const SharedMessage &msg) {
+  auto lock = std::unique_lock<std::mutex>{_mutex};
+  const auto encoded = msg.encoded(_protocol);
+  if (!encoded) {
+    lock.unlock();
+    return append(msg.message());
+  }
+
+  if (!hasRoomFor(msg.message())) return false;
+
+  auto &lane = _lanes[laneOf(msg.message().code)];
+  if (encoded->size() < MIN_SHARED_CHUNK_SIZE)
+    chunkWithSpaceFor(lane.chunks, encoded->size()).append(*encoded);
+  else {
+    auto chunk = Chunk{};
+    chunk.shared = encoded;
+    lane.chunks.push_back(std::move(chunk));
+  }
+  lane.bytes += encoded->size();
+  onBacklogChanged();
+
+  return shouldAskForEarlyFlush();
+}
+
+bool OutboundQueue::shouldAskForEarlyFlush() {
+  // Once is enough; a slow client stays above the mark until it catches up.
+  if (_hasAskedForEarlyFlush || !hasReachedHighWaterMark()) return false;
+  _hasAskedForEarlyFlush = true;
+  return true;
+}
+
+bool OutboundQueue::hasReachedHighWaterMark() const {
+  // Deferred lanes are excluded; they wait their turn regardless.
+  return _bytesQueued + _lanes[CRITICAL].bytes + _lanes[GAMEPLAY].bytes >=
+         _limits.highWaterMark;
+}
+
+size_t OutboundQueue::backlog() const {
+  auto total = _bytesQueued;
+  for (const auto &lane : _lanes) total += lane.bytes;
+  return total;
+}
+
+OutboundQueue::Lane OutboundQueue::laneOf(MessageCode code) {
+  switch (code) {
+    // Harmless if they overtake earlier messages.  Health, for example, isn't
+    // here: it would be ignored if it arrived before its entity did.
+    case SV_PING_REPLY:
+    case SV_YOU_DIED:
+    case SV_ENTITY_HIT_PLAYER:
+    case SV_ENTITY_HIT_ENTITY:
+    case SV_PLAYER_HIT_ENTITY:
+    case SV_PLAYER_HIT_PLAYER:
+    case SV_SPELL_HIT:
+    case SV_SPELL_MISS:
+    case SV_RANGED_NPC_HIT:
+    case SV_RANGED_NPC_MISS:
+    case SV_RANGED_WEAPON_HIT:
+    case SV_RANGED_WEAPON_MISS:
+    case SV_PLAYER_WAS_HIT:
+    case SV_ENTITY_WAS_HIT:
+    case SV_SHOW_MISS_AT:
+    case SV_SHOW_DODGE_AT:
+    case SV_SHOW_BLOCK_AT:
+    case SV_SHOW_CRIT_AT:
+      return CRITICAL;
+
+    // Each of these is kept in order with the others that describe the same
+    // thing, e.g., the recipes learned since the full list was sent.
+    case SV_MAP_EXPLORATION_DATA:
+    case SV_CHUNK_EXPLORED:
+    case SV_UNEXPLORE_MAP:
+    case SV_YOUR_RECIPES:
+    case SV_NEW_RECIPES_LEARNED:
+    case SV_YOUR_CONSTRUCTIONS:
+    case SV_NEW_CONSTRUCTIONS_LEARNED:
+    case SV_KNOWN_SPELLS:
+    case SV_LEARNED_SPELL:
+    case SV_UNLEARNED_SPELL:
+    case SV_MERCHANT_SLOT:
+    case SV_LOGIN_SNAPSHOT:
+    // After everything else that's sent on login
+    case SV_LOGIN_INFO_HAS_FINISHED:
+      return BULK;
+
+    case SV_SAY:
+    case SV_WHISPER:
+      return COSMETIC;
+
+    default:
+      return GAMEPLAY;
+  }
+}
+
+bool OutboundQueue::isSheddable(MessageCode code) {
+  switch (code) {
+    // Chat
+    case SV_SAY:
+    case SV_WHISPER:
+
+    // Illustrations of combat, whose outcomes are sent separately
+    case SV_ENTITY_HIT_PLAYER:
+    case SV_ENTITY_HIT_ENTITY:
+    case SV_PLAYER_HIT_ENTITY:
+    case SV_PLAYER_HIT_PLAYER:
+    case SV_SPELL_HIT:
+    case SV_SPELL_MISS:
+    case SV_RANGED_NPC_HIT:
+    case SV_RANGED_NPC_MISS:
+    case SV_RANGED_WEAPON_HIT:
+    case SV_RANGED_WEAPON_MISS:
+    case SV_PLAYER_WAS_HIT:
+    case SV_ENTITY_WAS_HIT:
+    case SV_SHOW_MISS_AT:
+    case SV_SHOW_DODGE_AT:
+    case SV_SHOW_BLOCK_AT:
+    case SV_SHOW_CRIT_AT:
+      return true;
+
+    default:
+      return false;
+  }
+}
+
+bool OutboundQueue::hasRoomFor(const Message &msg) {
+  const auto backlog = this->backlog();
+
+  // The connection is about to be closed; don't bother.
+  if (_hasExceededHardLimit) return false;
+  if (backlog >= _limits.hardLimit) {
+    _hasExceededHardLimit = true;
+    return false;
+  }
+
+  if (backlog >= _limits.softLimit && isSheddable(msg.code)) {
+    ++_messagesShed;
+    ++_totalMessagesShed;
+    return false;
+  }
+
+  return true;
+}
+
+void OutboundQueue::onBacklogChanged() {
+  const auto backlog = this->backlog();
+  if (backlog <= _peakBytesQueued) return;
+  _peakBytesQueued = backlog;
+
+  auto largest = _largestBacklog.load();
+  while (backlog > largest &&
+         !_largestBacklog.compare_exchange_weak(largest, backlog)) {
+  }
+}
+
+std::string &OutboundQueue::chunkWithSpaceFor(Chunks &chunks, size_t length) {
+  const auto shouldStartNewChunk =
+      chunks.empty() || chunks.back().shared ||
+      (chunks.back().owned.size() + length > CHUNK_SIZE &&
+       !chunks.back().owned.empty());
+  if (shouldStartNewChunk) {
+    chunks.emplace_back();
+    chunks.back().owned.reserve(CHUNK_SIZE);
+  }
+  return chunks.back().owned;
+}
+
+void OutboundQueue::appendToChunks(const std::string &data) {
+  chunkWithSpaceFor(_chunks, data.size()).append(data);
+  _bytesQueued += data.size();
+}
+
+void OutboundQueue::scheduleChunk(Chunk &&chunk) {
+  // An empty chunk would otherwise be sent, and never finish sending.
+  const auto lastChunkIsEmpty = !_chunks.empty() && !_chunks.back().shared &&
+                                _chunks.back().owned.empty();
+  if (lastChunkIsEmpty) _chunks.pop_back();
+
+  _bytesQueued += chunk.bytes().size();
+  _chunks.push_back(std::move(chunk));
+}
+
+void OutboundQueue::scheduleLanes(bool ignoreBudgets) {
+  auto toCompress = std::string{};
+
+  for (auto i = 0; i != NUM_LANES; ++i) {
+    const auto lane = static_cast<Lane>(i);
+    auto &queue = _lanes[lane];
+    const auto budget = ignoreBudgets ? 0 : budgetFor(lane);
+    auto bytesScheduled = size_t{0};
+    while (!queue.chunks.empty() && (budget == 0 || bytesScheduled < budget)) {
+      auto &chunk = queue.chunks.front();
+      const auto length = chunk.bytes().size();
+      if (_compressor)
+        toCompress.append(chunk.bytes());
+      else if (length > 0)
+        scheduleChunk(std::move(chunk));
+      queue.chunks.pop_front();
+      queue.bytes -= length;
+      bytesScheduled += length;
+    }
+  }
+
+  if (toCompress.empty()) return;
+  auto compressed = std::string{};
+  _compressor->compress(toCompress.data(), toCompress.size(), compressed);
+  appendToChunks(compressed);
+}
+
+size_t OutboundQueue::budgetFor(Lane lane) const {
+  if (lane == BULK) return _limits.bulkBudget;
+  if (lane == COSMETIC) return _limits.cosmeticBudget;
+  return 0;
+}
+
+bool OutboundQueue::compressFromNowOn() {
+  std::lock_guard<std::mutex> lock(_mutex);
+  if (_compressor) return true;
+  if (!isCompressionAvailable()) return false;
+
+  // Everything already queued goes out uncompressed.  Then, tell the client
+  // where the compressed stream begins.
+  scheduleLanes(true);
+  appendToChunks({MSG_START_COMPRESSION});
+  _compressor = std::make_unique<StreamCompressor>();
+  return true;
+}
+
+void OutboundQueue::protocol(WireProtocol protocol) {
+  std::lock_guard<std::mutex> lock(_mutex);
+  _protocol = protocol;
+}
+
+size_t OutboundQueue::bytesQueued() const {
+  std::lock_guard<std::mutex> lock(_mutex);
+  return backlog();
+}
+
+OutboundQueue::Stats OutboundQueue::stats() const {
+  std::lock_guard<std::mutex> lock(_mutex);
+  auto stats = Stats{};
+  stats.bytesQueued = backlog();
+  stats.bytesDeferred = stats.bytesQueued - _bytesQueued;
+  stats.peakBytesQueued = _peakBytesQueued;
+  stats.messagesShed = _messagesShed;
+  stats.hasExceededHardLimit = _hasExceededHardLimit;
+  return stats;
+}
+
+bool OutboundQueue::hasExceededHardLimit() const {
+  std::lock_guard<std::mutex> lock(_mutex);
+  return _hasExceededHardLimit;
+}
+
+OutboundQueue::FlushResult OutboundQueue::flush(SOCKET socket) {
+  std::lock_guard<std::mutex> lock(_mutex);
+  _hasAskedForEarlyFlush = false;
+
+  scheduleLanes();
+
+  while (_bytesQueued > 0) {
+#ifdef _WIN32
+    const auto &firstChunk = _chunks.front().bytes();
+    const auto result =
+        send(socket, firstChunk.data() + _alreadySentFromFirstChunk,
+             static_cast<int>(firstChunk.size() - _alreadySentFromFirstChunk),
+             SOCKET_SEND_FLAGS);
+#else
+    static const size_t MAX_CHUNKS_PER_CALL = 64;
+    iovec chunksToSend[MAX_CHUNKS_PER_CALL];
+    auto numChunks = size_t{0};
+    for (const auto &chunk : _chunks) {
+      if (numChunks == MAX_CHUNKS_PER_CALL) break;
+      const auto &bytes = chunk.bytes();
+      const auto offset = numChunks == 0 ? _alreadySentFromFirstChunk : 0;
+      chunksToSend[numChunks].iov_base =
+          const_cast<char *>(bytes.data()) + offset;
+      chunksToSend[numChunks].iov_len = bytes.size() - offset;
+      ++numChunks;
+    }
+    // Like writev(), but able to suppress SIGPIPE
+    auto header = msghdr{};
+    header.msg_iov = chunksToSend;
+    header.msg_iovlen = numChunks;
+    const auto result = sendmsg(socket, &header, SOCKET_SEND_FLAGS);
+#endif
+
+    if (result == SOCKET_ERROR) {
+      if (wasSocketErrorWouldBlock(lastSocketError())) return WOULD_BLOCK;
+      return CONNECTION_ERROR;
+    }
+    onBytesSent(static_cast<size_t>(result));
+  }
+
+  return FLUSHED_ALL;
+}
+
+void OutboundQueue::onBytesSent(size_t numBytes) {
+  _bytesQueued -= numBytes;
+
+  while (numBytes > 0) {
+    const auto remainingInFirstChunk =
+        _chunks.front().bytes().size() - _alreadySentFromFirstChunk;
+    if (numBytes < remainingInFirstChunk) {
+      _alreadySentFromFirstChunk += numBytes;
+      return;
+    }
+    numBytes -= remainingInFirstChunk;
+    _alreadySentFromFirstChunk = 0;
+
+    // Keep the last chunk's memory, rather than reallocating it next tick.
+    if (_chunks.size() == 1 && !_chunks.front().shared)
+      _chunks.front().owned.clear();
+    else
+      _chunks.pop_front();
+  }
+}
@@ -0,0 +1,150 @@
+#pragma once
+
+#include <atomic>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+
+#include "Compression.h"
+#include "WireProtocol.h"
+#include "socketPlatform.h"
+
+struct Message;
+class SharedMessage;
+
+// Bytes waiting to be sent on a single connection.  Messages are appended as
+// they are generated, coalesced into large chunks, and written with as few
+// system calls as possible whenever the queue is flushed.  Safe to use from
+// multiple threads.
+//
+// Each message is queued in one of several lanes, by priority.  When the queue
+// is flushed, the lanes are emptied onto the wire in order of priority; bulk
+// and cosmetic traffic is limited to a budget per flush, so that a large
+// transfer trickles out behind, rather than ahead of, what's happening in the
+// game.
+//
+// A client that can't keep up is dealt with in two stages.  Past the soft
+// limit, messages that are purely informative or cosmetic are dropped rather
+// than queued.  Past the hard limit, nothing more is queued, and the
+// connection should be closed.
+class OutboundQueue {
+ public:
+  static const size_t CHUNK_SIZE = 16384;
+  // Shorter shared encodings are copied, as that's cheaper than a separate
+  // chunk.
+  static const size_t MIN_SHARED_CHUNK_SIZE = 512;
+  static const size_t DEFAULT_HIGH_WATER_MARK = 65536;
+  static const size_t DEFAULT_SOFT_LIMIT = 262144;
+  static const size_t DEFAULT_HARD_LIMIT = 1048576;
+  static const size_t DEFAULT_BULK_BUDGET = 16384;
+  static const size_t DEFAULT_COSMETIC_BUDGET = 4096;
+
+  struct Limits {
+    size_t highWaterMark{DEFAULT_HIGH_WATER_MARK};
+    size_t softLimit{DEFAULT_SOFT_LIMIT};
+    size_t hardLimit{DEFAULT_HARD_LIMIT};
+    // Bytes per flush, or 0 for no limit.  Lanes are scheduled a chunk at a
+    // time, so at least one chunk is sent.
+    size_t bulkBudget{DEFAULT_BULK_BUDGET};
+    size_t cosmeticBudget{DEFAULT_COSMETIC_BUDGET};
+  };
+
+  OutboundQueue() {}
+  explicit OutboundQueue(const Limits &limits) : _limits(limits) {}
+
+  // Returns true when the high-water mark is first reached after a flush,
+  // i.e., the queue should be flushed without waiting for the end of the
+  // tick.  The encoded length is added to *bytesAppended, if given.
+  bool append(const Message &msg, size_t *bytesAppended = nullptr);
+  bool append(const SharedMessage &msg);
+
+  enum Lane {
+    CRITICAL,  // Immediate feedback, which is useless if late
+    GAMEPLAY,  // Changes to the world, which must arrive in order
+    BULK,      // Large transfers of state, e.g. on login
+    COSMETIC,  // Chat
+    NUM_LANES
+  };
+  static Lane laneOf(MessageCode code);
+  // Whether a message can be dropped when a client falls behind
+  static bool isSheddable(MessageCode code);
+
+  // How messages appended from now on will be encoded
+  void protocol(WireProtocol protocol);
+  // Deflate everything appended from now on.  Each flush ends with a sync
+  // flush, so the client can decode it immediately.  Returns false if this
+  // build can't compress.
+  bool compressFromNowOn();
+
+  size_t bytesQueued() const;
+  bool isEmpty() const { return bytesQueued() == 0; }
+
+  struct Stats {
+    size_t bytesQueued{0};
+    size_t peakBytesQueued{0};
+    size_t bytesDeferred{0};  // Still waiting in their lanes
+    size_t messagesShed{0};
+    bool hasExceededHardLimit{false};
+  };
+  Stats stats() const;
+  bool hasExceededHardLimit() const;
+
+  // Across all queues, since the program started
+  static size_t totalMessagesShed() { return _totalMessagesShed; }
+  static size_t largestBacklog() { return _largestBacklog; }
+
+  enum FlushResult {
+    FLUSHED_ALL,
+    WOULD_BLOCK,  // The rest must wait until the socket is writable again.
+    CONNECTION_ERROR
+  };
+  // Write as much as the socket will take, without blocking.
+  FlushResult flush(SOCKET socket);
+
+ private:
+  mutable std::mutex _mutex;
+  // Either bytes written into this queue, or an encoding shared with others
+  struct Chunk {
+    std::string owned;
+    std::shared_ptr<const std::string> shared;
+    const std::string &bytes() const { return shared ? *shared : owned; }
+  };
+  using Chunks = std::deque<Chunk>;
+  // Each chunk holds whole messages, so that lanes can be scheduled a chunk
+  // at a time.
+  struct LaneQueue {
+    Chunks chunks;
+    size_t bytes{0};
+  };
+  LaneQueue _lanes[NUM_LANES];
+  Chunks _chunks;  // Scheduled, in the order they'll be sent
+  size_t _alreadySentFromFirstChunk{0};  // After a partial write
+  size_t _bytesQueued{0};                // Scheduled only
+  Limits _limits;
+  size_t _peakBytesQueued{0};
+  size_t _messagesShed{0};
+  bool _hasExceededHardLimit{false};
+  bool _hasAskedForEarlyFlush{false};  // Since the last flush
+  static std::atomic<size_t> _totalMessagesShed;
+  static std::atomic<size_t> _largestBacklog;
+  WireProtocol _protocol{TEXT_PROTOCOL};
+  LocationBaselines _locationBaselines;  // What this client was last sent
+  std::unique_ptr<StreamCompressor> _compressor;
+
+  static std::string &chunkWithSpaceFor(Chunks &chunks, size_t length);
+  void appendToChunks(const std::string &data);
+  void scheduleChunk(Chunk &&chunk);
+  // Move chunks from the lanes into the scheduled queue, in order of
+  // priority and within each lane's budget.  Anything compressed is deflated
+  // at this point.
+  void scheduleLanes(bool ignoreBudgets = false);
+  size_t budgetFor(Lane lane) const;
+  size_t backlog() const;
+  // Returns false if the message should be dropped instead.
+  bool hasRoomFor(const Message &msg);
+  bool hasReachedHighWaterMark() const;
+  bool shouldAskForEarlyFlush();
+  void onBacklogChanged();
+  void onBytesSent(size_t numBytes);
+};
@@ -1,5 +1,7 @@
 #pragma once
 
+#include <ostream>
+
 #include "Rect.h"
 #include "types.h"
 
@@ -0,0 +1,59 @@
+#include "ReceiveBuffer.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include "messageCodes.h"
+
+char *ReceiveBuffer::spaceToWrite() {
+  if (spaceAvailable() >= READ_CHUNK_SIZE) return _data.data() + _end;
+
+  moveContentsToFront();
+  if (spaceAvailable() < READ_CHUNK_SIZE) {
+    auto newSize = _data.size() * 2;
+    if (newSize < _end + READ_CHUNK_SIZE) newSize = _end + READ_CHUNK_SIZE;
+    _data.resize(newSize);
+  }
+  return _data.data() + _end;
+}
+
+void ReceiveBuffer::onBytesWritten(size_t numBytes) {
+  const auto oldEnd = _end;
+  _end += numBytes;
+
+  // Only the new bytes can complete a message.
+  for (auto i = _end; i != oldEnd; --i) {
+    if (_data[i - 1] != MSG_END) continue;
+    _completeEnd = i;
+    break;
+  }
+}
+
+void ReceiveBuffer::append(const char *data, size_t length) {
+  while (length > 0) {
+    auto *space = spaceToWrite();
+    const auto numBytes = std::min(length, spaceAvailable());
+    memcpy(space, data, numBytes);
+    onBytesWritten(numBytes);
+    data += numBytes;
+    length -= numBytes;
+  }
+}
+
+std::string ReceiveBuffer::completeMessagesAsString() const {
+  return {completeMessages(), completeMessagesLength()};
+}
+
+void ReceiveBuffer::discardMessages(size_t length) {
+  _begin += length;
+  if (_begin == _end) _begin = _completeEnd = _end = 0;
+}
+
+void ReceiveBuffer::moveContentsToFront() {
+  if (_begin == 0) return;
+  const auto length = _end - _begin;
+  if (length > 0) memmove(_data.data(), _data.data() + _begin, length);
+  _completeEnd -= _begin;
+  _end -= _begin;
+  _begin = 0;
+}
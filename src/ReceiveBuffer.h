@@ -0,0 +1,45 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+// Accumulates the bytes received on a single connection, and divides them into
+// complete messages.  A message split across several reads is kept until the
+// rest of it arrives.
+class ReceiveBuffer {
+ public:
+  static const size_t READ_CHUNK_SIZE = 4096;
+  // A partial message longer than this is assumed to be malformed or hostile.
+  static const size_t MAX_PARTIAL_MESSAGE_SIZE = 65536;
+
+  // Space to read into, of at least READ_CHUNK_SIZE bytes
+  char *spaceToWrite();
+  size_t spaceAvailable() const { return _data.size() - _end; }
+  // To be called after reading into spaceToWrite()
+  void onBytesWritten(size_t numBytes);
+  // For data that has already been read elsewhere
+  void append(const char *data, size_t length);
+
+  // The unbroken run of complete messages at the front of the buffer
+  bool hasCompleteMessages() const { return _completeEnd > _begin; }
+  const char *completeMessages() const { return _data.data() + _begin; }
+  size_t completeMessagesLength() const { return _completeEnd - _begin; }
+  std::string completeMessagesAsString() const;
+  // Keep only the trailing partial message, if any.
+  void discardCompleteMessages() { discardMessages(completeMessagesLength()); }
+  // Discard the first messages, which must be complete.
+  void discardMessages(size_t length);
+
+  size_t partialMessageLength() const { return _end - _completeEnd; }
+  bool isOverflowing() const {
+    return partialMessageLength() > MAX_PARTIAL_MESSAGE_SIZE;
+  }
+
+ private:
+  std::vector<char> _data;
+  size_t _begin{0};        // The first unhandled byte
+  size_t _completeEnd{0};  // One past the last complete message
+  size_t _end{0};          // One past the last byte received
+
+  void moveContentsToFront();
+};
@@ -1,6 +1,7 @@
 #ifndef RECT_H
 #define RECT_H
 
+#include <sstream>
 #include <string>
 
 #include "types.h"
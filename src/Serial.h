@@ -18,6 +18,10 @@ class Serial {
   bool isInventory() const { return _raw == INVENTORY; }
   bool isGear() const { return _raw == GEAR; }
 
+  // For compact encodings
+  size_t asNumber() const { return _raw; }
+  static Serial FromNumber(size_t n) { return {n}; }
+
  private:
   Serial(size_t n) { _raw = n; }
   size_t _raw;
@@ -25,6 +29,7 @@ class Serial {
   static const size_t INVENTORY = 0, GEAR = 1, UNINITIALISED = 2,
                       FIRST_ENTITY = 3;
 
+  friend class MessageParser;
   friend std::istream &operator>>(std::istream &lhs, Serial &rhs);
   friend std::ostream &operator<<(std::ostream &lhs, Serial &rhs);
 };
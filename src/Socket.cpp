@@ -6,10 +6,14 @@
 
 Log *Socket::debug = nullptr;
 
-int Socket::sockAddrSize = sizeof(sockaddr_in);
+SockAddrLength Socket::sockAddrSize = sizeof(sockaddr_in);
 bool Socket::_winsockInitialized = false;
+#ifdef _WIN32
 WSADATA Socket::_wsa;
+#endif
 std::map<SOCKET, int> Socket::_refCounts;
+// Copies are made and destroyed on both the game and network threads.
+static std::mutex refCountsMutex;
 
 Socket::Socket() : _lingerTime(0) {
   if (!_winsockInitialized) initWinsock();
@@ -25,7 +29,10 @@ Socket::Socket(SOCKET &rawSocket, const std::string &ip)
 }
 
 Socket::Socket(const Socket &rhs)
-    : _raw(rhs._raw), _lingerTime(rhs._lingerTime), _ip(rhs._ip) {
+    : _raw(rhs._raw),
+      _lingerTime(rhs._lingerTime),
+      _ip(rhs._ip),
+      _outbound(rhs._outbound) {
   if (_raw == INVALID_SOCKET) return;
   addRef();
 }
@@ -46,10 +53,12 @@ const Socket &Socket::operator=(const Socket &rhs) {
   _ip = rhs._ip;
   addRef();
   _lingerTime = rhs._lingerTime;
+  _outbound = rhs._outbound;
   return *this;
 }
 
 void Socket::addRef() {
+  std::lock_guard<std::mutex> lock(refCountsMutex);
   if (_refCounts.find(_raw) != _refCounts.end())
     ++_refCounts[_raw];
   else
@@ -59,10 +68,11 @@ void Socket::addRef() {
 void Socket::bind(sockaddr_in &socketAddr) {
   if (!valid()) return;
 
+  allowAddressReuse(_raw);
   _isBound =
       ::bind(_raw, (sockaddr *)&socketAddr, sockAddrSize) != SOCKET_ERROR;
   if (!_isBound)
-    *debug << Color::CHAT_ERROR << "Error binding socket: " << WSAGetLastError()
+    *debug << Color::CHAT_ERROR << "Error binding socket: " << lastError()
            << Log::endl;
 }
 
@@ -72,26 +82,65 @@ void Socket::listen() {
   ::listen(_raw, 3);
 }
 
-void Socket::sendMessage(const Message &msg, const Socket &destSocket) const {
-  if (!_winsockInitialized) return;
+bool Socket::sendMessage(const Message &msg, const Socket &destSocket,
+                         size_t *bytesSent) const {
+  if (!_winsockInitialized) return false;
+
+  if (destSocket._outbound)
+    return destSocket._outbound->append(msg, bytesSent);
+
   auto msgString = msg.compile();
+  if (bytesSent) *bytesSent += msgString.length();
 
   static std::mutex mutex;
   mutex.lock();
 
-  auto result =
-      send(destSocket.getRaw(), msgString.c_str(), (int)msgString.length(), 0);
+  auto result = send(destSocket.getRaw(), msgString.c_str(),
+                     (int)msgString.length(), SOCKET_SEND_FLAGS);
   if (result < 0 && debug)
     *debug << Color::CHAT_ERROR << "Failed to send command \"" << msg
            << "\" to socket " << destSocket.getRaw() << Log::endl;
 
   mutex.unlock();
+  return false;
+}
+
+bool Socket::sendMessage(const SharedMessage &msg,
+                         const Socket &destSocket) const {
+  if (!destSocket._outbound) return sendMessage(msg.message(), destSocket);
+  if (!_winsockInitialized) return false;
+
+  return destSocket._outbound->append(msg);
 }
 
 void Socket::sendMessage(const Message &msg) const { sendMessage(msg, *this); }
 
+void Socket::queueOutgoingMessages(const OutboundQueue::Limits &limits) {
+  if (!valid()) return;
+  makeSocketNonBlocking(_raw);
+  _outbound = std::make_shared<OutboundQueue>(limits);
+}
+
+void Socket::useWireProtocol(WireProtocol protocol) const {
+  if (_outbound) _outbound->protocol(protocol);
+}
+
+bool Socket::compressQueuedOutput() const {
+  if (!_outbound) return false;
+  return _outbound->compressFromNowOn();
+}
+
+OutboundQueue::FlushResult Socket::flushQueuedOutput() const {
+  if (!_outbound) return OutboundQueue::FLUSHED_ALL;
+  return _outbound->flush(_raw);
+}
+
 void Socket::initWinsock() {
+#ifdef _WIN32
   if (WSAStartup(MAKEWORD(2, 2), &_wsa) == 0) _winsockInitialized = true;
+#else
+  _winsockInitialized = true;
+#endif
 }
 
 void Socket::delayClosing(ms_t lingerTime) { _lingerTime = lingerTime; }
@@ -103,12 +152,13 @@ int Socket::closeRawAfterDelay(void *data) {
   delete[] p;
 
   SDL_Delay(delay);
-  closesocket(s);
+  closeRawSocket(s);
 
   return 0;
 }
 
 void Socket::close() {
+  std::lock_guard<std::mutex> lock(refCountsMutex);
   if (valid()) {
     --_refCounts[_raw];
     if (_refCounts[_raw] == 0) {
@@ -119,11 +169,13 @@ void Socket::close() {
         SDL_CreateThread(closeRawAfterDelay, "Closing socket",
                          static_cast<void *>(args));
       } else {
-        closesocket(_raw);
+        closeRawSocket(_raw);
       }
       _refCounts.erase(_raw);
       if (_refCounts.empty()) {
+#ifdef _WIN32
         WSACleanup();
+#endif
         _winsockInitialized = false;
       }
     }
@@ -1,25 +1,32 @@
 #ifndef SOCKET_H
 #define SOCKET_H
 
-#include <windows.h>
-
 #include <iostream>
 #include <map>
+#include <memory>
 #include <string>
 
 #include "Log.h"
+#include "OutboundQueue.h"
+#include "socketPlatform.h"
 #include "types.h"
 
 struct Message;
+class SharedMessage;
 
-// Wrapper class for Winsock's SOCKET.
+// Wrapper class for a raw socket: Winsock's SOCKET on Windows, or a file
+// descriptor elsewhere.
 class Socket {
  public:
-  static int sockAddrSize;
+  static SockAddrLength sockAddrSize;
   static Log *debug;
 
+  static int lastError() { return lastSocketError(); }
+
  private:
+#ifdef _WIN32
   static WSADATA _wsa;
+#endif
   static bool _winsockInitialized;
   SOCKET _raw;
   std::string _ip;
@@ -27,6 +34,7 @@ class Socket {
   static std::map<SOCKET, int>
       _refCounts;  // Reference counters for each raw SOCKET
   bool _isBound{false};
+  std::shared_ptr<OutboundQueue> _outbound;  // Shared by all copies
 
   static void initWinsock();
   void addRef();                              // Increment reference counter
@@ -59,7 +67,28 @@ class Socket {
 
   // No destination socket implies client->server message
   void sendMessage(const Message &msg) const;
-  void sendMessage(const Message &msg, const Socket &destSocket) const;
+  // Returns true if the destination's queue should now be flushed, without
+  // waiting for the end of the tick.  That is left to whoever owns it.  The
+  // number of bytes the message took up is added to *bytesSent, if given.
+  bool sendMessage(const Message &msg, const Socket &destSocket,
+                   size_t *bytesSent = nullptr) const;
+  bool sendMessage(const SharedMessage &msg, const Socket &destSocket) const;
+
+  // From now on, messages sent to this socket wait in a queue until it is
+  // flushed, rather than each being sent immediately.  The socket is made
+  // non-blocking.
+  void queueOutgoingMessages(const OutboundQueue::Limits &limits);
+  void useWireProtocol(WireProtocol protocol) const;
+  bool compressQueuedOutput() const;
+  bool hasQueuedOutput() const { return _outbound && !_outbound->isEmpty(); }
+  OutboundQueue::FlushResult flushQueuedOutput() const;
+  // The client has fallen so far behind that it should be disconnected.
+  bool hasExceededSendLimit() const {
+    return _outbound && _outbound->hasExceededHardLimit();
+  }
+  OutboundQueue::Stats sendQueueStats() const {
+    return _outbound ? _outbound->stats() : OutboundQueue::Stats{};
+  }
 };
 
 #endif
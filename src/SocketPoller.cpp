@@ -0,0 +1,171 @@
+#include "SocketPoller.h"
+
+#ifdef USE_EPOLL
+#include <sys/epoll.h>
+#endif
+
+#include <algorithm>
+
+void SocketPoller::openInterruptSocket() {
+  _interruptSocket = socket(AF_INET, SOCK_DGRAM, 0);
+  if (_interruptSocket == INVALID_SOCKET) return;
+
+  auto address = sockaddr_in{};
+  address.sin_family = AF_INET;
+  address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  address.sin_port = 0;  // Any
+  auto length = static_cast<SockAddrLength>(sizeof(address));
+  const auto succeeded =
+      bind(_interruptSocket, (sockaddr *)&address, length) != SOCKET_ERROR &&
+      getsockname(_interruptSocket, (sockaddr *)&address, &length) !=
+          SOCKET_ERROR &&
+      connect(_interruptSocket, (sockaddr *)&address, length) != SOCKET_ERROR;
+  if (!succeeded) {
+    closeRawSocket(_interruptSocket);
+    _interruptSocket = INVALID_SOCKET;
+    return;
+  }
+
+  makeSocketNonBlocking(_interruptSocket);
+  add(_interruptSocket);
+}
+
+void SocketPoller::interrupt() {
+  if (_interruptSocket == INVALID_SOCKET) return;
+  const auto byte = char{0};
+  send(_interruptSocket, &byte, 1, SOCKET_SEND_FLAGS);
+}
+
+void SocketPoller::onWaitFinished() {
+  auto it =
+      std::find(_readySockets.begin(), _readySockets.end(), _interruptSocket);
+  if (it == _readySockets.end()) return;
+  _readySockets.erase(it);
+
+  // Several interruptions need only one wake-up.
+  char buffer[64];
+  while (recv(_interruptSocket, buffer, sizeof(buffer), 0) > 0)
+    ;
+}
+
+#ifdef USE_EPOLL
+
+SocketPoller::SocketPoller() : _epoll(epoll_create1(0)) {
+  openInterruptSocket();
+}
+
+SocketPoller::~SocketPoller() {
+  if (_interruptSocket != INVALID_SOCKET) closeRawSocket(_interruptSocket);
+  if (_epoll >= 0) ::close(_epoll);
+}
+
+void SocketPoller::add(SOCKET s) {
+  if (s == INVALID_SOCKET) return;
+  if (!_registered.insert(s).second) return;
+
+  auto event = epoll_event{};
+  event.events = EPOLLIN;
+  event.data.fd = s;
+  epoll_ctl(_epoll, EPOLL_CTL_ADD, s, &event);
+}
+
+void SocketPoller::remove(SOCKET s) {
+  if (_registered.erase(s) == 0) return;
+  _watchedForWritability.erase(s);
+  epoll_ctl(_epoll, EPOLL_CTL_DEL, s, nullptr);
+}
+
+void SocketPoller::watchForWritability(SOCKET s, bool shouldWatch) {
+  if (_registered.count(s) == 0) return;
+  const auto isWatched = _watchedForWritability.count(s) == 1;
+  if (isWatched == shouldWatch) return;
+
+  if (shouldWatch)
+    _watchedForWritability.insert(s);
+  else
+    _watchedForWritability.erase(s);
+
+  auto event = epoll_event{};
+  event.events = shouldWatch ? EPOLLIN | EPOLLOUT : EPOLLIN;
+  event.data.fd = s;
+  epoll_ctl(_epoll, EPOLL_CTL_MOD, s, &event);
+}
+
+bool SocketPoller::wait(ms_t timeout) {
+  _readySockets.clear();
+  _writableSockets.clear();
+
+  // Level-triggered, so anything that doesn't fit will be reported next time.
+  static const size_t MAX_EVENTS = 256;
+  epoll_event events[MAX_EVENTS];
+  auto numEvents = epoll_wait(_epoll, events, MAX_EVENTS,
+                              static_cast<int>(timeout));
+  if (numEvents < 0) return errno == EINTR;
+
+  for (auto i = 0; i != numEvents; ++i) {
+    const auto &event = events[i];
+    // Errors and hang-ups are discovered when the socket is read.
+    if (event.events & (EPOLLIN | EPOLLERR | EPOLLHUP))
+      _readySockets.push_back(event.data.fd);
+    if (event.events & EPOLLOUT) _writableSockets.push_back(event.data.fd);
+  }
+  onWaitFinished();
+  return true;
+}
+
+#else
+
+SocketPoller::SocketPoller() { openInterruptSocket(); }
+
+SocketPoller::~SocketPoller() {
+  if (_interruptSocket != INVALID_SOCKET) closeRawSocket(_interruptSocket);
+}
+
+void SocketPoller::add(SOCKET s) {
+  if (s == INVALID_SOCKET) return;
+  _registered.insert(s);
+}
+
+void SocketPoller::remove(SOCKET s) {
+  _registered.erase(s);
+  _watchedForWritability.erase(s);
+}
+
+void SocketPoller::watchForWritability(SOCKET s, bool shouldWatch) {
+  if (_registered.count(s) == 0) return;
+  if (shouldWatch)
+    _watchedForWritability.insert(s);
+  else
+    _watchedForWritability.erase(s);
+}
+
+bool SocketPoller::wait(ms_t timeout) {
+  _readySockets.clear();
+  _writableSockets.clear();
+
+  auto readFDs = fd_set{}, writeFDs = fd_set{};
+  FD_ZERO(&readFDs);
+  FD_ZERO(&writeFDs);
+  auto highest = SOCKET{0};
+  for (auto s : _registered) {
+    FD_SET(s, &readFDs);
+    if (s > highest) highest = s;
+  }
+  for (auto s : _watchedForWritability) FD_SET(s, &writeFDs);
+
+  auto selectTimeout = timeval{};
+  selectTimeout.tv_sec = timeout / 1000;
+  selectTimeout.tv_usec = (timeout % 1000) * 1000;
+  auto activity = select(static_cast<int>(highest + 1), &readFDs, &writeFDs,
+                         nullptr, &selectTimeout);
+  if (activity == SOCKET_ERROR) return false;
+
+  for (auto s : _registered)
+    if (FD_ISSET(s, &readFDs)) _readySockets.push_back(s);
+  for (auto s : _watchedForWritability)
+    if (FD_ISSET(s, &writeFDs)) _writableSockets.push_back(s);
+  onWaitFinished();
+  return true;
+}
+
+#endif
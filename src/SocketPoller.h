@@ -0,0 +1,57 @@
+#pragma once
+
+#include <set>
+#include <vector>
+
+#include "socketPlatform.h"
+#include "types.h"
+
+#ifdef __linux__
+#define USE_EPOLL
+#endif
+
+// Waits for activity on a set of sockets.  Sockets are registered once, when
+// they're opened, rather than being re-submitted every time; on Linux this is
+// backed by epoll, so only sockets that are actually ready are reported.
+class SocketPoller {
+ public:
+  SocketPoller();
+  ~SocketPoller();
+  SocketPoller(const SocketPoller &) = delete;
+  SocketPoller &operator=(const SocketPoller &) = delete;
+
+  void add(SOCKET s);
+  void remove(SOCKET s);
+  size_t size() const { return _registered.size(); }
+  // Whether to report when this socket can accept more outgoing data
+  void watchForWritability(SOCKET s, bool shouldWatch);
+
+  // Block until at least one socket has activity, until the timeout has
+  // elapsed, or until interrupt() is called.  Returns false if polling failed.
+  bool wait(ms_t timeout);
+  // Safe to call from any thread
+  void interrupt();
+
+  // The sockets found to be readable by the last call to wait()
+  const std::vector<SOCKET> &readySockets() const { return _readySockets; }
+  // The watched sockets found to be writable by the last call to wait()
+  const std::vector<SOCKET> &writableSockets() const {
+    return _writableSockets;
+  }
+
+ private:
+  std::set<SOCKET> _registered;
+  std::set<SOCKET> _watchedForWritability;
+  std::vector<SOCKET> _readySockets;
+  std::vector<SOCKET> _writableSockets;
+
+  // A UDP socket connected to itself: interrupt() sends it a datagram, which
+  // wakes wait().  Unlike a pipe, this works with select() on Windows too.
+  SOCKET _interruptSocket{INVALID_SOCKET};
+  void openInterruptSocket();
+  void onWaitFinished();  // Hides the interrupt socket from the results
+
+#ifdef USE_EPOLL
+  int _epoll{-1};
+#endif
+};
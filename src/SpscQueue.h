@@ -0,0 +1,49 @@
+#pragma once
+
+#include <atomic>
+#include <utility>
+
+// An unbounded queue between exactly two threads: one that pushes and one that
+// pops.  Neither ever waits for the other; the only synchronisation is the
+// atomic link between each node and the next.
+template <typename T>
+class SpscQueue {
+ public:
+  SpscQueue() : _head(new Node), _tail(_head) {}
+  ~SpscQueue() {
+    while (_head) {
+      auto *next = _head->next.load(std::memory_order_relaxed);
+      delete _head;
+      _head = next;
+    }
+  }
+  SpscQueue(const SpscQueue &) = delete;
+  SpscQueue &operator=(const SpscQueue &) = delete;
+
+  // Producer only
+  void push(T value) {
+    auto *node = new Node;
+    node->value = std::move(value);
+    _tail->next.store(node, std::memory_order_release);
+    _tail = node;
+  }
+
+  // Consumer only.  Returns false if the queue is empty.
+  bool pop(T &value) {
+    auto *next = _head->next.load(std::memory_order_acquire);
+    if (!next) return false;
+    value = std::move(next->value);
+    next->value = T{};  // Don't hold on to anything it referred to
+    delete _head;
+    _head = next;  // Now the dummy node
+    return true;
+  }
+
+ private:
+  struct Node {
+    T value{};
+    std::atomic<Node *> next{nullptr};
+  };
+  Node *_head;  // A dummy, before the oldest value.  Owned by the consumer.
+  Node *_tail;  // The newest value.  Owned by the producer.
+};
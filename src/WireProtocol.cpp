@@ -0,0 +1,243 @@
+#include "WireProtocol.h"
+
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <sstream>
+
+#include "util.h"
+
+std::string versionWithProtocolRequest(const std::string &version,
+                                       const ProtocolRequest &request) {
+  if (request.protocol == TEXT_PROTOCOL && !request.compression)
+    return version;
+  return makeArgs(version, static_cast<int>(request.protocol),
+                  request.compression ? 1 : 0);
+}
+
+ProtocolRequest extractProtocolRequest(std::string &versionArg) {
+  auto request = ProtocolRequest{};
+  const auto delimiter = versionArg.find(MSG_DELIM);
+  if (delimiter == std::string::npos) return request;
+
+  auto iss = std::istringstream{versionArg.substr(delimiter + 1)};
+  versionArg.erase(delimiter);
+
+  auto protocol = 0, compression = 0;
+  auto del = char{};
+  iss >> protocol >> del >> compression;
+  if (protocol == BINARY_PROTOCOL) request.protocol = BINARY_PROTOCOL;
+  request.compression = compression == 1;
+  return request;
+}
+
+bool isUserLocationCode(MessageCode code) {
+  return code == SV_USER_LOCATION || code == SV_USER_LOCATION_INSTANT;
+}
+
+bool isEntityLocationCode(MessageCode code) {
+  return code == SV_ENTITY_LOCATION || code == SV_ENTITY_LOCATION_INSTANT;
+}
+
+void appendVarint(std::string &buffer, size_t number) {
+  while (number >= 0x80) {
+    buffer.push_back(static_cast<char>((number & 0x7f) | 0x80));
+    number >>= 7;
+  }
+  buffer.push_back(static_cast<char>(number));
+}
+
+QuantizedPoint::QuantizedPoint(const MapPoint &location)
+    : x(std::llround(location.x * COORDINATE_PRECISION)),
+      y(std::llround(location.y * COORDINATE_PRECISION)) {}
+
+MapPoint QuantizedPoint::toMapPoint() const {
+  return {static_cast<double>(x) / COORDINATE_PRECISION,
+          static_cast<double>(y) / COORDINATE_PRECISION};
+}
+
+void appendCoordinate(std::string &buffer, int64_t quantized) {
+  const auto zigzag = static_cast<uint64_t>(quantized) << 1 ^
+                      static_cast<uint64_t>(quantized >> 63);
+  appendVarint(buffer, static_cast<size_t>(zigzag));
+}
+
+static bool readVarint(const char *&pos, const char *end, size_t &number) {
+  number = 0;
+  for (auto shift = 0; pos != end && shift < 64; shift += 7) {
+    const auto byte = static_cast<unsigned char>(*pos++);
+    number |= static_cast<size_t>(byte & 0x7f) << shift;
+    if ((byte & 0x80) == 0) return true;
+  }
+  return false;
+}
+
+static bool readCoordinate(const char *&pos, const char *end,
+                           int64_t &quantized) {
+  auto zigzag = size_t{};
+  if (!readVarint(pos, end, zigzag)) return false;
+  quantized = static_cast<int64_t>(zigzag >> 1) ^
+              -static_cast<int64_t>(zigzag & 1);
+  return true;
+}
+
+std::string LocationBaselines::entityKey(size_t serial) {
+  // Usernames are letters only, so this can't collide with one.
+  return "#" + toString(serial);
+}
+
+bool LocationBaselines::shouldSendDelta(const std::string &subject,
+                                        const QuantizedPoint &location,
+                                        QuantizedPoint &delta) {
+  auto it = _baselines.find(subject);
+  if (it != _baselines.end()) {
+    auto &baseline = it->second;
+    const auto difference = QuantizedPoint{location.x - baseline.location.x,
+                                           location.y - baseline.location.y};
+    const auto isSmall = std::abs(difference.x) < MAX_DELTA &&
+                         std::abs(difference.y) < MAX_DELTA;
+    if (isSmall && baseline.deltasSinceKeyframe < KEYFRAME_INTERVAL) {
+      delta = difference;
+      baseline.location = location;
+      ++baseline.deltasSinceKeyframe;
+      return true;
+    }
+  }
+
+  onAbsoluteLocation(subject, location);
+  return false;
+}
+
+void LocationBaselines::onAbsoluteLocation(const std::string &subject,
+                                           const QuantizedPoint &location) {
+  // Only keyframes add subjects, so both ends reach the limit together.
+  const auto isNewSubject = _baselines.find(subject) == _baselines.end();
+  if (isNewSubject && _baselines.size() >= MAX_SUBJECTS) _baselines.clear();
+
+  auto &baseline = _baselines[subject];
+  baseline.location = location;
+  baseline.deltasSinceKeyframe = 0;
+}
+
+bool LocationBaselines::applyDelta(const std::string &subject,
+                                   const QuantizedPoint &delta,
+                                   QuantizedPoint &location) {
+  auto it = _baselines.find(subject);
+  if (it == _baselines.end()) return false;
+
+  auto &baseline = it->second;
+  baseline.location.x += delta.x;
+  baseline.location.y += delta.y;
+  ++baseline.deltasSinceKeyframe;
+  location = baseline.location;
+  return true;
+}
+
+bool ServerStreamDecoder::nextLocation(DecodedLocation &location) {
+  if (_locations.empty()) return false;
+  location = std::move(_locations.front());
+  _locations.pop();
+  return true;
+}
+
+std::string ServerStreamDecoder::toText(const char *data, size_t length) {
+  if (_decompressor)
+    _decompressor->decompress(data, length, _pending);
+  else
+    _pending.append(data, length);
+
+  auto text = std::string{};
+  text.reserve(_pending.size());
+  auto pos = size_t{0};
+  while (pos != _pending.size()) {
+    if (!_isInsideTextFrame && _pending[pos] == MSG_START_COMPRESSION &&
+        !_decompressor) {
+      _decompressor = std::make_unique<StreamDecompressor>();
+      const auto compressed = _pending.substr(pos + 1);
+      _pending.erase(pos + 1);
+      _decompressor->decompress(compressed.data(), compressed.size(),
+                                _pending);
+      ++pos;
+      continue;
+    }
+
+    if (!_isInsideTextFrame && _pending[pos] == MSG_START_BINARY) {
+      const auto frameLength =
+          decodeFrame(_pending.data() + pos, _pending.size() - pos, text);
+      if (frameLength == 0) break;
+      pos += frameLength;
+      continue;
+    }
+
+    const auto c = _pending[pos++];
+    if (c == MSG_START)
+      _isInsideTextFrame = true;
+    else if (c == MSG_END)
+      _isInsideTextFrame = false;
+    text.push_back(c);
+  }
+
+  _pending.erase(0, pos);
+  return text;
+}
+
+size_t ServerStreamDecoder::decodeFrame(const char *frame, size_t available,
+                                         std::string &text) {
+  const auto *pos = frame + 1;
+  const auto *end = frame + available;
+  auto bodyLength = size_t{};
+  if (!readVarint(pos, end, bodyLength)) return 0;
+  if (static_cast<size_t>(end - pos) < bodyLength) return 0;
+  const auto *bodyEnd = pos + bodyLength;
+  const auto frameLength = static_cast<size_t>(bodyEnd - frame);
+
+  auto header = size_t{};
+  if (!readVarint(pos, bodyEnd, header)) return frameLength;  // Discard
+  const auto code = static_cast<MessageCode>(header >> FRAME_FORM_BITS);
+  const auto form =
+      static_cast<FrameForm>(header & ((1 << FRAME_FORM_BITS) - 1));
+
+  auto args = std::string{};
+  if (form == TEXT_ARGS)
+    args.assign(pos, bodyEnd);
+  else {
+    auto decoded = DecodedLocation{};
+    auto baselineKey = std::string{};
+    if (isUserLocationCode(code)) {
+      auto nameLength = size_t{};
+      if (!readVarint(pos, bodyEnd, nameLength)) return frameLength;
+      if (static_cast<size_t>(bodyEnd - pos) < nameLength) return frameLength;
+      decoded.username.assign(pos, nameLength);
+      pos += nameLength;
+      baselineKey = LocationBaselines::userKey(decoded.username);
+    } else {
+      auto serial = size_t{};
+      if (!readVarint(pos, bodyEnd, serial)) return frameLength;
+      decoded.serial = Serial::FromNumber(serial);
+      baselineKey = LocationBaselines::entityKey(serial);
+    }
+
+    auto coordinates = QuantizedPoint{};
+    if (!readCoordinate(pos, bodyEnd, coordinates.x)) return frameLength;
+    if (!readCoordinate(pos, bodyEnd, coordinates.y)) return frameLength;
+
+    auto location = coordinates;
+    if (form == LOCATION_DELTA) {
+      if (!_baselines.applyDelta(baselineKey, coordinates, location))
+        return frameLength;
+    } else
+      _baselines.onAbsoluteLocation(baselineKey, coordinates);
+
+    decoded.location = location.toMapPoint();
+    _locations.push(std::move(decoded));
+  }
+
+  text.push_back(MSG_START);
+  text.append(toString(static_cast<int>(code)));
+  if (!args.empty()) {
+    text.push_back(MSG_DELIM);
+    text.append(args);
+  }
+  text.push_back(MSG_END);
+  return frameLength;
+}
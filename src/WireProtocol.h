@@ -0,0 +1,127 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <queue>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+
+#include "Compression.h"
+#include "Point.h"
+#include "Serial.h"
+#include "messageCodes.h"
+
+// The formats in which the server can send messages.  Text is the original,
+// and is what old clients expect.  A binary frame is:
+//   MSG_START_BINARY, varint body length, body
+// where the body is a varint header (code << 2 | FrameForm) followed by either
+// the text arguments or, for location messages, a compact encoding: the
+// subject (length-prefixed username, or varint serial) then both coordinates
+// as zigzag varints, in units of 1/COORDINATE_PRECISION pixels.  A delta frame
+// has the same layout, but its coordinates are relative to the last location
+// sent for that subject on that connection.
+enum WireProtocol { TEXT_PROTOCOL = 0, BINARY_PROTOCOL = 1 };
+
+enum FrameForm { TEXT_ARGS = 0, ABSOLUTE_LOCATION = 1, LOCATION_DELTA = 2 };
+const int FRAME_FORM_BITS = 2;
+
+const char MSG_START_BINARY = '\001';  // SOH
+const int COORDINATE_PRECISION = 16;
+
+// A location in units of 1/COORDINATE_PRECISION pixels
+struct QuantizedPoint {
+  int64_t x{0}, y{0};
+
+  QuantizedPoint() {}
+  QuantizedPoint(int64_t xArg, int64_t yArg) : x(xArg), y(yArg) {}
+  explicit QuantizedPoint(const MapPoint &location);
+  MapPoint toMapPoint() const;
+};
+
+// Everything the server sends after this byte is deflated.
+const char MSG_START_COMPRESSION = '\016';  // SO
+
+struct ProtocolRequest {
+  WireProtocol protocol{TEXT_PROTOCOL};
+  bool compression{false};
+};
+
+// The client requests a protocol by appending it to the version argument of
+// CL_LOGIN_*.  Servers that predate this see it as a version mismatch; clients
+// that predate it get the text protocol, uncompressed.
+std::string versionWithProtocolRequest(const std::string &version,
+                                       const ProtocolRequest &request);
+// Removes any protocol request from the version argument, and returns it.
+ProtocolRequest extractProtocolRequest(std::string &versionArg);
+
+bool isUserLocationCode(MessageCode code);
+bool isEntityLocationCode(MessageCode code);
+
+void appendVarint(std::string &buffer, size_t number);
+void appendCoordinate(std::string &buffer, int64_t quantized);
+
+// The last location sent for each subject on a connection, so that movement
+// can be sent as a small delta.  The server keeps one per binary connection,
+// and the client mirrors it; both are changed only by the frames themselves,
+// in order, so they always agree.  An absolute keyframe is sent periodically,
+// and whenever a delta would be large.
+class LocationBaselines {
+ public:
+  static const int KEYFRAME_INTERVAL = 20;  // Deltas between keyframes
+  static const int64_t MAX_DELTA = 4096;
+  static const size_t MAX_SUBJECTS = 4096;  // Then all are forgotten at once
+
+  static std::string userKey(const std::string &username) { return username; }
+  static std::string entityKey(size_t serial);
+
+  // Server side: whether the new location should be sent as a delta, which
+  // is then set.  Either way, the location becomes the new baseline.
+  bool shouldSendDelta(const std::string &subject,
+                       const QuantizedPoint &location, QuantizedPoint &delta);
+
+  // Client side
+  void onAbsoluteLocation(const std::string &subject,
+                          const QuantizedPoint &location);
+  // Returns false if there's no baseline for the subject.
+  bool applyDelta(const std::string &subject, const QuantizedPoint &delta,
+                  QuantizedPoint &location);
+
+ private:
+  struct Baseline {
+    QuantizedPoint location;
+    int deltasSinceKeyframe{0};
+  };
+  std::unordered_map<std::string, Baseline> _baselines;
+};
+
+// A location from a binary frame, kept numeric rather than formatted as text
+// only to be parsed again
+struct DecodedLocation {
+  std::string username;  // User locations only
+  Serial serial;         // Entity locations only
+  MapPoint location;
+};
+
+// Converts the stream from the server back into text frames, so that they can
+// be parsed as before.  Text frames pass through unchanged, binary frames are
+// converted, and everything after MSG_START_COMPRESSION is first inflated.  An
+// incomplete binary frame is kept until the rest of it arrives.
+//
+// A location frame becomes its message code alone, with no arguments, and its
+// location is queued, in the same order, for nextLocation().
+class ServerStreamDecoder {
+ public:
+  std::string toText(const char *data, size_t length);
+  bool nextLocation(DecodedLocation &location);
+
+ private:
+  std::string _pending;
+  std::queue<DecodedLocation> _locations;
+  bool _isInsideTextFrame{false};
+  std::unique_ptr<StreamDecompressor> _decompressor;
+  LocationBaselines _baselines;
+
+  // Returns the length of the frame, or 0 if it hasn't all arrived.
+  size_t decodeFrame(const char *frame, size_t available, std::string &text);
+};
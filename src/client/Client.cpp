@@ -106,6 +106,10 @@ Client::Client()
 #endif
 
   if (cmdLineArgs.contains("auto-login")) _shouldAutoLogIn = true;
+  if (cmdLineArgs.contains("message-time-budget"))
+    _timeBudgetForMessages = cmdLineArgs.getInt("message-time-budget");
+  if (cmdLineArgs.contains("datagram-channel"))
+    _shouldRequestDatagramChannel = true;
 
   drawLoadingScreen("Initializing audio");
   int ret = (Mix_OpenAudio(44100, MIX_DEFAULT_FORMAT, 1, 512) < 0);
@@ -278,13 +282,22 @@ void Client::gameLoop() {
 
   // Update server with current location
   auto shouldTellServerAboutLocation = _serverHasOutOfDateLocationInfo;
-  if (!shouldTellServerAboutLocation)
+  if (!shouldTellServerAboutLocation) {
     _timeSinceLocUpdate = 0;
-  else {
+    if (_lastLocationUpdateWasByDatagram) {
+      sendMessage(tcpLocationMessage());
+      _lastLocationUpdateWasByDatagram = false;
+    }
+  } else {
     _timeSinceLocUpdate += _timeElapsed;
     if (_timeSinceLocUpdate > TIME_BETWEEN_LOCATION_UPDATES) {
-      sendMessage({CL_MOVE_TO,
-                   makeArgs(_character.location().x, _character.location().y)});
+      _lastLocationUpdateWasByDatagram = _connection.hasDatagramChannel();
+      if (_lastLocationUpdateWasByDatagram)
+        _connection.sendByDatagram(
+            {CL_MOVE_TO, makeArgs(_character.location().x,
+                                  _character.location().y)});
+      else
+        sendMessage(tcpLocationMessage());
       _tooltipNeedsRefresh = true;
       _timeSinceLocUpdate = 0;
       _serverHasOutOfDateLocationInfo = false;
@@ -292,10 +305,7 @@ void Client::gameLoop() {
   }
 
   // Deal with any messages from the server
-  if (!_messages.empty()) {
-    handleBufferedMessages(_messages.front());
-    _messages.pop();
-  }
+  handleMessagesFromServer();
 
   showQueuedErrorMessages();
 
@@ -982,3 +992,11 @@ void Client::CommonImages::initialise() {
   logoBTC = {"Images/logo-bitcoin.png", Color::MAGENTA};
   btcQR = {"Images/btc-qr.png", Color::MAGENTA};
 }
+
+Message Client::tcpLocationMessage() const {
+  const auto &location = _character.location();
+  if (!_connection.hasDatagramChannel())
+    return {CL_MOVE_TO, makeArgs(location.x, location.y)};
+  return {CL_MOVE_TO, makeArgs(location.x, location.y,
+                               _connection.lastDatagramSequenceSent())};
+}
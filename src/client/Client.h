@@ -13,6 +13,7 @@
 #include "../Map.h"
 #include "../messageCodes.h"
 #include "../Point.h"
+#include "../ReceiveBuffer.h"
 #include "../Rect.h"
 #include "../Serial.h"
 #include "../Socket.h"
@@ -57,6 +58,7 @@
 #include "WordWrapper.h"
 
 struct GroupUI;
+struct LoginSnapshot;
 class TextBox;
 
 class Client : public TextEntryManager {
@@ -456,6 +458,11 @@ class Client : public TextEntryManager {
   Stats _stats;                  // The user's stats
   std::string _displaySpeed{0};  // Speed for display as podes/s
   bool _serverHasOutOfDateLocationInfo{true};
+  // Where the user stops is confirmed over TCP, in case the datagram was lost.
+  bool _lastLocationUpdateWasByDatagram{false};
+  // For sending over TCP.  Names the latest datagram sent, so that the server
+  // can ignore any sent earlier that arrive after it.
+  Message tcpLocationMessage() const;
   std::string _allowedTerrain{};  // TerrainList ID.  Empty: default.
 
   // Login screen
@@ -711,18 +718,46 @@ class Client : public TextEntryManager {
   void sendMessage(const Message &msg) const;
 
  private:
-  std::queue<std::string> _messages;
-  std::string _partialMessage;
-  void handleBufferedMessages(const std::string &msg);
+  ReceiveBuffer _messagesFromServer;  // Decoded, but not yet handled
+  ms_t _timeBudgetForMessages{DEFAULT_TIME_BUDGET_FOR_MESSAGES};
+  static const ms_t DEFAULT_TIME_BUDGET_FOR_MESSAGES = 10;
+  bool _shouldRequestDatagramChannel{false};
+  // Handled immediately.  Only the locations of known entities are accepted.
+  void handleMovementDatagram(const char *messages, size_t length);
+  // Handle complete messages until they run out or the time budget is spent.
+  // Whatever is left waits for the next frame.
+  void handleMessagesFromServer();
+  // Stops at the end of the first message handled after the deadline.
+  // lengthHandled is set at the start of each message, so that it is correct
+  // even if a handler returns early.  If there was no deadline to stop for, it
+  // is all of it, including anything that couldn't be parsed.
+  void handleBufferedMessages(const char *messages, size_t length,
+                              ms_t deadline, size_t &lengthHandled);
+
+  // Work that many messages may each call for, done once after each batch
+  struct {
+    bool onlinePlayersList{false};
+    bool warsList{false};
+    bool classWindow{false};
+    bool questLog{false};
+    bool questProgress{false};
+    bool fogOfWar{false};
+    bool mapWindow{false};
+  } _toRefreshAfterMessages;
+  void refreshAfterMessages();
   void performCommand(const std::string &commandString);
   std::vector<MessageCode> _messagesReceived;
   std::mutex _messagesReceivedMutex;
 
  private:
+  void handle_SV_LOGIN_SNAPSHOT(const LoginSnapshot &snapshot);
   void handle_SV_INVENTORY(Serial serial, size_t slot,
                            const std::string &itemID, size_t quantity,
                            Hitpoints itemHealth, bool isSoulbound,
                            std::string suffixID);
+  void handle_SV_PLAYER_HEALTH(const std::string &username,
+                               Hitpoints newHealth);
+  void handle_SV_PLAYER_ENERGY(const std::string &username, Energy newEnergy);
   void handle_SV_MAX_HEALTH(const std::string &username,
                             Hitpoints newMaxHealth);
   void handle_SV_MAX_ENERGY(const std::string &username, Energy newMaxEnergy);
@@ -756,6 +791,8 @@ class Client : public TextEntryManager {
   void handle_SV_REMAINING_BUFF_TIME(const std::string &buffID,
                                      ms_t timeRemaining, bool isBuff);
   void handle_SV_KNOWN_SPELLS(const std::set<std::string> &&knownSpellIDs);
+  // Recipes and constructions affect tooltips, filters and the build list.
+  void refreshAfterLearningRecipes();
   void handle_SV_LEARNED_SPELL(const std::string &spellID);
   void handle_SV_UNLEARNED_SPELL(const std::string &spellID);
   void handle_SV_LEVEL_UP(const std::string &username);
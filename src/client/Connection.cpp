@@ -21,23 +21,89 @@ Connection::~Connection() {
 }
 
 void Connection::getNewMessages() {
+  readDatagrams();
+
   auto readFDs = fd_set{};
   FD_ZERO(&readFDs);
   FD_SET(_socket.getRaw(), &readFDs);
   auto selectTimeout = timeval{0, 10000};
-  auto activity = select(0, &readFDs, nullptr, nullptr, &selectTimeout);
+  auto activity = select(static_cast<int>(_socket.getRaw() + 1), &readFDs,
+                         nullptr, nullptr, &selectTimeout);
   if (activity == SOCKET_ERROR) {
-    showError("Error polling sockets: "s + toString(WSAGetLastError()));
+    showError("Error polling sockets: "s + toString(Socket::lastError()));
     return;
   }
-  if (FD_ISSET(_socket.getRaw(), &readFDs)) {
-    const auto BUFFER_SIZE = 1023;
-    char buffer[BUFFER_SIZE + 1];
+  if (!FD_ISSET(_socket.getRaw(), &readFDs)) return;
+
+  // Take everything that has arrived, so that a burst isn't spread over many
+  // frames.
+  static const size_t BUFFER_SIZE = 65536;
+  static char buffer[BUFFER_SIZE];
+  do {
     auto charsRead = recv(_socket.getRaw(), buffer, BUFFER_SIZE, 0);
-    if (charsRead != SOCKET_ERROR && charsRead != 0) {
-      buffer[charsRead] = '\0';
-      _client->_messages.push({buffer});
-    }
+    if (charsRead == SOCKET_ERROR || charsRead == 0) return;
+    const auto text = _fromServer.toText(buffer, charsRead);
+    _client->_messagesFromServer.append(text.data(), text.size());
+  } while (bytesWaitingToBeRead(_socket.getRaw()) > 0);
+}
+
+void Connection::openDatagramChannel(uint64_t token, u_short port) {
+  if (!_datagrams.open()) return;
+
+  _serverDatagramAddress.sin_family = AF_INET;
+  _serverDatagramAddress.sin_addr.s_addr = inet_addr(serverIP.c_str());
+  _serverDatagramAddress.sin_port = htons(port);
+  _nextDatagram.token = token;
+  _nextDatagram.sequence = 0;
+
+  // An empty datagram, so that the server learns where to send movement
+  sendDatagram({});
+  _timeOfLastDatagramGreeting = SDL_GetTicks();
+}
+
+void Connection::sendByDatagram(const Message &message) {
+  sendDatagram(message.compile());
+}
+
+void Connection::sendDatagram(const std::string &messages) {
+  auto datagram = std::string{};
+  _nextDatagram.appendTo(datagram);
+  datagram.append(messages);
+  _datagrams.sendTo(_serverDatagramAddress, datagram);
+  ++_nextDatagram.sequence;
+}
+
+void Connection::readDatagrams() {
+  if (!_datagrams.isOpen()) return;
+
+  const auto timeNow = SDL_GetTicks();
+  if (!_hasReceivedDatagram &&
+      timeNow - _timeOfLastDatagramGreeting > TIME_BETWEEN_DATAGRAM_GREETINGS) {
+    auto greeting = _nextDatagram;
+    greeting.sequence = 0;  // Never newer than anything that did arrive
+    auto datagram = std::string{};
+    greeting.appendTo(datagram);
+    _datagrams.sendTo(_serverDatagramAddress, datagram);
+    _timeOfLastDatagramGreeting = timeNow;
+  }
+
+  auto datagram = std::string{};
+  auto sender = sockaddr_in{};
+  while (_datagrams.receive(datagram, sender)) {
+    if (!isSameAddress(sender, _serverDatagramAddress)) continue;
+
+    const auto *cursor = datagram.data();
+    const auto *end = cursor + datagram.size();
+    auto header = DatagramHeader{};
+    if (!header.readFrom(cursor, end)) continue;
+    const auto isStale =
+        _hasReceivedDatagram &&
+        !DatagramHeader::isNewer(header.sequence, _lastSequenceReceived);
+    if (isStale) continue;
+    _hasReceivedDatagram = true;
+    _lastSequenceReceived = header.sequence;
+
+    _client->handleMovementDatagram(cursor, end - cursor);
   }
 }
 
@@ -59,10 +125,14 @@ void Connection::connect() {
 
   if (::connect(_socket.getRaw(), (sockaddr *)&serverAddr,
                 Socket::sockAddrSize) < 0) {
-    auto winsockError = WSAGetLastError();
-    showError("Connection error: "s + toString(winsockError));
-    const auto ALREADY_CONNECTED = 10056;
-    if (winsockError == ALREADY_CONNECTED) {
+    auto socketError = Socket::lastError();
+    showError("Connection error: "s + toString(socketError));
+#ifdef _WIN32
+    const auto ALREADY_CONNECTED = WSAEISCONN;
+#else
+    const auto ALREADY_CONNECTED = EISCONN;
+#endif
+    if (socketError == ALREADY_CONNECTED) {
       _state = CONNECTED;
 #ifndef TESTING
       _client->_serverConnectionIndicator->set(Indicator::SUCCEEDED);
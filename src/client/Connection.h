@@ -2,7 +2,9 @@
 
 #include <queue>
 
+#include "../DatagramSocket.h"
 #include "../Socket.h"
+#include "../WireProtocol.h"
 
 class Client;
 
@@ -34,10 +36,26 @@ class Connection {
   bool shouldAttemptReconnection() const;
   std::string serverIP;
 
+  // Movement may also be exchanged with the server over UDP, once it has
+  // provided a token.
+  void openDatagramChannel(uint64_t token, u_short port);
+  bool hasDatagramChannel() const { return _datagrams.isOpen(); }
+  bool hasReceivedDatagram() const { return _hasReceivedDatagram; }
+  void sendByDatagram(const Message &message);
+  uint32_t lastDatagramSequenceSent() const {
+    return _nextDatagram.sequence - 1;  // The greeting is always sent first.
+  }
+
   void showError(const std::string &msg) const;
 
+  // For a location message with no arguments, which was sent in binary
+  bool nextDecodedLocation(DecodedLocation &location) {
+    return _fromServer.nextLocation(location);
+  }
+
  private:
   Socket _socket;
+  ServerStreamDecoder _fromServer;
   State _state{INITIALIZING};
   Client *_client{nullptr};
 
@@ -45,6 +63,17 @@ class Connection {
 
   bool _aThreadIsConnecting{false};
 
+  DatagramSocket _datagrams;
+  sockaddr_in _serverDatagramAddress{};
+  DatagramHeader _nextDatagram;  // Token and sequence
+  uint32_t _lastSequenceReceived{0};
+  bool _hasReceivedDatagram{false};
+  // Until the server has replied, in case the first was lost.
+  ms_t _timeOfLastDatagramGreeting{0};
+  static const ms_t TIME_BETWEEN_DATAGRAM_GREETINGS{1000};
+  void sendDatagram(const std::string &messages);
+  void readDatagrams();
+
   static u_short getServerPort();
 
   static const ms_t TIME_BETWEEN_CONNECTION_ATTEMPTS{3000};
@@ -537,8 +537,7 @@ void Client::handleInput(double delta) {
 
       auto thisDirection = normaliseVector(newLocation - _character.location());
       if (thisDirection != _lastDirection) {
-        sendMessage({CL_MOVE_TO, makeArgs(_character.location().x,
-                                          _character.location().y)});
+        sendMessage(tcpLocationMessage());
         _timeSinceLocUpdate = 0;
       }
       _lastDirection = thisDirection;
@@ -5,6 +5,7 @@
 
 #include "../curlUtil.h"
 #include "../Message.h"
+#include "../WireProtocol.h"
 #include "../threadNaming.h"
 #include "../versionUtil.h"
 #include "../XmlWriter.h"
@@ -55,10 +56,7 @@ void Client::loginScreenLoop() {
   _connection.getNewMessages();
 
   // Deal with any messages from the server
-  if (!_messages.empty()) {
-    handleBufferedMessages(_messages.front());
-    _messages.pop();
-  }
+  handleMessagesFromServer();
 
   showQueuedErrorMessages();
 
@@ -261,6 +259,15 @@ static void saveUsernameAndPassword(const std::string &username,
   xw.publish();
 }
 
+// Ask for the compact protocol, compressed if possible; the server will reply
+// in it from then on.
+static std::string versionAndProtocol() {
+  auto request = ProtocolRequest{};
+  request.protocol = BINARY_PROTOCOL;
+  request.compression = isCompressionAvailable();
+  return versionWithProtocolRequest(version(), request);
+}
+
 void Client::createAccount() {
   auto username = loginScreenElements.newNameBox->text();
   loginScreenElements.newNameBox->text(username);
@@ -270,7 +277,7 @@ void Client::createAccount() {
   auto pwHash =
       picosha2::hash256_hex_string(loginScreenElements.newPwBox->text());
   sendMessage(
-      {CL_LOGIN_NEW, makeArgs(username, pwHash, selectedClass, version())});
+      {CL_LOGIN_NEW, makeArgs(username, pwHash, selectedClass, versionAndProtocol())});
 
   saveUsernameAndPassword(_username, pwHash);
 }
@@ -287,13 +294,14 @@ void Client::login() {
   auto shouldCallCreateInsteadOfLogin = !_autoClassID.empty();
   if (shouldCallCreateInsteadOfLogin) {
     pwHash = picosha2::hash256_hex_string(loginScreenElements.newPwBox->text());
-    sendMessage(
-        {CL_LOGIN_NEW, makeArgs(_username, pwHash, _autoClassID, version())});
+    sendMessage({CL_LOGIN_NEW,
+                 makeArgs(_username, pwHash, _autoClassID, versionAndProtocol())});
   } else {
     pwHash = _savedPwHash;
     if (pwHash.empty())
       pwHash = picosha2::hash256_hex_string(loginScreenElements.pwBox->text());
-    sendMessage({CL_LOGIN_EXISTING, makeArgs(_username, pwHash, version())});
+    sendMessage({CL_LOGIN_EXISTING,
+                 makeArgs(_username, pwHash, versionAndProtocol())});
   }
 
   saveUsernameAndPassword(_username, pwHash);
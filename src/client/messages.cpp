@@ -1,7 +1,11 @@
 #include <cassert>
+#include <limits>
 #include <mutex>
 
 #include "../Message.h"
+#include "../LoginSnapshot.h"
+#include "../MessageParser.h"
+#include "../MessageSchema.h"
 #include "../versionUtil.h"
 #include "CDroppedItem.h"
 #include "Client.h"
@@ -37,45 +41,86 @@ std::istream &operator>>(std::istream &lhs, std::string &rhs) {
   return lhs;
 }
 
-void Client::handleBufferedMessages(const std::string &msg) {
-  _partialMessage.append(msg);
-  std::istringstream iss(_partialMessage);
-  _partialMessage = "";
+void Client::handleMessagesFromServer() {
+  const auto deadline = SDL_GetTicks() + _timeBudgetForMessages;
+  while (_messagesFromServer.hasCompleteMessages()) {
+    auto lengthHandled = size_t{0};
+    handleBufferedMessages(_messagesFromServer.completeMessages(),
+                           _messagesFromServer.completeMessagesLength(),
+                           deadline, lengthHandled);
+    _messagesFromServer.discardMessages(lengthHandled);
+    if (SDL_GetTicks() >= deadline) break;
+  }
+
+  refreshAfterMessages();
+}
+
+void Client::handleMovementDatagram(const char *messages, size_t length) {
+  // Anything else, including news of who has appeared, comes over TCP.  A
+  // datagram can arrive after a user has been removed, and mustn't bring them
+  // back.
+  auto parser = MessageParser{messages, length};
+  while (parser.hasAnotherMessage()) {
+    const auto messageStart = parser.lengthParsed();
+    const auto code = parser.nextMessage();
+    const auto messageLength = parser.lengthUpToEndOfMessage() - messageStart;
+
+    if (code == SV_USER_LOCATION) {
+      auto name = std::string{};
+      double x, y;
+      if (!parser.readArgs(name, x, y)) continue;
+      const auto isKnown =
+          name == _username || _otherUsers.find(name) != _otherUsers.end();
+      if (!isKnown) continue;
+    } else if (code != SV_ENTITY_LOCATION)
+      continue;
+
+    auto lengthHandled = size_t{0};
+    const auto NO_DEADLINE = std::numeric_limits<ms_t>::max();
+    handleBufferedMessages(messages + messageStart, messageLength, NO_DEADLINE,
+                           lengthHandled);
+  }
+}
+
+void Client::refreshAfterMessages() {
+  auto &toRefresh = _toRefreshAfterMessages;
+
+  if (toRefresh.onlinePlayersList) populateOnlinePlayersList();
+  if (toRefresh.warsList) populateWarsList();
+  if (toRefresh.classWindow) populateClassWindow();
+  if (toRefresh.questLog) populateQuestLog();
+  if (toRefresh.questLog || toRefresh.questProgress) refreshQuestProgress();
+
+  // Redrawing the fog of war also updates the map window.
+  if (toRefresh.fogOfWar)
+    redrawFogOfWar();
+  else if (toRefresh.mapWindow)
+    updateMapWindow(Element{});
+
+  toRefresh = {};
+}
+
+void Client::handleBufferedMessages(const char *messages, size_t length,
+                                    ms_t deadline, size_t &lengthHandled) {
+  auto parser = MessageParser{messages, length};
   int msgCode;
   char del;
+
+  // Handlers that haven't been converted to parser.readArgs() read from this
+  // stream, which views the rest of the current message in place.
+  auto restOfMessage = MessageParser::ArrayBuffer{};
+  auto singleMsg = std::istream{&restOfMessage};
   const auto BUFFER_SIZE = 1023;
   static char buffer[BUFFER_SIZE + 1];
-  std::mutex bufferMutex;
 
-  // Read while there are new messages
-  while (!iss.eof()) {
-    std::lock_guard<std::mutex> bufferLock(bufferMutex);
+  while (parser.hasAnotherMessage()) {
+    if (lengthHandled > 0 && SDL_GetTicks() >= deadline) return;
+    lengthHandled = parser.lengthUpToEndOfMessage();
 
-    // Discard malformed data
-    if (iss.peek() != MSG_START) {
-      iss.get(buffer, BUFFER_SIZE, MSG_START);
-      /*_debug << "Read " << iss.gcount() << " characters." << Log::endl;
-      showErrorMessage("Malformed message; discarded \""s + buffer + "\""s,
-      Color::ERR);*/
-      if (iss.eof()) {
-        break;
-      }
-    }
-
-    // Get next message
-    iss.get(buffer, BUFFER_SIZE, MSG_END);
-    if (iss.eof()) {
-      _partialMessage = buffer;
-      break;
-    } else {
-      std::streamsize charsRead = iss.gcount();
-      buffer[charsRead] = MSG_END;
-      buffer[charsRead + 1] = '\0';
-      iss.ignore();  // Throw away ']'
-    }
-    std::istringstream singleMsg(buffer);
-    //_debug(buffer, Color::CYAN);
-    singleMsg >> del >> msgCode >> del;
+    msgCode = parser.nextMessage();
+    del = parser.getLastDelimiterRead();
+    restOfMessage.view(parser.restOfMessage());
+    singleMsg.clear();
 
     _messagesReceivedMutex.lock();
     _messagesReceived.push_back(MessageCode(msgCode));
@@ -101,7 +146,7 @@ void Client::handleBufferedMessages(const std::string &msg) {
 #endif
         _debug("Welcome to Hellas!");
         _allOnlinePlayers.insert(_username);
-        populateOnlinePlayersList();
+        _toRefreshAfterMessages.onlinePlayersList = true;
         _inventoryWindow->show();
         break;
       }
@@ -111,15 +156,27 @@ void Client::handleBufferedMessages(const std::string &msg) {
         _loaded = true;
         _lastPingReply = _time;
         sendMessage(CL_FINISHED_RECEIVING_LOGIN_INFO);
+        if (_shouldRequestDatagramChannel)
+          sendMessage(CL_REQUEST_DATAGRAM_CHANNEL);
 
         if (_loaded) _unlockFilter->onUnlockChancesChanged(_knownRecipes);
 
         break;
 
+      case SV_LOGIN_SNAPSHOT: {
+        auto snapshot = LoginSnapshot{};
+        if (!MessageSchema<SV_LOGIN_SNAPSHOT>::read(parser, snapshot)) {
+          showErrorMessage("Received a malformed login snapshot; ignored.",
+                           Color::CHAT_ERROR);
+          break;
+        }
+        handle_SV_LOGIN_SNAPSHOT(snapshot);
+        break;
+      }
+
       case SV_PING_REPLY: {
         ms_t timeSent;
-        singleMsg >> timeSent >> del;
-        if (del != MSG_END) break;
+        if (!parser.readArgs(timeSent)) break;
         _lastPingReply = _time;
         _latency = (_time - timeSent) / 2;
         break;
@@ -142,7 +199,7 @@ void Client::handleBufferedMessages(const std::string &msg) {
 
         _debug << name << " has joined the world." << Log::endl;
         _allOnlinePlayers.insert(name);
-        populateOnlinePlayersList();
+        _toRefreshAfterMessages.onlinePlayersList = true;
         break;
       }
 
@@ -155,16 +212,14 @@ void Client::handleBufferedMessages(const std::string &msg) {
           singleMsg >> del;
           _allOnlinePlayers.insert(name);
         }
-        populateOnlinePlayersList();
+        _toRefreshAfterMessages.onlinePlayersList = true;
         break;
       }
 
       case SV_USER_DISCONNECTED:
       case SV_USER_OUT_OF_RANGE: {
         std::string name;
-        readString(singleMsg, name, MSG_END);
-        singleMsg >> del;
-        if (del != MSG_END) break;
+        if (!parser.readArgs(name)) break;
         const std::map<std::string, Avatar *>::iterator it =
             _otherUsers.find(name);
         if (it != _otherUsers.end()) {
@@ -186,7 +241,7 @@ void Client::handleBufferedMessages(const std::string &msg) {
         if (msgCode == SV_USER_DISCONNECTED) {
           _debug << name << " has left the world." << Log::endl;
           _allOnlinePlayers.erase(name);
-          populateOnlinePlayersList();
+          _toRefreshAfterMessages.onlinePlayersList = true;
           groupUI->refresh();
         }
         break;
@@ -267,6 +322,7 @@ void Client::handleBufferedMessages(const std::string &msg) {
       case WARNING_PET_AT_FULL_HEALTH:
       case WARNING_NOWHERE_TO_DROP_ITEM:
       case WARNING_USER_ALREADY_IN_A_GROUP:
+      case WARNING_TOO_MANY_MESSAGES:
       case WARNING_WARE_IS_SOULBOUND:
       case WARNING_PRICE_IS_SOULBOUND:
       case WARNING_WARE_IS_BROKEN:
@@ -391,6 +447,14 @@ void Client::handleBufferedMessages(const std::string &msg) {
         break;
       }
 
+      case SV_DATAGRAM_CHANNEL: {
+        uint64_t token;
+        u_short port;
+        if (!parser.readArgs(token, port)) break;
+        _connection.openDatagramChannel(token, port);
+        break;
+      }
+
       case SV_ACTION_STARTED:
         ms_t time;
         singleMsg >> time >> del;
@@ -460,8 +524,14 @@ void Client::handleBufferedMessages(const std::string &msg) {
       case SV_USER_LOCATION_INSTANT: {
         std::string name;
         double x, y;
-        singleMsg >> name >> del >> x >> del >> y >> del;
-        if (del != MSG_END) break;
+        if (del == MSG_END) {
+          auto decoded = DecodedLocation{};
+          if (!_connection.nextDecodedLocation(decoded)) break;
+          name = std::move(decoded.username);
+          x = decoded.location.x;
+          y = decoded.location.y;
+        } else if (!parser.readArgs(name, x, y))
+          break;
         const MapPoint p(x, y);
         auto isSelf = name == _username;
         if (isSelf) {
@@ -526,7 +596,7 @@ void Client::handleBufferedMessages(const std::string &msg) {
         if (username == _username) {
           _character.setClass(classID);
           _character.level(level);
-          populateClassWindow();
+          _toRefreshAfterMessages.classWindow = true;
 
           // Redraw tooltips, in case gear level requirements are no longer red
           for (auto &pair : gameData.items) pair.second.refreshTooltip();
@@ -589,20 +659,18 @@ void Client::handleBufferedMessages(const std::string &msg) {
       }
 
       case SV_INVENTORY: {
+        using Schema = MessageSchema<SV_INVENTORY>;
         auto serial = Serial{};
+        if (!Schema::readLeadingFields(parser, serial)) break;
         size_t slot, quantity;
         auto itemHealth = Hitpoints{};
         auto itemID = ""s;
         auto isSoulbound = 0;
         auto suffixID = ""s;
-        singleMsg >> serial >> del >> slot >> del >> itemID >> del >>
-            quantity >> del >> itemHealth >> del >> isSoulbound >> del;
-        readString(singleMsg, suffixID, MSG_END);
-        singleMsg >> del;
-        if (del != MSG_END) break;
-
-        handle_SV_INVENTORY(serial, slot, itemID, quantity, itemHealth,
-                            isSoulbound != 0, suffixID);
+        while (Schema::readNextGroup(parser, slot, itemID, quantity,
+                                     itemHealth, isSoulbound, suffixID))
+          handle_SV_INVENTORY(serial, slot, itemID, quantity, itemHealth,
+                              isSoulbound != 0, suffixID);
         break;
       }
 
@@ -797,8 +865,14 @@ void Client::handleBufferedMessages(const std::string &msg) {
       case SV_ENTITY_LOCATION: {
         Serial serial;
         double x, y;
-        singleMsg >> serial >> del >> x >> del >> y >> del;
-        if (del != MSG_END) break;
+        if (del == MSG_END) {
+          auto decoded = DecodedLocation{};
+          if (!_connection.nextDecodedLocation(decoded)) break;
+          serial = decoded.serial;
+          x = decoded.location.x;
+          y = decoded.location.y;
+        } else if (!parser.readArgs(serial, x, y))
+          break;
         std::map<Serial, ClientObject *>::iterator it = _objects.find(serial);
         if (it == _objects.end()) break;  // We didn't know about this object
 
@@ -829,8 +903,7 @@ void Client::handleBufferedMessages(const std::string &msg) {
       case SV_OBJECT_REMOVED:
       case SV_OBJECT_OUT_OF_RANGE: {
         Serial serial;
-        singleMsg >> serial >> del;
-        if (del != MSG_END) break;
+        if (!parser.readArgs(serial)) break;
         const auto it = _objects.find(serial);
         if (it == _objects.end()) break;  // We didn't know about this object
         if (it->second == _currentMouseOverEntity)
@@ -974,16 +1047,7 @@ void Client::handleBufferedMessages(const std::string &msg) {
           }
         }
 
-        // For unlock info
-        for (auto &pair : gameData.items) pair.second.refreshTooltip();
-        if (_detailsPane) refreshRecipeDetailsPane();
-        for (const auto &ot : gameData.objectTypes)
-          ot->refreshConstructionTooltip();
-        for (const auto &ent : _entities) ent->refreshTooltip();
-        populateBuildList();
-        if (_recipeList) {
-          _recipeList->markChanged();
-        }
+        refreshAfterLearningRecipes();
 
         break;
       }
@@ -1011,16 +1075,7 @@ void Client::handleBufferedMessages(const std::string &msg) {
           }
         }
 
-        // For unlock info
-        for (auto &pair : gameData.items) pair.second.refreshTooltip();
-        if (_detailsPane) refreshRecipeDetailsPane();
-        for (const auto &ot : gameData.objectTypes)
-          ot->refreshConstructionTooltip();
-        for (const auto &ent : _entities) ent->refreshTooltip();
-        populateBuildList();
-        if (_recipeList) {
-          _recipeList->markChanged();
-        }
+        refreshAfterLearningRecipes();
 
         break;
       }
@@ -1028,8 +1083,8 @@ void Client::handleBufferedMessages(const std::string &msg) {
       case SV_ENTITY_HEALTH: {
         Serial serial;
         Hitpoints health;
-        singleMsg >> serial >> del >> health >> del;
-        if (del != MSG_END) break;
+        if (!MessageSchema<SV_ENTITY_HEALTH>::read(parser, serial, health))
+          break;
         const auto it = _objects.find(serial);
         if (it == _objects.end()) {
           // showErrorMessage("Received health info for an unknown object.",
@@ -1054,9 +1109,9 @@ void Client::handleBufferedMessages(const std::string &msg) {
       case SV_PLAYER_HIT_ENTITY: {
         std::string username;
         Serial serial;
-        readString(singleMsg, username, MSG_DELIM);
-        singleMsg >> del >> serial >> del;
-        if (del != MSG_END) break;
+        if (!MessageSchema<SV_PLAYER_HIT_ENTITY>::read(parser, username,
+                                                       serial))
+          break;
         auto *attacker = findUser(username);
         if (!attacker) break;
 
@@ -1078,10 +1133,9 @@ void Client::handleBufferedMessages(const std::string &msg) {
       case SV_ENTITY_HIT_PLAYER: {
         Serial serial;
         std::string username;
-        singleMsg >> serial >> del;
-        readString(singleMsg, username, MSG_END);
-        singleMsg >> del;
-        if (del != MSG_END) break;
+        if (!MessageSchema<SV_ENTITY_HIT_PLAYER>::read(parser, serial,
+                                                       username))
+          break;
         auto objIt = _objects.find(serial);
         if (objIt == _objects.end()) {
           // showErrorMessage("Received combat info for an unknown object.",
@@ -1104,9 +1158,9 @@ void Client::handleBufferedMessages(const std::string &msg) {
 
       case SV_ENTITY_HIT_ENTITY: {
         Serial attackerSerial, defenderSerial;
-        singleMsg >> attackerSerial >> del >> defenderSerial >> del;
-        singleMsg >> del;
-        if (del != MSG_END) break;
+        if (!MessageSchema<SV_ENTITY_HIT_ENTITY>::read(parser, attackerSerial,
+                                                       defenderSerial))
+          break;
 
         auto attackerIt = _objects.find(attackerSerial);
         if (attackerIt == _objects.end()) {
@@ -1133,11 +1187,9 @@ void Client::handleBufferedMessages(const std::string &msg) {
 
       case SV_PLAYER_HIT_PLAYER: {
         std::string attackerName, defenderName;
-        readString(singleMsg, attackerName);
-        singleMsg >> del;
-        readString(singleMsg, defenderName, MSG_END);
-        singleMsg >> del;
-        if (del != MSG_END) break;
+        if (!MessageSchema<SV_PLAYER_HIT_PLAYER>::read(parser, attackerName,
+                                                       defenderName))
+          break;
 
         auto *attacker = findUser(attackerName);
         if (!attacker) break;
@@ -1189,36 +1241,17 @@ void Client::handleBufferedMessages(const std::string &msg) {
       case SV_PLAYER_HEALTH: {
         std::string username;
         Hitpoints newHealth;
-        readString(singleMsg, username, MSG_DELIM);
-        singleMsg >> del >> newHealth >> del;
-        if (del != MSG_END) break;
-
-        groupUI->onPlayerHealthChange(username, newHealth);
-
-        Avatar *target = nullptr;
-        if (username == _username)
-          target = &_character;
-        else {
-          auto userIt = _otherUsers.find(username);
-          if (userIt == _otherUsers.end()) {
-            // showErrorMessage("Received combat info for an unknown defending
-            // player.", Color::TODO);
-            break;
-          }
-          target = userIt->second;
-        }
-        if (newHealth < target->health()) target->createDamageParticles();
-        target->health(newHealth);
-        if (targetAsEntity() == target) _target.updateHealth(newHealth);
+        if (!MessageSchema<SV_PLAYER_HEALTH>::read(parser, username, newHealth))
+          break;
+        handle_SV_PLAYER_HEALTH(username, newHealth);
         break;
       }
 
       case SV_PLAYER_DAMAGED: {
         auto username = ""s;
         auto amount = Hitpoints{};
-        readString(singleMsg, username, MSG_DELIM);
-        singleMsg >> del >> amount >> del;
-        if (del != MSG_END) break;
+        if (!MessageSchema<SV_PLAYER_DAMAGED>::read(parser, username, amount))
+          break;
         handle_SV_PLAYER_DAMAGED(username, amount);
         break;
       }
@@ -1226,9 +1259,8 @@ void Client::handleBufferedMessages(const std::string &msg) {
       case SV_PLAYER_HEALED: {
         auto username = ""s;
         auto amount = Hitpoints{};
-        readString(singleMsg, username, MSG_DELIM);
-        singleMsg >> del >> amount >> del;
-        if (del != MSG_END) break;
+        if (!MessageSchema<SV_PLAYER_HEALED>::read(parser, username, amount))
+          break;
         handle_SV_PLAYER_HEALED(username, amount);
         break;
       }
@@ -1236,8 +1268,8 @@ void Client::handleBufferedMessages(const std::string &msg) {
       case SV_OBJECT_DAMAGED: {
         auto serial = Serial{};
         auto amount = Hitpoints{};
-        singleMsg >> serial >> del >> amount >> del;
-        if (del != MSG_END) break;
+        if (!MessageSchema<SV_OBJECT_DAMAGED>::read(parser, serial, amount))
+          break;
         handle_SV_OBJECT_DAMAGED(serial, amount);
         break;
       }
@@ -1245,8 +1277,8 @@ void Client::handleBufferedMessages(const std::string &msg) {
       case SV_OBJECT_HEALED: {
         auto serial = Serial{};
         auto amount = Hitpoints{};
-        singleMsg >> serial >> del >> amount >> del;
-        if (del != MSG_END) break;
+        if (!MessageSchema<SV_OBJECT_HEALED>::read(parser, serial, amount))
+          break;
         handle_SV_OBJECT_HEALED(serial, amount);
         break;
       }
@@ -1266,26 +1298,9 @@ void Client::handleBufferedMessages(const std::string &msg) {
       case SV_PLAYER_ENERGY: {
         std::string username;
         auto newEnergy = Energy{};
-        readString(singleMsg, username, MSG_DELIM);
-        singleMsg >> del >> newEnergy >> del;
-        if (del != MSG_END) break;
-
-        groupUI->onPlayerEnergyChange(username, newEnergy);
-
-        Avatar *target = nullptr;
-        if (username == _username)
-          target = &_character;
-        else {
-          auto userIt = _otherUsers.find(username);
-          if (userIt == _otherUsers.end()) {
-            // showErrorMessage("Received combat info for an unknown defending
-            // player.", Color::TODO);
-            break;
-          }
-          target = userIt->second;
-        }
-        target->energy(newEnergy);
-        if (targetAsEntity() == target) _target.updateEnergy(newEnergy);
+        if (!MessageSchema<SV_PLAYER_ENERGY>::read(parser, username, newEnergy))
+          break;
+        handle_SV_PLAYER_ENERGY(username, newEnergy);
         break;
       }
 
@@ -1386,7 +1401,7 @@ void Client::handleBufferedMessages(const std::string &msg) {
         if (del != MSG_END) break;
         _xp = xp;
         _maxXP = maxXP;
-        populateClassWindow();
+        _toRefreshAfterMessages.classWindow = true;
         break;
       }
 
@@ -1422,24 +1437,41 @@ void Client::handleBufferedMessages(const std::string &msg) {
 
       case SV_MAX_HEALTH: {
         auto username = ""s;
-        readString(singleMsg, username);
         auto newMaxHealth = Hitpoints{};
-        singleMsg >> del >> newMaxHealth >> del;
-        if (del != MSG_END) break;
+        if (!MessageSchema<SV_MAX_HEALTH>::read(parser, username, newMaxHealth))
+          break;
         handle_SV_MAX_HEALTH(username, newMaxHealth);
         break;
       }
 
       case SV_MAX_ENERGY: {
         auto username = ""s;
-        readString(singleMsg, username);
         auto newMaxEnergy = Energy{};
-        singleMsg >> del >> newMaxEnergy >> del;
-        if (del != MSG_END) break;
+        if (!MessageSchema<SV_MAX_ENERGY>::read(parser, username, newMaxEnergy))
+          break;
         handle_SV_MAX_ENERGY(username, newMaxEnergy);
         break;
       }
 
+      case SV_PLAYER_VITALS: {
+        using Schema = MessageSchema<SV_PLAYER_VITALS>;
+        auto username = ""s;
+        if (!Schema::readLeadingFields(parser, username)) break;
+        auto vital = 0;
+        auto value = unsigned{};
+        while (Schema::readNextGroup(parser, vital, value)) {
+          if (vital == SV_PLAYER_HEALTH)
+            handle_SV_PLAYER_HEALTH(username, value);
+          else if (vital == SV_PLAYER_ENERGY)
+            handle_SV_PLAYER_ENERGY(username, value);
+          else if (vital == SV_MAX_HEALTH)
+            handle_SV_MAX_HEALTH(username, value);
+          else if (vital == SV_MAX_ENERGY)
+            handle_SV_MAX_ENERGY(username, value);
+        }
+        break;
+      }
+
       case SV_MERCHANT_SLOT: {
         auto serial = Serial{};
         size_t slot, wareQty, priceQty;
@@ -1533,7 +1565,7 @@ void Client::handleBufferedMessages(const std::string &msg) {
 
         _mapWindow->markChanged();
 
-        populateWarsList();
+        _toRefreshAfterMessages.warsList = true;
         break;
       }
 
@@ -1564,7 +1596,7 @@ void Client::handleBufferedMessages(const std::string &msg) {
         _debug << name << " has sued for peace" << Log::endl;
 
         _mapWindow->markChanged();
-        populateWarsList();
+        _toRefreshAfterMessages.warsList = true;
         break;
       }
 
@@ -1595,7 +1627,7 @@ void Client::handleBufferedMessages(const std::string &msg) {
         _debug << "You have sued for peace with " << name << Log::endl;
 
         _mapWindow->markChanged();
-        populateWarsList();
+        _toRefreshAfterMessages.warsList = true;
         break;
       }
 
@@ -1649,7 +1681,7 @@ void Client::handleBufferedMessages(const std::string &msg) {
         }
 
         _mapWindow->markChanged();
-        populateWarsList();
+        _toRefreshAfterMessages.warsList = true;
         break;
       }
 
@@ -1687,7 +1719,7 @@ void Client::handleBufferedMessages(const std::string &msg) {
         toast("helmet", message);
 
         _mapWindow->markChanged();
-        populateWarsList();
+        _toRefreshAfterMessages.warsList = true;
       }
 
       case SV_SPELL_HIT:
@@ -1932,7 +1964,7 @@ void Client::handleBufferedMessages(const std::string &msg) {
         if (del != MSG_END) return;
 
         _talentLevels[talentName] = level;
-        populateClassWindow();
+        _toRefreshAfterMessages.classWindow = true;
         break;
       }
 
@@ -1960,7 +1992,7 @@ void Client::handleBufferedMessages(const std::string &msg) {
         if (del != MSG_END) return;
 
         _pointsInTrees[treeName] = points;
-        populateClassWindow();
+        _toRefreshAfterMessages.classWindow = true;
         break;
       }
 
@@ -1980,7 +2012,7 @@ void Client::handleBufferedMessages(const std::string &msg) {
 
         _talentLevels.clear();
         _pointsInTrees.clear();
-        populateClassWindow();
+        _toRefreshAfterMessages.classWindow = true;
         refreshHotbar();
         break;
       }
@@ -2091,7 +2123,7 @@ void Client::handleBufferedMessages(const std::string &msg) {
         auto it = gameData.quests.find(questID);
         if (it == gameData.quests.end()) break;
         it->second.setTimeRemaining(timeRemaining);
-        refreshQuestProgress();
+        _toRefreshAfterMessages.questProgress = true;
 
         break;
       }
@@ -2129,8 +2161,7 @@ void Client::handleBufferedMessages(const std::string &msg) {
         auto chunksX = _map.width() / Client::TILES_PER_CHUNK;
         auto chunksY = _map.height() / Client::TILES_PER_CHUNK;
         _mapExplored = {chunksX, std::vector<bool>(chunksY, false)};
-        redrawFogOfWar();
-        updateMapWindow(Element{});
+        _toRefreshAfterMessages.fogOfWar = true;
         break;
       }
 
@@ -2276,14 +2307,79 @@ void Client::handleBufferedMessages(const std::string &msg) {
                  // Color::TODO);
     }
 
-    if (del != MSG_END && !iss.eof()) {
+    const auto wasReadToTheEnd =
+        del == MSG_END || parser.getLastDelimiterRead() == MSG_END;
+    if (!wasReadToTheEnd) {
       showErrorMessage("Bad message ending. code="s + toString(msgCode) +
                            "; remaining message = "s + toString(del) +
-                           singleMsg.str(),
+                           std::string{parser.restOfMessage()},
                        Color::CHAT_ERROR);
     }
+  }
+
+  // Anything left among the complete messages can't be parsed, and never will
+  // be.  Left in the buffer, it would be retried every frame.
+  lengthHandled = length;
+}
 
-    iss.peek();
+void Client::handle_SV_LOGIN_SNAPSHOT(const LoginSnapshot &snapshot) {
+  for (const auto &item : snapshot.inventory)
+    handle_SV_INVENTORY(Serial::Inventory(), item.slot, item.id, item.quantity,
+                        item.health, item.isSoulbound, item.suffix);
+  for (const auto &item : snapshot.gear)
+    handle_SV_INVENTORY(Serial::Gear(), item.slot, item.id, item.quantity,
+                        item.health, item.isSoulbound, item.suffix);
+
+  // Refreshed once for the lot, rather than once per batch
+  for (const auto &id : snapshot.recipes) {
+    _knownRecipes.insert(id);
+    auto it = gameData.recipes.find(id);
+    if (it != gameData.recipes.end()) indexRecipeInAllFilters(*it);
+  }
+  _knownConstructions = {snapshot.constructions.begin(),
+                         snapshot.constructions.end()};
+  refreshAfterLearningRecipes();
+
+  handle_SV_KNOWN_SPELLS({snapshot.spells.begin(), snapshot.spells.end()});
+
+  for (const auto &pair : snapshot.talentRanks)
+    _talentLevels[pair.first] = pair.second;
+  for (const auto &pair : snapshot.pointsInTrees)
+    _pointsInTrees[pair.first] = pair.second;
+  _toRefreshAfterMessages.classWindow = true;
+
+  for (const auto &quest : snapshot.quests) {
+    if (quest.canBeFinished)
+      handle_SV_QUEST_CAN_BE_FINISHED(quest.id);
+    else if (quest.progress.empty())
+      handle_SV_QUEST_IN_PROGRESS(quest.id);
+    for (const auto &pair : quest.progress)
+      handle_SV_QUEST_PROGRESS(quest.id, pair.first, pair.second);
+  }
+
+  auto explored = snapshot.exploration();
+  const auto isSameSizeAsMap =
+      explored.size() == _mapExplored.size() &&
+      (explored.empty() ||
+       explored.front().size() == _mapExplored.front().size());
+  if (!isSameSizeAsMap) {
+    _debug("Map-exploration data doesn't match the map; ignored.",
+           Color::CHAT_ERROR);
+    return;
+  }
+  _mapExplored = std::move(explored);
+  _toRefreshAfterMessages.fogOfWar = true;
+}
+
+void Client::refreshAfterLearningRecipes() {
+  // For unlock info
+  for (auto &pair : gameData.items) pair.second.refreshTooltip();
+  if (_detailsPane) refreshRecipeDetailsPane();
+  for (const auto &ot : gameData.objectTypes) ot->refreshConstructionTooltip();
+  for (const auto &ent : _entities) ent->refreshTooltip();
+  populateBuildList();
+  if (_recipeList) {
+    _recipeList->markChanged();
   }
 }
 
@@ -2360,6 +2456,47 @@ void Client::handle_SV_INVENTORY(Serial serial, size_t slot,
     object->onInventoryUpdate();
 }
 
+void Client::handle_SV_PLAYER_HEALTH(const std::string &username,
+                                     Hitpoints newHealth) {
+  groupUI->onPlayerHealthChange(username, newHealth);
+
+  Avatar *target = nullptr;
+  if (username == _username)
+    target = &_character;
+  else {
+    auto userIt = _otherUsers.find(username);
+    if (userIt == _otherUsers.end()) {
+      // showErrorMessage("Received combat info for an unknown defending
+      // player.", Color::TODO);
+      return;
+    }
+    target = userIt->second;
+  }
+  if (newHealth < target->health()) target->createDamageParticles();
+  target->health(newHealth);
+  if (targetAsEntity() == target) _target.updateHealth(newHealth);
+}
+
+void Client::handle_SV_PLAYER_ENERGY(const std::string &username,
+                                     Energy newEnergy) {
+  groupUI->onPlayerEnergyChange(username, newEnergy);
+
+  Avatar *target = nullptr;
+  if (username == _username)
+    target = &_character;
+  else {
+    auto userIt = _otherUsers.find(username);
+    if (userIt == _otherUsers.end()) {
+      // showErrorMessage("Received combat info for an unknown defending
+      // player.", Color::TODO);
+      return;
+    }
+    target = userIt->second;
+  }
+  target->energy(newEnergy);
+  if (targetAsEntity() == target) _target.updateEnergy(newEnergy);
+}
+
 void Client::handle_SV_MAX_HEALTH(const std::string &username,
                                   Hitpoints newMaxHealth) {
   if (username == _username) {
@@ -2714,7 +2851,7 @@ void Client::handle_SV_LEVEL_UP(const std::string &username) {
   groupUI->onPlayerLevelChange(username, avatar->level());
 
   if (username == _username) {
-    populateClassWindow();
+    _toRefreshAfterMessages.classWindow = true;
 
     generalSounds()->playOnce(*this, "levelUp");
 
@@ -2723,8 +2860,7 @@ void Client::handle_SV_LEVEL_UP(const std::string &username) {
     toast("light", message);
 
     // Refresh these, since they may change colour with the reduced difficulty
-    populateQuestLog();
-    refreshQuestProgress();
+    _toRefreshAfterMessages.questLog = true;
     if (_target.panel()) _target.panel()->setLevelColor(_target.level());
 
     // Redraw tooltips, in case gear level requirements are no longer red
@@ -2803,8 +2939,7 @@ void Client::handle_SV_QUEST_CAN_BE_STARTED(const std::string &questID) {
     if (objType == startNode || objType == endNode) obj.assembleWindow(*this);
   }
 
-  populateQuestLog();
-  refreshQuestProgress();
+  _toRefreshAfterMessages.questLog = true;
 }
 
 void Client::handle_SV_QUEST_IN_PROGRESS(const std::string &questID) {
@@ -2822,8 +2957,7 @@ void Client::handle_SV_QUEST_IN_PROGRESS(const std::string &questID) {
     if (objType == startNode || objType == endNode) obj.assembleWindow(*this);
   }
 
-  populateQuestLog();
-  refreshQuestProgress();
+  _toRefreshAfterMessages.questLog = true;
 }
 
 void Client::handle_SV_QUEST_CAN_BE_FINISHED(const std::string &questID) {
@@ -2841,8 +2975,7 @@ void Client::handle_SV_QUEST_CAN_BE_FINISHED(const std::string &questID) {
     if (objType == startNode || objType == endNode) obj.assembleWindow(*this);
   }
 
-  populateQuestLog();
-  refreshQuestProgress();
+  _toRefreshAfterMessages.questLog = true;
 }
 
 void Client::handle_SV_QUEST_COMPLETED(const std::string &questID) {
@@ -2862,8 +2995,7 @@ void Client::handle_SV_QUEST_COMPLETED(const std::string &questID) {
 
   generalSounds()->playOnce(*this, "quest");
 
-  populateQuestLog();
-  refreshQuestProgress();
+  _toRefreshAfterMessages.questLog = true;
 }
 
 void Client::handle_SV_QUEST_ACCEPTED() {
@@ -2879,8 +3011,7 @@ void Client::handle_SV_QUEST_PROGRESS(const std::string &questID,
 
   it->second.setProgress(objectiveIndex, progress);
 
-  populateQuestLog();
-  refreshQuestProgress();
+  _toRefreshAfterMessages.questLog = true;
 }
 
 void Client::handle_SV_MAP_EXPLORATION_DATA(size_t column,
@@ -2900,7 +3031,8 @@ void Client::handle_SV_MAP_EXPLORATION_DATA(size_t column,
 
   _mapExplored[column] = colV;
 
-  if (column == _mapExplored.size() - 1) redrawFogOfWar();
+  if (column == _mapExplored.size() - 1)
+    _toRefreshAfterMessages.fogOfWar = true;
 }
 
 void Client::handle_SV_CHUNK_EXPLORED(size_t chunkX, size_t chunkY) {
@@ -2913,7 +3045,7 @@ void Client::handle_SV_CHUNK_EXPLORED(size_t chunkX, size_t chunkY) {
   _mapExplored[chunkX][chunkY] = true;
 
   clearChunkFromFogOfWar(chunkX, chunkY);
-  updateMapWindow(Element{});
+  _toRefreshAfterMessages.mapWindow = true;
 }
 
 void Client::sendMessage(const Message &msg) const {
@@ -3069,6 +3201,8 @@ void Client::initializeMessageNames() {
   _errorMessages[ERROR_USER_NOT_FOUND] = "Cannot find that player.";
   _errorMessages[WARNING_USER_ALREADY_IN_A_GROUP] =
       "That player is already in a group.";
+  _errorMessages[WARNING_TOO_MANY_MESSAGES] =
+      "You are doing that too quickly.";
   _errorMessages[WARNING_WARE_IS_SOULBOUND] =
       "That object's items in stock are soulbound.";
   _errorMessages[WARNING_PRICE_IS_SOULBOUND] =
@@ -6,6 +6,8 @@ const char MSG_START = '\002',  // STX
     MSG_END = '\003',           // ETX
     MSG_DELIM = '\037';         // US
 
+// Where a code has a declaration in MessageSchema.h, that is the authority on
+// its arguments; the comments here are a summary.
 enum MessageCode {
 
   // These first three messages should never change their code, for the sake of
@@ -43,11 +45,16 @@ enum MessageCode {
   // "How long have I played?"
   CL_REQUEST_TIME_PLAYED,
 
+  // "I'd like movement to be sent over UDP as well."
+  CL_REQUEST_DATAGRAM_CHANNEL,
+
   // "I want to skip the rest of the tutorial"
   CL_SKIP_TUTORIAL,
 
   // "My location has changed, and is now ..."
-  // Arguments: x, y
+  // Arguments: x, y, [the sequence of the latest datagram sent]
+  // The last is sent over TCP only, by clients with a datagram channel.  Any
+  // datagrams up to it that arrive later are then ignored.
   CL_MOVE_TO,
 
   // Cancel user's current action
@@ -292,9 +299,19 @@ enum MessageCode {
   // The client has received all on-login info, and can hide the loading screen.
   SV_LOGIN_INFO_HAS_FINISHED,
 
+  // Your inventory, gear, recipes, constructions, spells, talents, quests and
+  // map exploration, all at once.  See LoginSnapshot.
+  // Arguments: version, ...
+  SV_LOGIN_SNAPSHOT,
+
   // You have played for ... seconds
   SV_TIME_PLAYED,
 
+  // Movement may be exchanged in datagrams with UDP port ..., on this server.
+  // Yours should carry this token.
+  // Arguments: token, port
+  SV_DATAGRAM_CHANNEL,
+
   // A user has connected.  Broadcast to all players.
   // Arguments: username
   SV_USER_CONNECTED,
@@ -361,8 +378,10 @@ enum MessageCode {
   SV_YOUR_SPAWN_POINT,
   SV_YOU_CHANGED_YOUR_SPAWN_POINT,
 
-  // An item is in the user's inventory, or a container object
-  // Arguments: serial, slot, ID, quantity, item health, isSoulbound, suffixID
+  // Items are in the user's inventory, or a container object.  The last five
+  // arguments are repeated for each slot that has changed.
+  // Arguments: serial, slot, ID, quantity, item health, isSoulbound, suffixID,
+  //            slot, ID, ...
   SV_INVENTORY,
 
   // A client received something.  Signal for aesthetics (e.g., floating combat
@@ -645,6 +664,12 @@ enum MessageCode {
   // Arguments: username, max energy
   SV_MAX_ENERGY,
 
+  // Those of a user's health, energy, max health and max energy that have
+  // changed, at most once per tick.
+  // Arguments: username, then one or more pairs of: SV_PLAYER_HEALTH,
+  // SV_PLAYER_ENERGY, SV_MAX_HEALTH or SV_MAX_ENERGY, and the new value
+  SV_PLAYER_VITALS,
+
   // "You are at war with ..."
   // Arguments: name
   SV_AT_WAR_WITH_PLAYER,
@@ -914,6 +939,8 @@ enum MessageCode {
                            // user.
   WARNING_USER_ALREADY_IN_A_GROUP,  // You tried to invite an already-grouped
                                     // person to your group.
+  WARNING_TOO_MANY_MESSAGES,  // You sent messages faster than allowed, and
+                              // some were ignored.
 
   // Debug requests
 
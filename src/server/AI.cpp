@@ -187,8 +187,6 @@ void AI::transitionIfNecessary() {
 }
 
 void AI::onTransition(State previousState) {
-  auto previousLocation = _owner.location();
-
   switch (state) {
     case CHASE:
     case PET_FOLLOW_OWNER:
@@ -205,7 +203,7 @@ void AI::onTransition(State previousState) {
         break;
       else {
         pickRandomSpotNearSpawnPoint();
-        _owner.restoreHealthAndBroadcastTo(previousLocation);
+        _owner.restoreHealth();
       }
       break;
     }
@@ -79,26 +79,29 @@ Spell::ID Class::teachFreeSpellIfAny() {
   return freeSpell;
 }
 
-std::string Class::generateKnownSpellsString() const {
-  auto string = ""s;
-  auto spellsKnown = 0;
+std::vector<std::string> Class::knownSpellIDs() const {
+  auto ids = std::vector<std::string>{};
 
   for (auto pair : _talentRanks) {
     if (pair.second == 0) continue;
     auto talent = pair.first;
     if (talent->type() != Talent::SPELL) continue;
-    string.append(std::string{MSG_DELIM});
-    string.append(talent->spellID());
-    ++spellsKnown;
+    ids.push_back(talent->spellID());
   }
 
-  for (const auto &id : _otherKnownSpells) {
+  for (const auto &id : _otherKnownSpells) ids.push_back(id);
+
+  return ids;
+}
+
+std::string Class::generateKnownSpellsString() const {
+  const auto ids = knownSpellIDs();
+  auto string = toString(ids.size());
+  for (const auto &id : ids) {
     string.append(std::string{MSG_DELIM});
     string.append(id);
-    ++spellsKnown;
   }
-
-  return toString(spellsKnown) + string;
+  return string;
 }
 
 void Class::applyStatsTo(Stats &baseStats) const {
@@ -2,6 +2,7 @@
 
 #include <list>
 #include <unordered_map>
+#include <vector>
 
 #include "Spell.h"
 
@@ -105,6 +106,7 @@ class Class {
   const std::set<Spell::ID> &otherKnownSpells() const {
     return _otherKnownSpells;
   }
+  std::vector<std::string> knownSpellIDs() const;
   std::string generateKnownSpellsString() const;
   void applyStatsTo(Stats &baseStats) const;
   size_t pointsInTree(const std::string &treeName) const;
@@ -0,0 +1,23 @@
+#pragma once
+
+#include "../ReceiveBuffer.h"
+#include "../Socket.h"
+#include "RateLimiter.h"
+
+// The server's state for a single connected client, whether or not a user has
+// logged in on it.
+class ClientConnection {
+ public:
+  ClientConnection(const Socket &socket, const RateLimiter::Rates &rateLimits,
+                   ms_t now)
+      : _socket(socket), _rateLimiter(rateLimits, now) {}
+
+  const Socket &socket() const { return _socket; }
+  ReceiveBuffer &received() { return _received; }
+  RateLimiter &rateLimiter() { return _rateLimiter; }
+
+ private:
+  Socket _socket;
+  ReceiveBuffer _received;
+  RateLimiter _rateLimiter;
+};
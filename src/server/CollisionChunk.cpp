@@ -1,12 +1,44 @@
 #include "CollisionChunk.h"
 
+#include <algorithm>
+#include <cmath>
+
 #include "Entity.h"
 
 void CollisionChunk::addEntity(const Entity *obj) {
-  _entities[obj->serial()] = obj;
+  const auto serial = obj->serial();
+  for (auto i = size_t{0}; i != _serials.size(); ++i)
+    if (_serials[i] == serial) {
+      _entities[i] = obj;
+      return;
+    }
+  _serials.push_back(serial);
+  _entities.push_back(obj);
 }
 
 void CollisionChunk::removeEntity(Serial serial) {
-  auto it = _entities.find(serial);
-  if (it != _entities.end()) _entities.erase(it);
+  for (auto i = size_t{0}; i != _serials.size(); ++i) {
+    if (!(_serials[i] == serial)) continue;
+    _serials[i] = _serials.back();
+    _serials.pop_back();
+    _entities[i] = _entities.back();
+    _entities.pop_back();
+    return;
+  }
+}
+
+void CollisionGrid::resize(double width, double height) {
+  auto toChunks = [this](double pixels) {
+    return std::max<size_t>(1, static_cast<size_t>(std::ceil(
+                                   std::max(0.0, pixels) / _chunkSize)));
+  };
+
+  auto oldChunks = std::move(_chunks);
+  _columns = toChunks(width);
+  _rows = toChunks(height);
+  _chunks = std::vector<CollisionChunk>(_columns * _rows);
+
+  for (const auto &chunk : oldChunks)
+    for (const auto *entity : chunk.entities())
+      chunkAt(entity->location()).addEntity(entity);
 }
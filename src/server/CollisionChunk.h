@@ -1,23 +1,74 @@
 #ifndef COLLISION_CHUNK_H
 #define COLLISION_CHUNK_H
 
-#include <map>
+#include <vector>
 
+#include "../Point.h"
 #include "../Serial.h"
+#include "../types.h"
 
 class Entity;
 
 // A subdivision of the map, used
 class CollisionChunk {
-  std::map<Serial, const Entity *>
-      _entities;  // Sorted by serial, for fast removal
+  // Parallel, so that collision checks read only the entities
+  std::vector<Serial> _serials;
+  std::vector<const Entity *> _entities;
 
  public:
   void addEntity(const Entity *obj);
   void removeEntity(Serial serial);
-  const std::map<Serial, const Entity *> entities() const { return _entities; }
+  const std::vector<const Entity *> &entities() const { return _entities; }
 };
 
-typedef std::map<size_t, std::map<size_t, CollisionChunk> > CollisionGrid;
+// Chunks covering the whole map, in a single array.  Anything beyond the edges
+// is kept in the nearest chunk.
+class CollisionGrid {
+ public:
+  explicit CollisionGrid(px_t chunkSize) : _chunkSize(chunkSize) {}
+
+  // To fit a map of this many pixels.  Anything already added is kept.
+  void resize(double width, double height);
+
+  CollisionChunk &chunkAt(const MapPoint &p) {
+    return _chunks[chunkIndex(column(p.x), row(p.y))];
+  }
+
+  // Call visit(const Entity *) on everything in the chunks touching the
+  // rectangle, or next to them.  It stops as soon as visit() returns false,
+  // and returns false if it stopped.
+  template <typename Visitor>
+  bool forEachEntityNear(const MapRect &r, const Visitor &visit) const {
+    // Consider neighbours, in case an object covers two chunks
+    auto left = column(r.x), right = column(r.x + r.w), top = row(r.y),
+         bottom = row(r.y + r.h);
+    if (left > 0) --left;
+    if (top > 0) --top;
+    if (right + 1 < _columns) ++right;
+    if (bottom + 1 < _rows) ++bottom;
+
+    for (auto x = left; x <= right; ++x)
+      for (auto y = top; y <= bottom; ++y)
+        for (const auto *entity : _chunks[chunkIndex(x, y)].entities())
+          if (!visit(entity)) return false;
+    return true;
+  }
+
+ private:
+  px_t _chunkSize;
+  size_t _columns{1}, _rows{1};
+  std::vector<CollisionChunk> _chunks =
+      std::vector<CollisionChunk>(1);  // Column-major
+
+  size_t chunkIndex(size_t x, size_t y) const { return x * _rows + y; }
+  size_t column(double x) const { return clampedChunk(x, _columns); }
+  size_t row(double y) const { return clampedChunk(y, _rows); }
+  size_t clampedChunk(double coord, size_t numChunks) const {
+    if (!(coord > 0)) return 0;
+    const auto chunk = coord / _chunkSize;
+    if (chunk >= numChunks) return numChunks - 1;
+    return static_cast<size_t>(chunk);
+  }
+};
 
 #endif
@@ -1184,4 +1184,6 @@ void DataLoader::loadMap(XmlReader &xr) {
   }
 
   _server._map.loadFromXML(xr);
+  _server._collisionGrid.resize(_server._map.width() * Map::TILE_W,
+                                _server._map.height() * Map::TILE_H);
 }
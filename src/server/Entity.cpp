@@ -2,6 +2,7 @@
 
 #include <algorithm>
 
+#include "../MessageSchema.h"
 #include "../util.h"
 #include "Groups.h"
 #include "Server.h"
@@ -48,26 +49,29 @@ bool Entity::compareSerial::operator()(const Entity *a, const Entity *b) const {
   return a->_serial < b->_serial;
 }
 
-bool Entity::compareXThenSerial::operator()(const Entity *a,
-                                            const Entity *b) const {
-  if (a->_location.x != b->_location.x) return a->_location.x < b->_location.x;
-  return a->_serial < b->_serial;
+void Entity::markForRemoval() {
+  Server::_instance->_entitiesToRemove.push_back(this);
 }
 
-bool Entity::compareYThenSerial::operator()(const Entity *a,
-                                            const Entity *b) const {
-  if (a->_location.y != b->_location.y) return a->_location.y < b->_location.y;
-  return a->_serial < b->_serial;
+void Entity::sendInfoToClient(const User &targetUser, bool isNew) const {
+  Server::instance().forgetVitalsSentTo(targetUser, *this);
+  for (const auto &message : introduction()) targetUser.sendMessage(message);
 }
 
-void Entity::markForRemoval() {
-  Server::_instance->_entitiesToRemove.push_back(this);
+const std::vector<SharedMessage> &Entity::introduction() const {
+  if (!_introductionIsCurrent) {
+    _introduction.clear();
+    buildIntroduction(_introduction);
+    _introductionIsCurrent = true;
+  }
+  return _introduction;
 }
 
-void Entity::sendInfoToClient(const User &targetUser, bool isNew) const {
+void Entity::buildIntroduction(std::vector<SharedMessage> &messages) const {
   // Custom name
   if (hasCustomName())
-    targetUser.sendMessage({SV_OBJECT_NAME, makeArgs(serial(), customName())});
+    messages.push_back(SharedMessage::From(
+        {SV_OBJECT_NAME, makeArgs(serial(), customName())}));
 }
 
 void Entity::changeType(const EntityType *newType,
@@ -83,6 +87,7 @@ void Entity::changeType(const EntityType *newType,
     _type = dynamic_cast<const NPCType *>(newType);
   else
     _type = newType;
+  invalidateIntroduction();
   server.forceAllToUntarget(*this);
 
   gatherable.removeAllGatheringUsers();
@@ -90,8 +95,8 @@ void Entity::changeType(const EntityType *newType,
   onSetType(shouldSkipConstruction);
 
   // Inform nearby users
-  for (const User *user : server.findUsersInArea(location()))
-    sendInfoToClient(*user);
+  server.forEachUserInArea(
+      location(), [this](const User *user) { sendInfoToClient(*user); });
   // Inform owner
   for (const auto &owner : permissions.ownerAsUsernames())
     server.sendMessageIfOnline(
@@ -283,28 +288,34 @@ void Entity::update(ms_t timeElapsed) {
 
   switch (outcome) {
     // These cases return
-    case MISS:
+    case MISS: {
+      const auto message = SharedMessage::From({SV_SHOW_MISS_AT, targetLoc});
       for (auto user : usersToInform) {
-        user->sendMessage({SV_SHOW_MISS_AT, targetLoc});
+        user->sendMessage(message);
         if (attackRange() > MELEE_RANGE) sendRangedMissMessageTo(*user);
       }
       return;
-    case DODGE:
+    }
+    case DODGE: {
+      const auto message = SharedMessage::From({SV_SHOW_DODGE_AT, targetLoc});
       for (auto user : usersToInform) {
-        user->sendMessage({SV_SHOW_DODGE_AT, targetLoc});
+        user->sendMessage(message);
         if (attackRange() > MELEE_RANGE) sendRangedMissMessageTo(*user);
       }
       return;
+    }
 
     // These cases continue on
-    case CRIT:
-      for (auto user : usersToInform)
-        user->sendMessage({SV_SHOW_CRIT_AT, targetLoc});
+    case CRIT: {
+      const auto message = SharedMessage::From({SV_SHOW_CRIT_AT, targetLoc});
+      for (auto user : usersToInform) user->sendMessage(message);
       break;
-    case BLOCK:
-      for (auto user : usersToInform)
-        user->sendMessage({SV_SHOW_BLOCK_AT, targetLoc});
+    }
+    case BLOCK: {
+      const auto message = SharedMessage::From({SV_SHOW_BLOCK_AT, targetLoc});
+      for (auto user : usersToInform) user->sendMessage(message);
       break;
+    }
   }
 
   // Send ranged message if hit.  This tells the client to create a projectile.
@@ -344,26 +355,24 @@ void Entity::update(ms_t timeElapsed) {
 
   // Alert nearby clients.  This must be done after the damage, so that the
   // client knows whether to play a hit sound or a death sound.
-  MessageCode msgCode;
-  std::string args;
+  auto hit = Message{};
   const auto attackerIsAPlayer = classTag() == 'u';
   const auto defenderIsAPlayer = pTarget->classTag() == 'u';
-  if (attackerIsAPlayer && defenderIsAPlayer) {
-    msgCode = SV_PLAYER_HIT_PLAYER;
-    args = makeArgs(dynamic_cast<const User *>(this)->name(),
-                    dynamic_cast<const User *>(pTarget)->name());
-  } else if (attackerIsAPlayer) {
-    msgCode = SV_PLAYER_HIT_ENTITY;
-    args =
-        makeArgs(dynamic_cast<const User *>(this)->name(), pTarget->serial());
-  } else if (defenderIsAPlayer) {
-    msgCode = SV_ENTITY_HIT_PLAYER;
-    args = makeArgs(serial(), dynamic_cast<const User *>(pTarget)->name());
-  } else {
-    msgCode = SV_ENTITY_HIT_ENTITY;
-    args = makeArgs(serial(), pTarget->serial());
-  }
-  for (auto user : usersToInform) user->sendMessage({msgCode, args});
+  if (attackerIsAPlayer && defenderIsAPlayer)
+    hit = MessageSchema<SV_PLAYER_HIT_PLAYER>::build(
+        dynamic_cast<const User *>(this)->name(),
+        dynamic_cast<const User *>(pTarget)->name());
+  else if (attackerIsAPlayer)
+    hit = MessageSchema<SV_PLAYER_HIT_ENTITY>::build(
+        dynamic_cast<const User *>(this)->name(), pTarget->serial());
+  else if (defenderIsAPlayer)
+    hit = MessageSchema<SV_ENTITY_HIT_PLAYER>::build(
+        serial(), dynamic_cast<const User *>(pTarget)->name());
+  else
+    hit = MessageSchema<SV_ENTITY_HIT_ENTITY>::build(serial(),
+                                                     pTarget->serial());
+  const auto message = SharedMessage::From(hit);
+  for (auto user : usersToInform) user->sendMessage(message);
 }
 
 void Entity::updateBuffs(ms_t timeElapsed) {
@@ -459,28 +468,34 @@ CombatResult Entity::castSpell(const Spell &spell,
     const auto &src = location(), &dst = target->location();
     auto args = makeArgs(spell.id(), src.x, src.y, dst.x, dst.y);
 
+    const auto spellMessage = SharedMessage::From({msgCode, args});
+
+    // Show notable outcomes
+    auto outcomeCode = NO_CODE;
+    switch (outcome) {
+      case MISS:
+        outcomeCode = SV_SHOW_MISS_AT;
+        break;
+      case DODGE:
+        outcomeCode = SV_SHOW_DODGE_AT;
+        break;
+      case BLOCK:
+        outcomeCode = SV_SHOW_BLOCK_AT;
+        break;
+      case CRIT:
+        outcomeCode = SV_SHOW_CRIT_AT;
+        break;
+    }
+    const auto outcomeMessage =
+        SharedMessage::From({outcomeCode, makeArgs(dst.x, dst.y)});
+
     auto usersToAlert = server.findUsersInArea(dst);
     usersToAlert.insert(usersNearCaster.begin(), usersNearCaster.end());
     for (auto user : usersToAlert) {
-      user->sendMessage({msgCode, args});
+      user->sendMessage(spellMessage);
       if (spellHit && spell.shouldPlayDefenseSound())
         target->sendGotHitMessageTo(*user);
-
-      // Show notable outcomes
-      switch (outcome) {
-        case MISS:
-          user->sendMessage({SV_SHOW_MISS_AT, makeArgs(dst.x, dst.y)});
-          break;
-        case DODGE:
-          user->sendMessage({SV_SHOW_DODGE_AT, makeArgs(dst.x, dst.y)});
-          break;
-        case BLOCK:
-          user->sendMessage({SV_SHOW_BLOCK_AT, makeArgs(dst.x, dst.y)});
-          break;
-        case CRIT:
-          user->sendMessage({SV_SHOW_CRIT_AT, makeArgs(dst.x, dst.y)});
-          break;
-      }
+      if (outcomeCode != NO_CODE) user->sendMessage(outcomeMessage);
     }
   }
 
@@ -549,57 +564,22 @@ void Entity::removeOnTimer(ms_t &timer, ms_t timeElapsed) {
 void Entity::location(const MapPoint &newLoc, bool firstInsertion) {
   Server &server = *Server::_instance;
 
-  const User *selfAsUser = nullptr;
-  if (classTag() == 'u') selfAsUser = dynamic_cast<const User *>(this);
+  User *selfAsUser = nullptr;
+  if (classTag() == 'u') selfAsUser = dynamic_cast<User *>(this);
 
   MapPoint oldLoc = _location;
 
-  auto xChanged = newLoc.x != oldLoc.x;
-  auto yChanged = newLoc.y != oldLoc.y;
-
-  if (!firstInsertion) {
-    // Remove from location-indexed trees
-    if (server._entitiesByX.size() != server._entitiesByY.size())
-      SERVER_ERROR(
-          "x-indexed and y-indexed entities lists have different sizes");
-
-    if (classTag() == 'u') {
-      if (xChanged) {
-        auto numRemoved = server._usersByX.erase(selfAsUser);
-        if (numRemoved != 1)
-          SERVER_ERROR("Unexpected number of entities removed");
-      }
-      if (yChanged) {
-        auto numRemoved = server._usersByY.erase(selfAsUser);
-        if (numRemoved != 1)
-          SERVER_ERROR("Unexpected number of entities removed");
-      }
-    }
-    if (xChanged) {
-      auto numRemoved = server._entitiesByX.erase(this);
-      if (numRemoved != 1)
-        SERVER_ERROR("Unexpected number of entities removed");
-    }
-    if (yChanged) {
-      auto numRemoved = server._entitiesByY.erase(this);
-      if (numRemoved != 1)
-        SERVER_ERROR("Unexpected number of entities removed");
-    }
-  }
-
   _location = newLoc;
+  invalidateIntroduction();
 
-  // Re-insert into location-indexed trees
-  if (classTag() == 'u') {
-    if (xChanged) server._usersByX.insert(selfAsUser);
-    if (yChanged) server._usersByY.insert(selfAsUser);
-    if (server._usersByX.size() != server._usersByY.size())
-      SERVER_ERROR("x-indexed users lists have different sizes");
+  // Update location indices; this is usually within the same cell.
+  if (firstInsertion) {
+    if (selfAsUser) server._usersByLocation.add(selfAsUser);
+    server._entitiesByLocation.add(this);
+  } else {
+    if (selfAsUser) server._usersByLocation.move(selfAsUser, oldLoc);
+    server._entitiesByLocation.move(this, oldLoc);
   }
-  if (xChanged) server._entitiesByX.insert(this);
-  if (yChanged) server._entitiesByY.insert(this);
-  if (server._entitiesByX.size() != server._entitiesByY.size())
-    SERVER_ERROR("x-indexed and y-indexed entities lists have different sizes");
 
   // Move to a different collision chunk if needed
   auto &oldCollisionChunk = server.getCollisionChunk(oldLoc),
@@ -640,10 +620,11 @@ bool Entity::teleportToValidLocationInCircle(const MapPoint &centre,
 }
 
 void Entity::teleportTo(const MapPoint &destination) {
-  const auto &server = Server::instance();
+  auto &server = Server::instance();
   auto startingLocation = location();
 
   location(destination);
+  server._interest.onMoved(*this);
 
   auto message = teleportMessage(destination);
   server.broadcastToArea(startingLocation, message);
@@ -653,8 +634,8 @@ void Entity::teleportTo(const MapPoint &destination) {
 }
 
 Message Entity::teleportMessage(const MapPoint &destination) const {
-  return {SV_ENTITY_LOCATION_INSTANT,
-          makeArgs(serial(), destination.x, destination.y)};
+  return Message::EntityLocation(SV_ENTITY_LOCATION_INSTANT, serial(),
+                                 destination);
 }
 
 bool Entity::collides() const {
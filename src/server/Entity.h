@@ -2,6 +2,7 @@
 #define ENTITY_H
 
 #include <memory>
+#include <vector>
 
 #include "../Message.h"
 #include "../Point.h"
@@ -41,14 +42,6 @@ class Entity {
   struct compareSerial {
     bool operator()(const Entity *a, const Entity *b) const;
   };
-  struct compareXThenSerial {
-    bool operator()(const Entity *a, const Entity *b) const;
-  };
-  struct compareYThenSerial {
-    bool operator()(const Entity *a, const Entity *b) const;
-  };
-  typedef std::set<const Entity *, Entity::compareXThenSerial> byX_t;
-  typedef std::set<const Entity *, Entity::compareYThenSerial> byY_t;
 
   Serial serial() const { return _serial; }
   void serial(Serial s) { _serial = s; }
@@ -59,6 +52,11 @@ class Entity {
 
   virtual void sendInfoToClient(const User &targetUser,
                                 bool isNew = false) const;
+  // Those of the messages above that are the same for every user, and rarely
+  // change.  They're built when first needed, and then shared by every user
+  // they're sent to until something they describe changes.
+  const std::vector<SharedMessage> &introduction() const;
+  void invalidateIntroduction() const { _introductionIsCurrent = false; }
 
   virtual void writeToXML(XmlWriter &xw) const {}
 
@@ -86,7 +84,10 @@ class Entity {
   void teleportTo(const MapPoint &destination);
   virtual Message teleportMessage(const MapPoint &destination) const;
   virtual void onTeleport() {}
-  void changeDummyLocation(const MapPoint &loc) { _location = loc; }
+  void changeDummyLocation(const MapPoint &loc) {
+    _location = loc;
+    invalidateIntroduction();
+  }
   const MapRect collisionRect() const {
     return type()->collisionRect() + _location;
   }
@@ -216,7 +217,10 @@ class Entity {
   virtual bool canHaveCustomName() const { return false; }
   void setCustomNameWithChecksAndAnnouncements(std::string name,
                                                const User &setter);
-  void setCustomName(std::string name) { _customName = name; }
+  void setCustomName(std::string name) {
+    _customName = name;
+    invalidateIntroduction();
+  }
   bool hasCustomName() const { return !_customName.empty(); }
   const std::string &customName() const { return _customName; }
 
@@ -236,6 +240,12 @@ class Entity {
       const MapPoint &requestedDest,
       ClientLocationUpdateCase whenToSendClientHisLocation =
           OnServerCorrection);
+  // As above, but through each waypoint in turn.  The time elapsed limits the
+  // whole path, and others are told of the final location only.
+  StraightLineMoveResult moveLegallyAlong(
+      const std::vector<MapPoint> &waypoints,
+      ClientLocationUpdateCase whenToSendClientHisLocation =
+          OnServerCorrection);
 
   virtual bool areOverlapsAllowedWith(const Entity &rhs) const;
 
@@ -246,6 +256,7 @@ class Entity {
 
  protected:
   // void type(const EntityType *type) { _type = type; }
+  virtual void buildIntroduction(std::vector<SharedMessage> &messages) const;
   std::shared_ptr<Loot> _loot;
   void resetLocationUpdateTimer() {
     _lastLocUpdate = SDL_GetTicks();
@@ -261,6 +272,9 @@ class Entity {
 
   std::string _customName;
 
+  mutable std::vector<SharedMessage> _introduction;
+  mutable bool _introductionIsCurrent{false};
+
   // Space
   Serial _serial;
   MapPoint _location;
@@ -284,6 +298,13 @@ class Entity {
  private:
   ms_t _timeSinceRegen = 0;
 
+  // The furthest point up to maxDistance along the line, sliding along any
+  // obstacle in the way.  Returns false if it was blocked, and the start is
+  // itself invalid.
+  bool findLegalDestination(const MapPoint &from, const MapPoint &towards,
+                            double maxDistance, MapPoint &destination) const;
+  StraightLineMoveResult teleportToValidLocationNearby();
+
   friend class Dummy;
 };
 
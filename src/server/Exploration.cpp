@@ -1,5 +1,6 @@
 #include "Exploration.h"
 
+#include "../LoginSnapshot.h"
 #include "../XmlReader.h"
 #include "../XmlWriter.h"
 #include "Server.h"
@@ -45,27 +46,8 @@ void Exploration::readFrom(XmlReader &xr) {
   }
 }
 
-void Exploration::sendWholeMap(const Socket &socket) const {
-  // One message per column
-  static const auto NUMBERS_PER_MESSAGE = 10;
-  static const auto CHUNKS_PER_NUMBER = 30;
-
-  for (auto col = 0; col != _map.size(); ++col) {
-    auto args = makeArgs(col);
-    for (auto numberIndex = 0; numberIndex != NUMBERS_PER_MESSAGE;
-         ++numberIndex) {
-      Uint32 number = 0;
-      for (auto i = 0; i != CHUNKS_PER_NUMBER; ++i) {
-        number = number << 1;
-        size_t y = numberIndex * CHUNKS_PER_NUMBER + i;
-        if (y >= _map[col].size()) continue;
-        if (_map[col][y]) ++number;
-      }
-
-      args = makeArgs(args, number);
-    }
-    Server::instance().sendMessage(socket, {SV_MAP_EXPLORATION_DATA, args});
-  }
+void Exploration::writeTo(LoginSnapshot &snapshot) const {
+  snapshot.exploration(_map);
 }
 
 void Exploration::sendSingleChunk(const Socket &socket,
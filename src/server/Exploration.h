@@ -4,6 +4,7 @@
 
 #include "../Point.h"
 
+struct LoginSnapshot;
 class Socket;
 class XmlReader;
 class XmlWriter;
@@ -23,7 +24,7 @@ class Exploration {
   int numChunksExplored() const { return _numChunksExplored; }
   int numChunks() const { return _map.size() * _map.front().size(); }
 
-  void sendWholeMap(const Socket &socket) const;
+  void writeTo(LoginSnapshot &snapshot) const;
   void sendSingleChunk(const Socket &socket, const Chunk &chunk) const;
 
   Chunk getChunk(const MapPoint &location);
@@ -6,9 +6,10 @@ void Gatherable::incrementGatheringUsers(const User *userToSkip) {
   const auto &server = Server::instance();
   ++_numUsersGathering;
   if (_numUsersGathering == 1) {
-    for (const User *user : server.findUsersInArea(parent().location()))
+    server.forEachUserInArea(parent().location(), [&](const User *user) {
       if (user != userToSkip)
         user->sendMessage({SV_OBJECT_BEING_GATHERED, parent().serial()});
+    });
   }
 }
 
@@ -16,17 +17,19 @@ void Gatherable::decrementGatheringUsers(const User *userToSkip) {
   const auto &server = Server::instance();
   --_numUsersGathering;
   if (_numUsersGathering == 0) {
-    for (const User *user : server.findUsersInArea(parent().location()))
+    server.forEachUserInArea(parent().location(), [&](const User *user) {
       if (user != userToSkip)
         user->sendMessage({SV_OBJECT_NOT_BEING_GATHERED, parent().serial()});
+    });
   }
 }
 
 void Gatherable::removeAllGatheringUsers() {
   const auto &server = Server::instance();
   _numUsersGathering = 0;
-  for (const User *user : server.findUsersInArea(parent().location()))
+  server.forEachUserInArea(parent().location(), [this](const User *user) {
     user->sendMessage({SV_OBJECT_NOT_BEING_GATHERED, parent().serial()});
+  });
 }
 
 void Gatherable::setContents(const ItemSet &contents) { _contents = contents; }
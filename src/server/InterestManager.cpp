@@ -0,0 +1,115 @@
+#include "InterestManager.h"
+
+#include "Server.h"
+
+const px_t InterestManager::CULL_HYSTERESIS_DISTANCE = 25;
+
+void InterestManager::onMoved(const Entity &entity) {
+  std::lock_guard<std::mutex> lock(_mutex);
+
+  if (entity.classTag() == 'u')
+    updateViewOf(dynamic_cast<const User &>(entity));
+  updateObserversOf(entity);
+}
+
+void InterestManager::markAsVisible(const User &observer,
+                                    const Entity &subject) {
+  if (&observer == &subject) return;
+
+  std::lock_guard<std::mutex> lock(_mutex);
+  _visibleTo[&observer].insert(&subject);
+  _observersOf[&subject].insert(&observer);
+}
+
+void InterestManager::forget(const Entity &entity) {
+  std::lock_guard<std::mutex> lock(_mutex);
+
+  auto observersIt = _observersOf.find(&entity);
+  if (observersIt != _observersOf.end()) {
+    for (const auto *observer : observersIt->second)
+      _visibleTo[observer].erase(&entity);
+    _observersOf.erase(observersIt);
+  }
+
+  if (entity.classTag() != 'u') return;
+  auto visibleIt = _visibleTo.find(dynamic_cast<const User *>(&entity));
+  if (visibleIt != _visibleTo.end()) {
+    for (const auto *subject : visibleIt->second)
+      _observersOf[subject].erase(visibleIt->first);
+    _visibleTo.erase(visibleIt);
+  }
+}
+
+bool InterestManager::isVisibleTo(const User &observer,
+                                  const Entity &subject) const {
+  std::lock_guard<std::mutex> lock(_mutex);
+  auto it = _visibleTo.find(&observer);
+  if (it == _visibleTo.end()) return false;
+  return it->second.count(&subject) == 1;
+}
+
+std::set<const User *> InterestManager::observersOf(
+    const Entity &subject) const {
+  std::lock_guard<std::mutex> lock(_mutex);
+  auto it = _observersOf.find(&subject);
+  if (it == _observersOf.end()) return {};
+  return it->second;
+}
+
+bool InterestManager::canBeSeen(const Entity &entity) {
+  if (!entity.shouldBePropagatedToClients()) return false;
+  const auto *asObject = dynamic_cast<const Object *>(&entity);
+  return !asObject || !asObject->objType().isHidden();
+}
+
+bool InterestManager::isOutOfRange(const Entity &a, const Entity &b) {
+  const auto range = Server::CULL_DISTANCE + CULL_HYSTERESIS_DISTANCE;
+  return abs(a.location().x - b.location().x) > range ||
+         abs(a.location().y - b.location().y) > range;
+}
+
+void InterestManager::addToView(const User &observer, const Entity &subject) {
+  const auto isNew = _visibleTo[&observer].insert(&subject).second;
+  if (!isNew) return;
+  _observersOf[&subject].insert(&observer);
+  subject.sendInfoToClient(observer);
+}
+
+void InterestManager::removeFromView(const User &observer,
+                                     const Entity &subject) {
+  _visibleTo[&observer].erase(&subject);
+  _observersOf[&subject].erase(&observer);
+  observer.onOutOfRange(subject);
+}
+
+void InterestManager::updateViewOf(const User &observer) {
+  const auto &server = Server::instance();
+
+  server.forEachEntityInArea(observer.location(), [&](const Entity *entity) {
+    if (entity == &observer) return;
+    if (!canBeSeen(*entity)) return;
+    addToView(observer, *entity);
+  });
+
+  auto noLongerVisible = std::set<const Entity *>{};
+  for (const auto *subject : _visibleTo[&observer])
+    if (isOutOfRange(observer, *subject)) noLongerVisible.insert(subject);
+  for (const auto *subject : noLongerVisible)
+    removeFromView(observer, *subject);
+}
+
+void InterestManager::updateObserversOf(const Entity &subject) {
+  const auto &server = Server::instance();
+
+  if (canBeSeen(subject))
+    server.forEachUserInArea(subject.location(), [&](const User *user) {
+      if (user == &subject) return;
+      addToView(*user, subject);
+    });
+
+  auto noLongerObserving = std::set<const User *>{};
+  for (const auto *observer : _observersOf[&subject])
+    if (isOutOfRange(*observer, subject)) noLongerObserving.insert(observer);
+  for (const auto *observer : noLongerObserving)
+    removeFromView(*observer, subject);
+}
@@ -0,0 +1,49 @@
+#ifndef INTEREST_MANAGER_H
+#define INTEREST_MANAGER_H
+
+#include <map>
+#include <mutex>
+#include <set>
+
+#include "../types.h"
+
+class Entity;
+class User;
+
+// Which entities each user has been told about because they are nearby.  An
+// entity enters a user's view within Server::CULL_DISTANCE, and leaves it
+// only beyond that plus CULL_HYSTERESIS_DISTANCE, so that one on the boundary
+// doesn't flicker.  Views are kept in both directions, so that a move is
+// checked against only the entities involved.
+class InterestManager {
+ public:
+  // Less than the client's hysteresis, so that the server always forgets an
+  // entity before the client culls it on its own.
+  static const px_t CULL_HYSTERESIS_DISTANCE;
+
+  // Tell users about anything that has come into or gone out of view because
+  // the entity moved: both what it can see, if it's a user, and who can see
+  // it.
+  void onMoved(const Entity &entity);
+  // The entity has been described to the user by other means.
+  void markAsVisible(const User &observer, const Entity &subject);
+  void forget(const Entity &entity);  // It's being removed from the world.
+
+  bool isVisibleTo(const User &observer, const Entity &subject) const;
+  std::set<const User *> observersOf(const Entity &subject) const;
+
+ private:
+  mutable std::mutex _mutex;
+  std::map<const User *, std::set<const Entity *>> _visibleTo;
+  std::map<const Entity *, std::set<const User *>> _observersOf;
+
+  static bool canBeSeen(const Entity &entity);
+  static bool isOutOfRange(const Entity &a, const Entity &b);
+
+  void addToView(const User &observer, const Entity &subject);
+  void removeFromView(const User &observer, const Entity &subject);
+  void updateViewOf(const User &observer);
+  void updateObserversOf(const Entity &subject);
+};
+
+#endif
@@ -1,5 +1,6 @@
 #include "NPC.h"
 
+#include "../MessageSchema.h"
 #include "Server.h"
 
 NPC::NPC(const NPCType *type, const MapPoint &loc)
@@ -121,24 +122,15 @@ Message NPC::outOfRangeMessage() const {
   return Message(SV_OBJECT_OUT_OF_RANGE, makeArgs(serial()));
 }
 
-void NPC::restoreHealthAndBroadcastTo(const MapPoint &p) {
+void NPC::restoreHealth() {
   if (!isMissingHealth()) return;
 
   health(stats().maxHealth);
-  onHealthChange();  // Only broadcasts to the new location, not
-                     // the old.
-
-  broadcastHealthTo(p);
+  // Those who can no longer see it will be told when it's next introduced.
+  onHealthChange();
 }
 
-void NPC::onHealthChange() { broadcastHealthTo(location()); }
-
-void NPC::broadcastHealthTo(const MapPoint &p) {
-  const auto healthMsg =
-      Message{SV_ENTITY_HEALTH, makeArgs(serial(), health())};
-  for (const User *user : Server::_instance->findUsersInArea(p))
-    user->sendMessage(healthMsg);
-}
+void NPC::onHealthChange() { Server::_instance->onVitalsChanged(*this); }
 
 void NPC::onDeath() {
   Server &server = *Server::_instance;
@@ -229,19 +221,34 @@ double NPC::getTameChance() const {
   return getTameChanceBasedOnHealthPercent(1.0 * health() / stats().maxHealth);
 }
 
+void NPC::buildIntroduction(std::vector<SharedMessage> &messages) const {
+  messages.push_back(SharedMessage::From(
+      {SV_OBJECT_INFO,
+       makeArgs(serial(), location().x, location().y, type()->id())}));
+
+  // Owner
+  auto *nonConst = const_cast<NPC *>(this);
+  if (nonConst->permissions.hasOwner()) {
+    const auto &owner = nonConst->permissions.owner();
+    messages.push_back(SharedMessage::From(
+        {SV_OWNER, makeArgs(serial(), owner.typeString(), owner.name)}));
+  }
+
+  // Level
+  messages.push_back(
+      SharedMessage::From({SV_NPC_LEVEL, makeArgs(serial(), _level)}));
+
+  Entity::buildIntroduction(messages);
+}
+
 void NPC::sendInfoToClient(const User &targetUser, bool isNew) const {
   const Server &server = Server::instance();
 
-  targetUser.sendMessage(
-      {SV_OBJECT_INFO,
-       makeArgs(serial(), location().x, location().y, type()->id())});
+  Entity::sendInfoToClient(targetUser, isNew);
 
-  // Owner
   auto *nonConst = const_cast<NPC *>(this);
   if (nonConst->permissions.hasOwner()) {
     const auto &owner = nonConst->permissions.owner();
-    targetUser.sendMessage(
-        {SV_OWNER, makeArgs(serial(), owner.typeString(), owner.name)});
 
     // In case the owner is unknown to the client, tell him the owner's city
     if (owner.type == owner.PLAYER) {
@@ -251,12 +258,10 @@ void NPC::sendInfoToClient(const User &targetUser, bool isNew) const {
     }
   }
 
-  // Level
-  targetUser.sendMessage({SV_NPC_LEVEL, makeArgs(serial(), _level)});
-
   // Hitpoints
   if (isMissingHealth())
-    targetUser.sendMessage({SV_ENTITY_HEALTH, makeArgs(serial(), health())});
+    targetUser.sendMessage(
+        MessageSchema<SV_ENTITY_HEALTH>::build(serial(), health()));
 
   // Loot
   if (!_loot->empty() && tagger == targetUser) sendAllLootToTaggers();
@@ -278,8 +283,6 @@ void NPC::sendInfoToClient(const User &targetUser, bool isNew) const {
         {SV_TRANSFORM_TIME_REMAINING,
          makeArgs(serial(), transformation.transformTimer())});
   }
-
-  Entity::sendInfoToClient(targetUser, isNew);
 }
 
 ServerItem::Instance *NPC::getSlotToTakeFromAndSendErrors(size_t slotNum,
@@ -346,14 +349,14 @@ void NPC::updateStats() {
 
 void NPC::broadcastDamagedMessage(Hitpoints amount) const {
   Server &server = *Server::_instance;
-  server.broadcastToArea(location(),
-                         {SV_OBJECT_DAMAGED, makeArgs(serial(), amount)});
+  server.broadcastToArea(
+      location(), MessageSchema<SV_OBJECT_DAMAGED>::build(serial(), amount));
 }
 
 void NPC::broadcastHealedMessage(Hitpoints amount) const {
   Server &server = *Server::_instance;
-  server.broadcastToArea(location(),
-                         {SV_OBJECT_HEALED, makeArgs(serial(), amount)});
+  server.broadcastToArea(
+      location(), MessageSchema<SV_OBJECT_HEALED>::build(serial(), amount));
 }
 
 int NPC::getLevelDifference(const User &user) const {
@@ -54,8 +54,7 @@ class NPC : public Entity, public QuestNode {
 
   void updateStats() override;
   void onHealthChange() override;
-  void restoreHealthAndBroadcastTo(const MapPoint &p);
-  void broadcastHealthTo(const MapPoint &p);
+  void restoreHealth();
   void onDeath() override;
   void onAttackedBy(Entity &attacker, Threat threat,
                     CombatResult result) override;
@@ -75,6 +74,7 @@ class NPC : public Entity, public QuestNode {
 
   void sendInfoToClient(const User &targetUser,
                         bool isNew = false) const override;
+  void buildIntroduction(std::vector<SharedMessage> &messages) const override;
   ServerItem::Instance *getSlotToTakeFromAndSendErrors(
       size_t slotNum, const User &user) override;
 
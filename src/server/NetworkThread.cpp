@@ -0,0 +1,388 @@
+#include "NetworkThread.h"
+
+#include "../Message.h"
+#include "../MessageParser.h"
+#include "../threadNaming.h"
+#include "../util.h"
+#include "LogConsole.h"
+
+NetworkThread::NetworkThread(const Socket &listeningSocket,
+                             const DatagramSocket &datagramSocket,
+                             const OutboundQueue::Limits &sendQueueLimits,
+                             const RateLimiter::Rates &rateLimits,
+                             LogConsole &debug)
+    : _listeningSocket(listeningSocket),
+      _datagramSocket(datagramSocket),
+      _sendQueueLimits(sendQueueLimits),
+      _rateLimits(rateLimits),
+      _debug(debug) {
+  _poller.add(_listeningSocket.getRaw());
+  if (_datagramSocket.isOpen()) _poller.add(_datagramSocket.getRaw());
+}
+
+void NetworkThread::start() {
+  _shouldStop = false;
+  _thread = std::thread([this]() {
+    setThreadName("Network");
+    run();
+  });
+}
+
+void NetworkThread::stop() {
+  if (!_thread.joinable()) return;
+  _shouldStop = true;
+  _poller.interrupt();
+  _thread.join();
+}
+
+void NetworkThread::run() {
+  while (!_shouldStop) {
+    checkSockets();
+    handleRequests();
+  }
+
+  // Send what the game has already asked for, then let clients go.
+  handleRequests();
+  while (!_connections.empty()) closeConnection(_connections.begin());
+}
+
+void NetworkThread::checkSockets() {
+  static const ms_t TIMEOUT = 1000;  // Requests and stops interrupt the wait.
+  if (!_poller.wait(TIMEOUT)) {
+    _debug << Color::CHAT_ERROR << "Error polling sockets: "
+           << Socket::lastError() << Log::endl;
+    return;
+  }
+
+  for (auto raw : _poller.readySockets()) {
+    // Activity on server socket: new connection
+    if (raw == _listeningSocket.getRaw()) {
+      acceptNewConnection();
+      continue;
+    }
+
+    if (_datagramSocket.isOpen() && raw == _datagramSocket.getRaw()) {
+      readDatagrams();
+      continue;
+    }
+
+    // Activity on client socket: message received or client disconnected
+    auto it = _connections.find(raw);
+    if (it == _connections.end()) {
+      _poller.remove(raw);
+      continue;
+    }
+    auto &connection = it->second;
+    if (!readFromConnection(connection)) {
+      pushEvent(Event::DISCONNECTED, connection.socket());
+      closeConnection(it);
+      continue;
+    }
+
+    auto &buffer = connection.received();
+    if (!buffer.hasCompleteMessages()) continue;
+    auto shouldFlush = false;
+    auto admitted = admitCompleteMessages(connection, shouldFlush);
+    buffer.discardCompleteMessages();
+    if (!admitted.empty())
+      pushEvent(Event::MESSAGES_RECEIVED, connection.socket(),
+                std::move(admitted));
+
+    // A warning that couldn't be queued means the client is too far behind,
+    // and flushing will disconnect them.
+    if (shouldFlush || connection.socket().hasExceededSendLimit())
+      flushConnection(it);
+  }
+
+  // Sockets that can now take the rest of their queued output
+  for (auto raw : _poller.writableSockets()) {
+    auto it = _connections.find(raw);
+    if (it != _connections.end()) flushConnection(it);
+  }
+
+  notifyGameThread();
+}
+
+void NetworkThread::acceptNewConnection() {
+  auto clientAddr = sockaddr_in{};
+  auto addrLength = Socket::sockAddrSize;
+  SOCKET tempSocket =
+      accept(_listeningSocket.getRaw(), (sockaddr *)&clientAddr, &addrLength);
+
+  if (false && _connections.size() == MAX_CLIENTS) {
+    _debug("No room for additional clients; all slots full");
+    Socket s(tempSocket, {});
+    // Allow time for rejection message to be sent before closing socket
+    s.delayClosing(5000);
+    s.sendMessage(WARNING_SERVER_FULL);
+    return;
+  }
+
+  if (tempSocket == INVALID_SOCKET) {
+    _debug << Color::CHAT_ERROR
+           << "Error accepting connection: " << Socket::lastError()
+           << Log::endl;
+    return;
+  }
+
+  auto ip = std::string{inet_ntoa(clientAddr.sin_addr)};
+  _debug << Color::CHAT_SUCCESS << "Connection accepted: " << ip << ":"
+         << ntohs(clientAddr.sin_port) << ", socket number = " << tempSocket
+         << Log::endl;
+  const auto raw = tempSocket;
+  auto socket = Socket{tempSocket, ip};
+  socket.queueOutgoingMessages(_sendQueueLimits);
+  _connections.emplace(std::piecewise_construct, std::forward_as_tuple(raw),
+                       std::forward_as_tuple(socket, _rateLimits,
+                                             SDL_GetTicks()));
+  _poller.add(raw);
+  pushEvent(Event::CONNECTED, socket);
+}
+
+void NetworkThread::readDatagrams() {
+  auto event = Event{};
+  event.type = Event::DATAGRAM;
+  auto datagram = std::string{};
+  while (_datagramSocket.receive(datagram, event.sender)) {
+    event.messages = admitDatagram(datagram, event.sender);
+    if (event.messages.empty()) continue;
+    _events.push(event);
+    _gameThreadHasBeenNotified = false;
+  }
+}
+
+std::string NetworkThread::admitDatagram(const std::string &datagram,
+                                         const sockaddr_in &sender) {
+  const auto *cursor = datagram.data();
+  const auto *end = cursor + datagram.size();
+  auto header = DatagramHeader{};
+  if (!header.readFrom(cursor, end)) return {};
+
+  auto tokenIt = _connectionsByDatagramToken.find(header.token);
+  if (tokenIt == _connectionsByDatagramToken.end()) return {};
+  auto connectionIt = _connections.find(tokenIt->second);
+  if (connectionIt == _connections.end()) return {};
+  auto &connection = connectionIt->second;
+
+  // A token alone is only as secret as the network; it must also come from
+  // the client's own host.
+  if (connection.socket().ip() != inet_ntoa(sender.sin_addr)) return {};
+
+  // Only movement is accepted this way, and it counts against the same limit
+  // as movement sent over TCP.
+  auto admitted = std::string{datagram.data(), cursor};
+  const auto now = SDL_GetTicks();
+  auto parser = MessageParser{cursor, static_cast<size_t>(end - cursor)};
+  while (parser.hasAnotherMessage()) {
+    const auto messageStart = parser.lengthParsed();
+    if (parser.nextMessage() != CL_MOVE_TO) continue;
+    const auto messageEnd = parser.lengthUpToEndOfMessage();
+    if (connection.rateLimiter().check(CL_MOVE_TO, now) !=
+        RateLimiter::ALLOWED) {
+      ++_messagesDroppedByRateLimit[RateLimiter::MOVEMENT];
+      continue;
+    }
+    admitted.append(cursor + messageStart, messageEnd - messageStart);
+  }
+  return admitted;
+}
+
+bool NetworkThread::readFromConnection(ClientConnection &connection) {
+  const auto raw = connection.socket().getRaw();
+  auto &buffer = connection.received();
+
+  // Drain the socket, so that a burst is handled in a single tick.  A flood,
+  // though, would only keep the thread here and the buffer growing.
+  auto bytesRead = size_t{0};
+  do {
+    if (bytesRead >= MAX_BYTES_READ_AT_ONCE) {
+      _debug << Color::CHAT_ERROR << "Client " << raw << " sent over "
+             << MAX_BYTES_READ_AT_ONCE << " bytes at once; disconnecting"
+             << Log::endl;
+      return false;
+    }
+
+    auto *space = buffer.spaceToWrite();
+    const auto charsRead =
+        recv(raw, space, static_cast<int>(buffer.spaceAvailable()), 0);
+    if (charsRead == SOCKET_ERROR) {
+      // The socket is non-blocking; a spurious wake-up isn't an error.
+      if (wasSocketErrorWouldBlock(lastSocketError())) break;
+      _debug << "Client " << raw
+             << " disconnected; error code: " << Socket::lastError()
+             << Log::endl;
+      return false;
+    }
+    if (charsRead == 0) {
+      _debug << "Client " << raw << " disconnected" << Log::endl;
+      return false;
+    }
+    buffer.onBytesWritten(charsRead);
+    bytesRead += charsRead;
+  } while (bytesWaitingToBeRead(raw) > 0);
+
+  if (buffer.isOverflowing()) {
+    _debug << Color::CHAT_ERROR << "Client " << raw
+           << " sent an oversized message; disconnecting" << Log::endl;
+    return false;
+  }
+
+  return true;
+}
+
+std::string NetworkThread::admitCompleteMessages(ClientConnection &connection,
+                                                 bool &shouldFlush) {
+  const auto &buffer = connection.received();
+  const auto *messages = buffer.completeMessages();
+  const auto now = SDL_GetTicks();
+
+  // Copy only the runs of messages that are allowed through; usually, that's
+  // all of them.
+  auto admitted = std::string{};
+  auto runStart = size_t{0};
+  auto parser = MessageParser{messages, buffer.completeMessagesLength()};
+  while (parser.hasAnotherMessage()) {
+    const auto messageStart = parser.lengthParsed();
+    const auto code = parser.nextMessage();
+    const auto result = connection.rateLimiter().check(code, now);
+    if (result == RateLimiter::ALLOWED) continue;
+
+    admitted.append(messages + runStart, messageStart - runStart);
+    runStart = parser.lengthUpToEndOfMessage();
+
+    const auto category = RateLimiter::categoryOf(code);
+    ++_messagesDroppedByRateLimit[category];
+    if (result == RateLimiter::DROPPED_AND_WARN) {
+      _debug << Color::CHAT_ERROR << "Client " << connection.socket().getRaw()
+             << " exceeded the rate limit for "
+             << RateLimiter::name(category) << " messages" << Log::endl;
+      const auto &socket = connection.socket();
+      if (socket.sendMessage({WARNING_TOO_MANY_MESSAGES}, socket))
+        shouldFlush = true;
+    }
+  }
+  admitted.append(messages + runStart,
+                  buffer.completeMessagesLength() - runStart);
+  return admitted;
+}
+
+void NetworkThread::flushSoon(const Socket &socket) {
+  auto request = Request{};
+  request.type = Request::FLUSH;
+  request.socket = socket;
+  pushRequest(request);
+}
+
+void NetworkThread::disconnectSoon(const Socket &socket) {
+  auto request = Request{};
+  request.type = Request::DISCONNECT;
+  request.socket = socket;
+  pushRequest(request);
+}
+
+void NetworkThread::acceptDatagramsSoon(const Socket &socket,
+                                        uint64_t token) {
+  auto request = Request{};
+  request.type = Request::ACCEPT_DATAGRAMS;
+  request.socket = socket;
+  request.datagramToken = token;
+  pushRequest(request);
+}
+
+void NetworkThread::ignoreDatagramsSoon(uint64_t token) {
+  auto request = Request{};
+  request.type = Request::IGNORE_DATAGRAMS;
+  request.datagramToken = token;
+  pushRequest(request);
+}
+
+void NetworkThread::pushRequest(Request request) {
+  std::lock_guard<std::mutex> lock(_requestsMutex);
+  _requests.push(std::move(request));
+}
+
+void NetworkThread::handleRequests() {
+  auto request = Request{};
+  while (_requests.pop(request)) {
+    if (request.type == Request::IGNORE_DATAGRAMS) {
+      _connectionsByDatagramToken.erase(request.datagramToken);
+      continue;
+    }
+
+    auto it = _connections.find(request.socket.getRaw());
+    if (it == _connections.end()) continue;  // Already closed
+
+    if (request.type == Request::FLUSH)
+      flushConnection(it);
+    else if (request.type == Request::ACCEPT_DATAGRAMS)
+      _connectionsByDatagramToken[request.datagramToken] = it->first;
+    else
+      closeConnection(it);
+  }
+}
+
+void NetworkThread::flushConnection(Connections::iterator it) {
+  if (disconnectIfTooFarBehind(it)) return;
+
+  const auto &socket = it->second.socket();
+  const auto result = socket.flushQueuedOutput();
+
+  // Any errors will be discovered, and dealt with, when reading.
+  const auto isWaitingToWrite = result == OutboundQueue::WOULD_BLOCK;
+  _poller.watchForWritability(socket.getRaw(), isWaitingToWrite);
+}
+
+bool NetworkThread::disconnectIfTooFarBehind(Connections::iterator it) {
+  const auto &socket = it->second.socket();
+  if (!socket.hasExceededSendLimit()) return false;
+
+  const auto stats = socket.sendQueueStats();
+  _debug << Color::CHAT_ERROR << "Client " << it->first << " has fallen "
+         << stats.bytesQueued << " bytes behind; disconnecting.  "
+         << stats.messagesShed << " messages had already been dropped."
+         << Log::endl;
+  ++_clientsDisconnectedForFallingBehind;
+  pushEvent(Event::DISCONNECTED, socket);
+  closeConnection(it);
+  return true;
+}
+
+void NetworkThread::closeConnection(Connections::iterator it) {
+  // The raw socket is closed once the last Socket referring to it is gone.
+  _poller.remove(it->first);
+  for (auto tokenIt = _connectionsByDatagramToken.begin();
+       tokenIt != _connectionsByDatagramToken.end();) {
+    if (tokenIt->second == it->first)
+      tokenIt = _connectionsByDatagramToken.erase(tokenIt);
+    else
+      ++tokenIt;
+  }
+  _connections.erase(it);
+}
+
+void NetworkThread::pushEvent(Event::Type type, const Socket &socket,
+                              std::string messages) {
+  auto event = Event{};
+  event.type = type;
+  event.socket = socket;
+  event.messages = std::move(messages);
+  _events.push(std::move(event));
+  _gameThreadHasBeenNotified = false;
+}
+
+void NetworkThread::notifyGameThread() {
+  if (_gameThreadHasBeenNotified) return;
+  {
+    std::lock_guard<std::mutex> lock(_wakeUpMutex);
+    _thereAreNewEvents = true;
+  }
+  _eventsHaveArrived.notify_one();
+  _gameThreadHasBeenNotified = true;
+}
+
+void NetworkThread::waitForEvents(ms_t timeout) {
+  std::unique_lock<std::mutex> lock(_wakeUpMutex);
+  _eventsHaveArrived.wait_for(lock, std::chrono::milliseconds(timeout),
+                              [this]() { return _thereAreNewEvents; });
+  _thereAreNewEvents = false;
+}
@@ -0,0 +1,140 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <condition_variable>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include "../DatagramSocket.h"
+#include "../Socket.h"
+#include "../SocketPoller.h"
+#include "../SpscQueue.h"
+#include "ClientConnection.h"
+#include "RateLimiter.h"
+
+class LogConsole;
+
+// Owns every client connection, on a thread of its own.  Accepting, reading
+// and writing all happen there, so that neither a burst of connections nor a
+// slow client holds up the game.  What arrives is handed to the game thread,
+// and what the game wants sent is handed back, through lock-free queues.
+class NetworkThread {
+ public:
+  struct Event {
+    enum Type { CONNECTED, MESSAGES_RECEIVED, DISCONNECTED, DATAGRAM };
+    Type type{CONNECTED};
+    Socket socket{Socket::Empty()};  // Not for datagrams
+    std::string messages;  // Complete messages only, except for datagrams
+    sockaddr_in sender{};  // Datagrams only
+  };
+
+  // The datagram socket, if open, is read here but may be written to from
+  // anywhere.
+  NetworkThread(const Socket &listeningSocket,
+                const DatagramSocket &datagramSocket,
+                const OutboundQueue::Limits &sendQueueLimits,
+                const RateLimiter::Rates &rateLimits, LogConsole &debug);
+  ~NetworkThread() { stop(); }
+  NetworkThread(const NetworkThread &) = delete;
+  NetworkThread &operator=(const NetworkThread &) = delete;
+
+  void start();
+  // Sends anything already requested, then closes every connection.
+  void stop();
+
+  // The rest are for the game thread only, except that requests may be made
+  // from any thread.
+
+  // Sleep until there are events to handle, or until the timeout has elapsed.
+  void waitForEvents(ms_t timeout);
+  bool nextEvent(Event &event) { return _events.pop(event); }
+
+  // Requests take effect once wakeUp() is called.
+  void flushSoon(const Socket &socket);
+  void disconnectSoon(const Socket &socket);  // Without a DISCONNECTED event
+  // Datagrams bearing any other token are dropped on arrival.
+  void acceptDatagramsSoon(const Socket &socket, uint64_t token);
+  void ignoreDatagramsSoon(uint64_t token);
+  void wakeUp() { _poller.interrupt(); }
+
+  size_t clientsDisconnectedForFallingBehind() const {
+    return _clientsDisconnectedForFallingBehind;
+  }
+  size_t messagesDroppedByRateLimit(RateLimiter::Category category) const {
+    return _messagesDroppedByRateLimit[category];
+  }
+
+ private:
+  static const int MAX_CLIENTS = 100;
+  // From a single client, in response to a single readiness event.  No
+  // legitimate client sends anywhere near this much between polls.
+  static constexpr size_t MAX_BYTES_READ_AT_ONCE = 256 * 1024;
+
+  Socket _listeningSocket;
+  const DatagramSocket &_datagramSocket;
+  OutboundQueue::Limits _sendQueueLimits;
+  RateLimiter::Rates _rateLimits;
+  LogConsole &_debug;
+
+  SocketPoller _poller;  // The listening socket and all client sockets
+  using Connections = std::map<SOCKET, ClientConnection>;
+  Connections _connections;
+  std::map<uint64_t, SOCKET> _connectionsByDatagramToken;
+
+  struct Request {
+    enum Type { FLUSH, DISCONNECT, ACCEPT_DATAGRAMS, IGNORE_DATAGRAMS };
+    Type type{FLUSH};
+    // Holding a reference keeps the raw socket from being closed, and its
+    // number reused, while the request is in the queue.
+    Socket socket{Socket::Empty()};
+    uint64_t datagramToken{0};  // Datagram requests only
+  };
+  // From the game thread, mostly.  It has a single producer, so whoever
+  // pushes must hold _requestsMutex; this lets tests, and anything else
+  // holding a User, send messages that trigger requests.
+  SpscQueue<Request> _requests;
+  std::mutex _requestsMutex;
+  SpscQueue<Event> _events;  // To the game thread
+
+  std::thread _thread;
+  std::atomic<bool> _shouldStop{false};
+  std::atomic<size_t> _clientsDisconnectedForFallingBehind{0};
+  std::array<std::atomic<size_t>, RateLimiter::NUM_CATEGORIES>
+      _messagesDroppedByRateLimit{};
+
+  // Used only to let the game thread sleep; the events themselves are passed
+  // without locking.
+  std::mutex _wakeUpMutex;
+  std::condition_variable _eventsHaveArrived;
+  bool _thereAreNewEvents{false};
+  bool _gameThreadHasBeenNotified{true};  // Network thread only
+
+  void run();
+  void checkSockets();
+  void acceptNewConnection();
+  void readDatagrams();
+  // The header and any moves within the sender's rate limit, or nothing if
+  // the datagram isn't from a known client.
+  std::string admitDatagram(const std::string &datagram,
+                            const sockaddr_in &sender);
+  // Read everything waiting on the connection.  Returns false if the client
+  // has disconnected, sent something unusable, or sent too much at once.
+  bool readFromConnection(ClientConnection &connection);
+  // The complete messages received, less any over the client's rate limits.
+  // shouldFlush is set if a warning sent to the client calls for a flush.
+  std::string admitCompleteMessages(ClientConnection &connection,
+                                    bool &shouldFlush);
+  void pushRequest(Request request);
+  void handleRequests();
+  void flushConnection(Connections::iterator it);
+  // Returns true if the client was disconnected.
+  bool disconnectIfTooFarBehind(Connections::iterator it);
+  void closeConnection(Connections::iterator it);
+
+  void pushEvent(Event::Type type, const Socket &socket,
+                 std::string messages = {});
+  void notifyGameThread();
+};
@@ -35,6 +35,7 @@ void Permissions::setNoAccess() {
 
   _owner.type = Owner::NO_ACCESS;
   _owner.name = {};
+  parent().invalidateIntroduction();
 
   ownerIndex.add(_owner, parent().serial());
 
@@ -47,6 +48,7 @@ void Permissions::setOwner(const Owner &newOwner) {
   ownerIndex.remove(_owner, parent().serial());
 
   _owner = newOwner;
+  parent().invalidateIntroduction();
 
   ownerIndex.add(_owner, parent().serial());
 
@@ -54,7 +56,10 @@ void Permissions::setOwner(const Owner &newOwner) {
   parent().onOwnershipChange();
 }
 
-void Permissions::setAsMob() { _owner.type = Owner::MOB; }
+void Permissions::setAsMob() {
+  _owner.type = Owner::MOB;
+  parent().invalidateIntroduction();
+}
 
 void Permissions::setPlayerOwner(const std::string &username) {
   setOwner({Owner::PLAYER, username});
@@ -0,0 +1,94 @@
+#include "RateLimiter.h"
+
+#include <algorithm>
+
+RateLimiter::Category RateLimiter::categoryOf(MessageCode code) {
+  switch (code) {
+    case CL_MOVE_TO:
+      return MOVEMENT;
+
+    case CL_SAY:
+    case CL_WHISPER:
+    case CL_ROLL:
+      return CHAT;
+
+    case CL_REQUEST_TIME_PLAYED:
+    case CL_REQUEST_DATAGRAM_CHANNEL:
+    case CL_REPORT_BUG:
+      return REQUESTS;
+
+    case CL_LOGIN_EXISTING:
+    case CL_LOGIN_NEW:
+      return LOGINS;
+
+    default:
+      return ACTIONS;
+  }
+}
+
+const char *RateLimiter::name(Category category) {
+  switch (category) {
+    case MOVEMENT:
+      return "movement";
+    case CHAT:
+      return "chat";
+    case ACTIONS:
+      return "actions";
+    case REQUESTS:
+      return "requests";
+    case LOGINS:
+      return "logins";
+    default:
+      return "";
+  }
+}
+
+bool RateLimiter::warnsWhenLimited(Category category) {
+  return category != MOVEMENT;
+}
+
+RateLimiter::Rates RateLimiter::defaultRates() {
+  auto rates = Rates{};
+  rates[MOVEMENT] = 50;
+  rates[CHAT] = 5;
+  rates[ACTIONS] = 50;
+  rates[REQUESTS] = 2;
+  rates[LOGINS] = 1;
+  return rates;
+}
+
+RateLimiter::RateLimiter(const Rates &rates, ms_t now) : _rates(rates) {
+  for (auto i = 0; i != NUM_CATEGORIES; ++i) {
+    _buckets[i].tokens = burstSize(static_cast<Category>(i));
+    _buckets[i].lastRefill = now;
+  }
+}
+
+RateLimiter::Result RateLimiter::check(MessageCode code, ms_t now) {
+  // Pings are cheap, and are what keeps the client from timing out.
+  if (code == CL_PING) return ALLOWED;
+
+  const auto category = categoryOf(code);
+  auto &bucket = _buckets[category];
+
+  const auto elapsed = now - bucket.lastRefill;
+  bucket.lastRefill = now;
+  bucket.tokens = std::min(bucket.tokens + elapsed * _rates[category] / 1000.0,
+                           burstSize(category));
+
+  if (bucket.tokens >= 1.0) {
+    bucket.tokens -= 1.0;
+    bucket.hasWarned = false;
+    return ALLOWED;
+  }
+
+  // Warn once per run of dropped messages, so as not to answer a flood with
+  // one of our own.
+  if (!warnsWhenLimited(category) || bucket.hasWarned) return DROPPED;
+  bucket.hasWarned = true;
+  return DROPPED_AND_WARN;
+}
+
+double RateLimiter::burstSize(Category category) const {
+  return std::max(_rates[category] * BURST_DURATION / 1000.0, 1.0);
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <array>
+
+#include "../messageCodes.h"
+#include "../types.h"
+
+// Limits how quickly a single client may send each category of message, with
+// a token bucket per category.  Every message costs a token; tokens are
+// replenished steadily, and a client that has been quiet can save up a short
+// burst.
+class RateLimiter {
+ public:
+  enum Category { MOVEMENT, CHAT, ACTIONS, REQUESTS, LOGINS, NUM_CATEGORIES };
+  static Category categoryOf(MessageCode code);
+  static const char *name(Category category);  // As used in arguments
+  // Whether the client should be told when messages are dropped.  Movement is
+  // dropped silently, as later moves supersede earlier ones.
+  static bool warnsWhenLimited(Category category);
+
+  // Messages per second, for each category
+  using Rates = std::array<double, NUM_CATEGORIES>;
+  static Rates defaultRates();
+  // How many seconds' worth of messages may be saved up
+  static const ms_t BURST_DURATION = 2000;
+
+  // The rates must outlive the limiter.
+  RateLimiter(const Rates &rates, ms_t now);
+
+  enum Result { ALLOWED, DROPPED, DROPPED_AND_WARN };
+  Result check(MessageCode code, ms_t now);
+
+ private:
+  struct Bucket {
+    double tokens{0};
+    ms_t lastRefill{0};
+    bool hasWarned{false};  // Since the last message was allowed
+  };
+
+  const Rates &_rates;
+  std::array<Bucket, NUM_CATEGORIES> _buckets;
+
+  double burstSize(Category category) const;
+};
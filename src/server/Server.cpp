@@ -1,4 +1,6 @@
+#include <algorithm>
 #include <iostream>
+#include <random>
 #include <sstream>
 
 #ifndef SINGLE_THREAD
@@ -32,6 +34,7 @@ Server *Server::_instance = nullptr;
 LogConsole *Server::_debugInstance = nullptr;
 
 const ms_t Server::MAX_TIME_BETWEEN_LOCATION_UPDATES = 1000;
+const ms_t Server::MAX_TIME_BETWEEN_TICKS = 10;
 
 const px_t Server::ACTION_DISTANCE = Podes{4}.toPixels();
 const px_t Server::CULL_DISTANCE = 450;
@@ -60,6 +63,33 @@ Server::Server()
   if (cmdLineArgs.contains("user-files-path"))
     _userFilesPath = cmdLineArgs.getString("user-files-path") + "/";
   if (cmdLineArgs.contains("new")) deleteUserFiles();
+  if (cmdLineArgs.contains("send-high-water-mark"))
+    _sendQueueLimits.highWaterMark = cmdLineArgs.getInt("send-high-water-mark");
+  if (cmdLineArgs.contains("send-soft-limit"))
+    _sendQueueLimits.softLimit = cmdLineArgs.getInt("send-soft-limit");
+  if (cmdLineArgs.contains("send-hard-limit"))
+    _sendQueueLimits.hardLimit = cmdLineArgs.getInt("send-hard-limit");
+  if (cmdLineArgs.contains("snapshot-rate")) {
+    const auto snapshotsPerSecond = cmdLineArgs.getInt("snapshot-rate");
+    if (snapshotsPerSecond > 0)
+      _snapshotInterval = std::max<ms_t>(1, 1000 / snapshotsPerSecond);
+    else
+      _debug("The snapshot rate must be positive; ignoring it",
+             Color::CHAT_ERROR);
+  }
+  if (cmdLineArgs.contains("snapshot-budget"))
+    _snapshotBudget = cmdLineArgs.getInt("snapshot-budget");
+  if (cmdLineArgs.contains("send-bulk-budget"))
+    _sendQueueLimits.bulkBudget = cmdLineArgs.getInt("send-bulk-budget");
+  if (cmdLineArgs.contains("send-cosmetic-budget"))
+    _sendQueueLimits.cosmeticBudget =
+        cmdLineArgs.getInt("send-cosmetic-budget");
+  for (auto i = 0; i != RateLimiter::NUM_CATEGORIES; ++i) {
+    const auto arg = std::string{"rate-limit-"} +
+                     RateLimiter::name(static_cast<RateLimiter::Category>(i));
+    if (cmdLineArgs.contains(arg)) _rateLimits[i] = cmdLineArgs.getInt(arg);
+  }
+  if (cmdLineArgs.contains("no-compression")) _compressionIsAllowed = false;
 
   // Socket details
   sockaddr_in serverAddr;
@@ -80,6 +110,10 @@ Server::Server()
   /*_debug << "Server address: " << inet_ntoa(serverAddr.sin_addr) << ":"
          << ntohs(serverAddr.sin_port) << Log::endl;*/
   _socket.listen();
+
+  if (!_datagramSocket.open(port))
+    _debug("Couldn't open UDP port; movement will be sent over TCP only",
+           Color::CHAT_ERROR);
 }
 
 Server::~Server() {
@@ -95,86 +129,253 @@ Server::~Server() {
   Socket::debug = nullptr;
 }
 
-void Server::checkSockets() {
-  // Populate socket list with active sockets
-  static fd_set readFDs;
-  FD_ZERO(&readFDs);
-  FD_SET(_socket.getRaw(), &readFDs);
-  for (const Socket &socket : _clientSockets) {
-    FD_SET(socket.getRaw(), &readFDs);
+void Server::handleNetworkEvents() {
+  auto event = NetworkThread::Event{};
+  while (_network->nextEvent(event)) {
+    const auto raw = event.socket.getRaw();
+    switch (event.type) {
+      case NetworkThread::Event::CONNECTED:
+        _clientSessions[raw] = {event.socket, {}};
+        break;
+
+      case NetworkThread::Event::MESSAGES_RECEIVED:
+        handleBufferedMessages(event.socket, event.messages);
+        break;
+
+      case NetworkThread::Event::DISCONNECTED:
+        removeUser(event.socket);
+        _clientSessions.erase(raw);
+        break;
+
+      case NetworkThread::Event::DATAGRAM:
+        handleDatagram(event.messages, event.sender);
+        break;
+    }
   }
+}
 
-  // Poll for activity
-  static const timeval selectTimeout = {0, 10000};
-  int activity = select(0, &readFDs, nullptr, nullptr, &selectTimeout);
-  if (activity == SOCKET_ERROR) {
-    _debug << Color::CHAT_ERROR
-           << "Error polling sockets: " << WSAGetLastError() << Log::endl;
+void Server::onEntityMoved(const Entity &entity) {
+  std::lock_guard<std::mutex> lock(_movedEntitiesMutex);
+  if (entity.classTag() == 'u')
+    _usersThatMoved.insert(dynamic_cast<const User &>(entity).name());
+  else
+    _entitiesThatMoved.insert(entity.serial());
+}
+
+void Server::takeMovedEntities(std::set<Serial> &entities,
+                               std::set<std::string> &users) {
+  std::lock_guard<std::mutex> lock(_movedEntitiesMutex);
+  entities.swap(_entitiesThatMoved);
+  users.swap(_usersThatMoved);
+}
+
+void Server::broadcastMovement() {
+  if (_snapshotInterval > 0) {
+    sendMovementSnapshots();
+    flushDatagrams();
     return;
   }
-  _time = SDL_GetTicks();
-
-  // Activity on server socket: new connection
-  if (FD_ISSET(_socket.getRaw(), &readFDs)) {
-    if (false && _clientSockets.size() == MAX_CLIENTS) {
-      _debug("No room for additional clients; all slots full");
-      sockaddr_in clientAddr;
-      SOCKET tempSocket = accept(_socket.getRaw(), (sockaddr *)&clientAddr,
-                                 (int *)&Socket::sockAddrSize);
-      Socket s(tempSocket, {});
-      // Allow time for rejection message to be sent before closing socket
-      s.delayClosing(5000);
-      sendMessage(s, WARNING_SERVER_FULL);
-    } else {
-      sockaddr_in clientAddr;
-      SOCKET tempSocket = accept(_socket.getRaw(), (sockaddr *)&clientAddr,
-                                 (int *)&Socket::sockAddrSize);
-      if (tempSocket == SOCKET_ERROR) {
-        _debug << Color::CHAT_ERROR
-               << "Error accepting connection: " << WSAGetLastError()
-               << Log::endl;
-      } else {
-        auto ip = std::string{inet_ntoa(clientAddr.sin_addr)};
-        _debug << Color::CHAT_SUCCESS << "Connection accepted: " << ip << ":"
-               << ntohs(clientAddr.sin_port)
-               << ", socket number = " << tempSocket << Log::endl;
-        _clientSockets.insert({tempSocket, ip});
-      }
-    }
+
+  auto entitiesThatMoved = std::set<Serial>{};
+  auto usersThatMoved = std::set<std::string>{};
+  takeMovedEntities(entitiesThatMoved, usersThatMoved);
+
+  // Anything that has since been removed is skipped.
+  for (auto serial : entitiesThatMoved) {
+    const auto *entity = _entities.find(serial);
+    if (!entity) continue;
+    const auto message = Message::EntityLocation(SV_ENTITY_LOCATION, serial,
+                                                 entity->location());
+    for (const User *userP : _interest.observersOf(*entity))
+      sendMovement(*userP, message);
   }
 
-  // Activity on client socket: message received or client disconnected
-  for (std::set<Socket>::iterator it = _clientSockets.begin();
-       it != _clientSockets.end();) {
-    SOCKET raw = it->getRaw();
-    if (FD_ISSET(raw, &readFDs)) {
-      sockaddr_in clientAddr;
-      getpeername(raw, (sockaddr *)&clientAddr, (int *)&Socket::sockAddrSize);
-      static char buffer[BUFFER_SIZE + 1];
-      const int charsRead = recv(raw, buffer, BUFFER_SIZE, 0);
-      if (charsRead == SOCKET_ERROR) {
-        int err = WSAGetLastError();
-        _debug << "Client " << raw << " disconnected; error code: " << err
-               << Log::endl;
-        removeUser({raw, {}});
-        closesocket(raw);
-        _clientSockets.erase(it++);
-        continue;
-      } else if (charsRead == 0) {
-        // Client disconnected
-        _debug << "Client " << raw << " disconnected" << Log::endl;
-        removeUser(*it);
-        closesocket(raw);
-        _clientSockets.erase(it++);
-        continue;
-      } else {
-        // Message received
-        buffer[charsRead] = '\0';
-        _messages.push(std::make_pair(*it, std::string(buffer)));
-      }
+  for (const auto &username : usersThatMoved) {
+    auto it = _onlineUsersByName.find(username);
+    if (it == _onlineUsersByName.end()) continue;
+    const auto &mover = *it->second;
+    const auto message =
+        Message::UserLocation(SV_USER_LOCATION, username, mover.location());
+    for (const User *userP : _interest.observersOf(mover))
+      sendMovement(*userP, message);
+  }
+
+  flushDatagrams();
+}
+
+void Server::sendMovementSnapshots() {
+  if (_time - _timeOfLastSnapshot < _snapshotInterval) return;
+  _timeOfLastSnapshot = _time;
+
+  auto entitiesThatMoved = std::set<Serial>{};
+  auto usersThatMoved = std::set<std::string>{};
+  takeMovedEntities(entitiesThatMoved, usersThatMoved);
+
+  for (auto serial : entitiesThatMoved) {
+    const auto *entity = _entities.find(serial);
+    if (!entity) continue;
+    for (const User *userP : _interest.observersOf(*entity))
+      _pendingLocations[userP->name()].entities.insert(serial);
+  }
+  for (const auto &username : usersThatMoved) {
+    auto it = _onlineUsersByName.find(username);
+    if (it == _onlineUsersByName.end()) continue;
+    for (const User *userP : _interest.observersOf(*it->second))
+      _pendingLocations[userP->name()].users.insert(username);
+  }
+
+  for (auto it = _pendingLocations.begin(); it != _pendingLocations.end();) {
+    auto observerIt = _onlineUsersByName.find(it->first);
+    if (observerIt != _onlineUsersByName.end())
+      sendSnapshotTo(*observerIt->second, it->second);
+    if (observerIt == _onlineUsersByName.end() || it->second.empty())
+      it = _pendingLocations.erase(it);
+    else
+      ++it;
+  }
+}
+
+void Server::sendSnapshotTo(const User &observer,
+                            PendingLocations &pending) {
+  struct Mover {
+    double distance;
+    const Entity *entity;
+    const std::string *username;  // Null for non-users
+  };
+  auto movers = std::vector<Mover>{};
+  movers.reserve(pending.entities.size() + pending.users.size());
+
+  // Anything removed, or no longer in view, is forgotten.
+  for (auto it = pending.entities.begin(); it != pending.entities.end();) {
+    const auto *entity = _entities.find(*it);
+    if (!entity || !_interest.isVisibleTo(observer, *entity)) {
+      it = pending.entities.erase(it);
+      continue;
+    }
+    movers.push_back({distance(observer, *entity), entity, nullptr});
+    ++it;
+  }
+  for (auto it = pending.users.begin(); it != pending.users.end();) {
+    auto userIt = _onlineUsersByName.find(*it);
+    if (userIt == _onlineUsersByName.end() ||
+        !_interest.isVisibleTo(observer, *userIt->second)) {
+      it = pending.users.erase(it);
+      continue;
     }
+    const auto &mover = *userIt->second;
+    movers.push_back({distance(observer, mover), &mover, &mover.name()});
     ++it;
   }
+
+  std::sort(movers.begin(), movers.end(),
+            [](const Mover &lhs, const Mover &rhs) {
+              return lhs.distance < rhs.distance;
+            });
+
+  auto bytesSent = size_t{0};
+  for (const auto &mover : movers) {
+    if (bytesSent >= _snapshotBudget) break;
+
+    const auto message =
+        mover.username
+            ? Message::UserLocation(SV_USER_LOCATION, *mover.username,
+                                    mover.entity->location())
+            : Message::EntityLocation(SV_ENTITY_LOCATION,
+                                      mover.entity->serial(),
+                                      mover.entity->location());
+    bytesSent += sendMovement(observer, message);
+
+    if (mover.username)
+      pending.users.erase(*mover.username);
+    else
+      pending.entities.erase(mover.entity->serial());
+  }
+}
+
+void Server::openDatagramChannel(const User &user) {
+  if (!_datagramSocket.isOpen()) return;
+
+  static auto generator = std::mt19937_64{std::random_device{}()};
+  auto &peer = _datagramPeers[user.name()];
+  if (peer.token == 0) {
+    do peer.token = generator();
+    while (peer.token == 0 || _usersByDatagramToken.count(peer.token) == 1);
+    _usersByDatagramToken[peer.token] = user.name();
+    if (_network) {
+      _network->acceptDatagramsSoon(user.socket(), peer.token);
+      _network->wakeUp();
+    }
+  }
+
+  auto port = sockaddr_in{};
+  auto length = static_cast<SockAddrLength>(sizeof(port));
+  getsockname(_datagramSocket.getRaw(), (sockaddr *)&port, &length);
+  user.sendMessage({SV_DATAGRAM_CHANNEL, makeArgs(peer.token,
+                                                  ntohs(port.sin_port))});
+}
+
+void Server::closeDatagramChannel(const std::string &username) {
+  auto it = _datagramPeers.find(username);
+  if (it == _datagramPeers.end()) return;
+  if (_network) _network->ignoreDatagramsSoon(it->second.token);
+  _usersByDatagramToken.erase(it->second.token);
+  _datagramPeers.erase(it);
+}
+
+size_t Server::sendMovement(const User &recipient, const Message &message) {
+  auto it = _datagramPeers.find(recipient.name());
+  if (it == _datagramPeers.end() || !it->second.hasAddress) {
+    if (!recipient.hasSocket()) return 0;
+    auto bytesSent = size_t{0};
+    if (_socket.sendMessage(message, recipient.socket(), &bytesSent))
+      flushSoon(recipient.socket());
+    return bytesSent;
+  }
+
+  // Always absolute and in text, as earlier datagrams may have been lost.
+  auto &peer = it->second;
+  const auto compiled = message.compile();
+  static const size_t MAX_HEADER_SIZE = 32;
+  if (peer.unsent.size() + compiled.size() + MAX_HEADER_SIZE >
+      DatagramSocket::MAX_DATAGRAM_SIZE)
+    sendDatagram(peer);
+  peer.unsent.append(compiled);
+  return compiled.size();
+}
+
+void Server::sendDatagram(DatagramPeer &peer) {
+  if (peer.unsent.empty()) return;
+
+  auto header = DatagramHeader{};
+  header.sequence = ++peer.lastSequenceSent;
+  auto datagram = std::string{};
+  datagram.reserve(DatagramSocket::MAX_DATAGRAM_SIZE);
+  header.appendTo(datagram);
+  datagram.append(peer.unsent);
+  _datagramSocket.sendTo(peer.address, datagram);
+  peer.unsent.clear();
+}
+
+void Server::flushDatagrams() {
+  for (auto &pair : _datagramPeers) sendDatagram(pair.second);
+}
+
+void Server::flushOutgoingMessages() {
+  auto anyToFlush = false;
+  for (const auto &pair : _clientSessions) {
+    const auto &socket = pair.second.socket;
+    if (!socket.hasQueuedOutput()) continue;
+    _network->flushSoon(socket);
+    anyToFlush = true;
+  }
+  if (anyToFlush) _network->wakeUp();
+}
+
+void Server::applyProtocolRequest(const Socket &client,
+                                  const ProtocolRequest &request) const {
+  client.useWireProtocol(request.protocol);
+  if (request.compression && _compressionIsAllowed)
+    client.compressQueuedOutput();
 }
 
 void Server::run() {
@@ -194,6 +395,10 @@ void Server::run() {
   _onlineAndOfflineUsers.includeUsersFromDataFiles();
 #endif
 
+  _network = std::make_unique<NetworkThread>(
+      _socket, _datagramSocket, _sendQueueLimits, _rateLimits, _debug);
+  _network->start();
+
   _loop = true;
   _running = true;
   _debug("Server is ready", Color::CHAT_SUCCESS);
@@ -204,28 +409,22 @@ void Server::run() {
 
 #ifndef _DEBUG
     // Check that clients are alive
-    for (std::set<User>::iterator it = _onlineUsers.begin();
-         it != _onlineUsers.end();) {
-      if (it->hasExceededTimeout()) {
-        _debug << Color::CHAT_ERROR << "User " << it->name()
-               << " has timed out." << Log::endl;
-        std::set<User>::iterator next = it;
-        ++next;
-
-        auto socketIt = _clientSockets.find(it->socket());
-        if (socketIt == _clientSockets.end()) {
-          SERVER_ERROR(
-              "Trying to clean up user when socket number doesn't exist");
-          ++it;
-          continue;
-        }
-        _clientSockets.erase(socketIt);
-
-        removeUser(it);
-        it = next;
-      } else {
-        ++it;
+    for (auto it = _onlineUsers.begin(); it != _onlineUsers.end(); ++it) {
+      if (!it->hasExceededTimeout()) continue;
+      _debug << Color::CHAT_ERROR << "User " << it->name() << " has timed out."
+             << Log::endl;
+
+      auto sessionIt = _clientSessions.find(it->socket().getRaw());
+      if (sessionIt == _clientSessions.end()) {
+        SERVER_ERROR(
+            "Trying to clean up user when socket number doesn't exist");
+        continue;
       }
+      _network->disconnectSoon(sessionIt->second.socket);
+      _network->wakeUp();
+      _clientSessions.erase(sessionIt);
+
+      removeUser(it.handle());  // Leaves the iterator usable
     }
 #endif
 
@@ -255,8 +454,7 @@ void Server::run() {
       }
 
     // Update users
-    for (const User &user : _onlineUsers)
-      const_cast<User &>(user).update(timeElapsed);
+    for (User &user : _onlineUsers) user.update(timeElapsed);
 
     // Update non-user entities
     for (Entity *entP : _entities) entP->update(timeElapsed);
@@ -275,17 +473,27 @@ void Server::run() {
 
     _cities.update(timeElapsed);
 
-    // Deal with any messages from the server
-    while (!_messages.empty()) {
-      handleBufferedMessages(_messages.front().first, _messages.front().second);
-      _messages.pop();
-    }
+    // Deal with any messages from clients
+    handleNetworkEvents();
+    applyPendingMoves();
 
-    checkSockets();
+    // Send everything generated this tick
+    sendInventoryChanges();
+    sendVitalsChanges();
+    broadcastMovement();
+    flushOutgoingMessages();
 
-    SDL_Delay(1);
+    const auto nextTickIsDue = _lastTime + MAX_TIME_BETWEEN_TICKS;
+    const auto timeNow = SDL_GetTicks();
+    _network->waitForEvents(timeNow >= nextTickIsDue ? 0
+                                                     : nextTickIsDue - timeNow);
   }
 
+  sendInventoryChanges();
+  flushOutgoingMessages();
+  _network->stop();
+  _clientSessions.clear();
+
   // Save all user data
   for (const User &user : _onlineUsers) {
     writeUserData(user);
@@ -297,22 +505,18 @@ void Server::run() {
 }
 
 void Server::onDayChange() {
-  for (auto &constUser : _onlineUsers) {
-    auto &user = const_cast<User &>(constUser);
-    user.onDayChange();
-  }
+  for (auto &user : _onlineUsers) user.onDayChange();
 }
 
 void Server::addUser(const Socket &socket, const std::string &name,
                      const std::string &pwHash, const std::string &classID) {
-  auto newUserToInsert = User{name, {}, &socket};
-
   // Add new user to list
   logNumberOfOnlineUsers();
-  std::set<User>::const_iterator it =
-      _onlineUsers.insert(newUserToInsert).first;
-  auto &newUser = const_cast<User &>(*it);
-  _onlineUsersByName[name] = &*it;
+  const auto handle = _onlineUsers.emplace(name, MapPoint{}, &socket);
+  auto &newUser = *_onlineUsers.find(handle);
+  _onlineUsersByName[name] = &newUser;
+  auto sessionIt = _clientSessions.find(socket.getRaw());
+  if (sessionIt != _clientSessions.end()) sessionIt->second.user = handle;
   logNumberOfOnlineUsers();
 
   newUser.pwHash(pwHash);
@@ -349,15 +553,7 @@ void Server::addUser(const Socket &socket, const std::string &name,
   newUser.sendInfoToClient(newUser);
   _wars.sendWarsToUser(newUser, *this);
 
-  for (const User *userP : findUsersInArea(newUser.location())) {
-    if (userP == &newUser) continue;
-
-    // Send him information about other nearby users
-    userP->sendInfoToClient(newUser);
-    // Send nearby others this user's information
-    newUser.sendInfoToClient(*userP);
-  }
-
+  // Includes nearby users, who are also told about him
   sendRelevantEntitiesToUser(newUser);
   newUser.accountForOwnedEntities();
 
@@ -370,77 +566,16 @@ void Server::addUser(const Socket &socket, const std::string &name,
     groups->sendGroupMakeupTo(g, newUser);
   }
 
-  // Send him his inventory
-  for (size_t i = 0; i != User::INVENTORY_SIZE; ++i) {
-    if (newUser.inventory(i).hasItem())
-      sendInventoryMessage(newUser, i, Serial::Inventory());
-  }
-
-  // Send him his gear
-  for (size_t i = 0; i != User::GEAR_SLOTS; ++i) {
-    if (newUser.gear(i).hasItem())
-      sendInventoryMessage(newUser, i, Serial::Gear());
-  }
-
-  newUser.sendKnownRecipes();
-
-  // Send him the constructions he knows
-  if (newUser.knownConstructions().size() > 0) {
-    std::string args = makeArgs(newUser.knownConstructions().size());
-    for (const std::string &id : newUser.knownConstructions()) {
-      args = makeArgs(args, id);
-    }
-    newUser.sendMessage({SV_YOUR_CONSTRUCTIONS, args});
-  }
-
-  // Send him his talents
-  const auto &userClass = newUser.getClass();
-  auto treesToSend = std::set<std::string>{};
-  for (auto pair : userClass.talentRanks()) {
-    const auto &talent = *pair.first;
-    newUser.sendMessage({SV_TALENT_INFO, makeArgs(talent.name(), pair.second)});
-    treesToSend.insert(talent.tree());
-  }
-  for (const auto &tree : treesToSend) {
-    auto pointsInTree = userClass.pointsInTree(tree);
-    newUser.sendMessage({SV_POINTS_IN_TREE, makeArgs(tree, pointsInTree)});
-  }
-
-  // Send him his quest progress
-  for (const auto &pair : newUser.questsInProgress()) {
-    const auto &questID = pair.first;
-    const auto *quest = findQuest(questID);
-    if (quest->objectives.empty())
-      newUser.sendMessage({SV_QUEST_CAN_BE_FINISHED, questID});
-    else {
-      bool progressHasBeenMade = false;
-      for (auto i = 0; i != quest->objectives.size(); ++i) {
-        auto &objective = quest->objectives[i];
-        auto progress =
-            newUser.questProgress(questID, objective.type, objective.id);
-        if (progress == 0) continue;
-        newUser.sendMessage(
-            {SV_QUEST_PROGRESS, makeArgs(questID, i, progress)});
-        progressHasBeenMade = true;
-      }
-
-      if (!progressHasBeenMade)
-        newUser.sendMessage({SV_QUEST_IN_PROGRESS, questID});
-    }
-  }
-
   // Teach free spell if a new user, or a returning user without the spell
   auto spellTaught = newUser.getClass().teachFreeSpellIfAny();
   if (!spellTaught.empty())
     newUser.setHotbarAction(1, HOTBAR_SPELL, spellTaught);
 
-  // Send him his known spells
-  auto knownSpellsString = userClass.generateKnownSpellsString();
-  newUser.sendMessage({SV_KNOWN_SPELLS, knownSpellsString});
+  // Inventory, gear, recipes, talents, quests, map etc., in one message
+  newUser.sendLoginSnapshot();
 
   // Other info
   newUser.sendHotbarMessage();
-  if (userExisted) newUser.exploration.sendWholeMap(socket);
   _cities.sendInfoAboutCitiesTo(newUser);
   newUser.sendSpawnPoint();
 
@@ -457,12 +592,10 @@ void Server::addUser(const Socket &socket, const std::string &name,
     giveWarDeclarationDebuffsToCitizenAfterTheFact(newUser);
   }
 
-  // Add user to location-indexed trees
+  // Add user to location indices
   getCollisionChunk(newUser.location()).addEntity(&newUser);
-  _usersByX.insert(&newUser);
-  _usersByY.insert(&newUser);
-  _entitiesByX.insert(&newUser);
-  _entitiesByY.insert(&newUser);
+  _usersByLocation.add(&newUser);
+  _entitiesByLocation.add(&newUser);
 
   // Give any daily rewards
   auto shouldGiveDailyReward = newUser.didDayChangeWhileOffline();
@@ -474,8 +607,10 @@ void Server::addUser(const Socket &socket, const std::string &name,
   newUser.sendMessage({SV_LOGIN_INFO_HAS_FINISHED});
 }
 
-void Server::removeUser(const std::set<User>::iterator &it) {
-  const auto &userToDelete = *it;
+void Server::removeUser(OnlineUsers::Handle handle) {
+  auto *found = _onlineUsers.find(handle);
+  if (!found) return;
+  auto &userToDelete = *found;
 
   // Alert all users
   for (const User &user : _onlineUsers) {
@@ -490,52 +625,44 @@ void Server::removeUser(const std::set<User>::iterator &it) {
 
   getCollisionChunk(userToDelete.location())
       .removeEntity(userToDelete.serial());
-  _usersByX.erase(&userToDelete);
-  _usersByY.erase(&userToDelete);
-  _entitiesByX.erase(&userToDelete);
-  _entitiesByY.erase(&userToDelete);
+  _interest.forget(userToDelete);
+  forgetVitalsOf(userToDelete);
+  _usersByLocation.remove(&userToDelete);
+  _entitiesByLocation.remove(&userToDelete);
 
   logNumberOfOnlineUsers();
-  _onlineUsersByName.erase(it->name());
-  _onlineUsers.erase(it);
+  closeDatagramChannel(userToDelete.name());
+  _onlineUsersByName.erase(userToDelete.name());
+  _onlineUsers.erase(handle);
   logNumberOfOnlineUsers();
 }
 
 void Server::removeUser(const Socket &socket) {
-  const std::set<User>::iterator it = _onlineUsers.find(socket);
-  if (it != _onlineUsers.end()) {
-    _debug << "Removing user " << it->name() << Log::endl;
-    removeUser(it);
+  auto sessionIt = _clientSessions.find(socket.getRaw());
+  const auto *user = sessionIt == _clientSessions.end()
+                         ? nullptr
+                         : _onlineUsers.find(sessionIt->second.user);
+  if (user) {
+    _debug << "Removing user " << user->name() << Log::endl;
+    removeUser(sessionIt->second.user);
   } else
     _debug("User was already removed", Color::CHAT_ERROR);
 }
 
 std::set<User *> Server::findUsersInArea(MapPoint loc,
                                          double squareRadius) const {
-  static User lowDummy{MapPoint{}}, highDummy{MapPoint{}};
   std::set<User *> users;
-  lowDummy.changeDummyLocation(loc.x - squareRadius);
-  auto loX = _usersByX.lower_bound(&lowDummy);
-  highDummy.changeDummyLocation(loc.x + squareRadius);
-  auto hiX = _usersByX.upper_bound(&highDummy);
-  for (auto it = loX; it != hiX && it != _usersByX.end(); ++it)
-    if (abs(loc.y - (*it)->location().y) <= squareRadius)
-      users.insert(const_cast<User *>(*it));
-
+  forEachUserInArea(
+      loc, [&users](User *user) { users.insert(user); }, squareRadius);
   return users;
 }
 
 std::set<Entity *> Server::findEntitiesInArea(MapPoint loc,
                                               double squareRadius) const {
   std::set<Entity *> entities;
-  auto loX =
-      _entitiesByX.lower_bound(&Dummy::Location({loc.x - squareRadius, 0}));
-  auto hiX =
-      _entitiesByX.upper_bound(&Dummy::Location({loc.x + squareRadius, 0}));
-  for (auto it = loX; it != hiX; ++it)
-    if (abs(loc.y - (*it)->location().y) <= squareRadius)
-      entities.insert(const_cast<Entity *>(*it));
-
+  forEachEntityInArea(
+      loc, [&entities](Entity *entity) { entities.insert(entity); },
+      squareRadius);
   return entities;
 }
 
@@ -580,8 +707,7 @@ void Server::forceAllToUntarget(const Entity &target,
                                 const User *userToExclude) {
   // Fix users targeting the entity
   auto serial = target.serial();
-  for (const User &constUser : _onlineUsers) {
-    User &user = const_cast<User &>(constUser);
+  for (User &user : _onlineUsers) {
     if (&user == userToExclude) continue;
     if (user.target() == &target) {
       if (user.action() == User::ATTACK) user.finishAction();
@@ -620,12 +746,14 @@ void Server::removeEntity(Entity &ent, const User *userToExclude) {
 
   // Alert nearby users of the removal
   auto serial = ent.serial();
-  for (const User *userP : findUsersInArea(ent.location()))
-    userP->sendMessage({SV_OBJECT_REMOVED, serial});
+  forEachUserInArea(ent.location(), [serial](const User *user) {
+    user->sendMessage({SV_OBJECT_REMOVED, serial});
+  });
 
   getCollisionChunk(ent.location()).removeEntity(serial);
-  _entitiesByX.erase(&ent);
-  _entitiesByY.erase(&ent);
+  _interest.forget(ent);
+  forgetVitalsOf(ent);
+  _entitiesByLocation.remove(&ent);
   auto numRemoved = _entities.erase(&ent);
   delete &ent;
   if (numRemoved != 1) {
@@ -787,8 +915,10 @@ Entity &Server::addEntity(Entity *newEntity) {
   const auto shouldAlertNearbyUsers =
       newEntity->shouldBePropagatedToClients() && !isHidden;
   if (shouldAlertNearbyUsers) {
-    for (const User *userP : findUsersInArea(loc))
-      newEntity->sendInfoToClient(*userP, isNew);
+    forEachUserInArea(loc, [&](const User *user) {
+      newEntity->sendInfoToClient(*user, isNew);
+      _interest.markAsVisible(*user, *newEntity);
+    });
   }
   // Alert owner(s)
   if (newEntity->permissions.hasOwner()) {
@@ -802,9 +932,7 @@ Entity &Server::addEntity(Entity *newEntity) {
   if (newEntity->type()->collides())
     getCollisionChunk(loc).addEntity(newEntity);
 
-  // Add entity to x/y index sets
-  _entitiesByX.insert(newEntity);
-  _entitiesByY.insert(newEntity);
+  _entitiesByLocation.add(newEntity);
 
   return *newEntity;
 }
@@ -2,12 +2,15 @@
 #define SERVER_H
 
 #include <list>
+#include <mutex>
 #include <queue>
 #include <set>
 #include <string>
+#include <unordered_map>
 #include <utility>
 
 #include "../Args.h"
+#include "../DatagramSocket.h"
 #include "../ItemClass.h"
 #include "../Map.h"
 #include "../Socket.h"
@@ -21,13 +24,17 @@
 #include "CollisionChunk.h"
 #include "DataLoader.h"
 #include "Entities.h"
+#include "InterestManager.h"
 #include "ItemSet.h"
 #include "LogConsole.h"
 #include "NPC.h"
+#include "NetworkThread.h"
 #include "ObjectsByOwner.h"
 #include "Quest.h"
 #include "SRecipe.h"
 #include "ServerItem.h"
+#include "SlotMap.h"
+#include "SpatialGrid.h"
 #include "Spawner.h"
 #include "Spell.h"
 #include "Suffix.h"
@@ -58,6 +65,9 @@ class Server {
   static const ms_t CLIENT_TIMEOUT_AFTER_LOGIN = 10000;    // 10s
 
   static const ms_t MAX_TIME_BETWEEN_LOCATION_UPDATES;
+  // The main loop sleeps until there is network activity, or until this long
+  // has passed since the last tick.
+  static const ms_t MAX_TIME_BETWEEN_TICKS;
 
   static const px_t ACTION_DISTANCE;  // How close a character must be to
                                       // interact with an object
@@ -84,6 +94,18 @@ class Server {
                                    double squareRadius = CULL_DISTANCE) const;
   std::set<Entity *> findEntitiesInArea(
       MapPoint loc, double squareRadius = CULL_DISTANCE) const;
+  // As above, but calling visit() on each instead of collecting them.  The
+  // visitor mustn't add, remove or move any entity.
+  template <typename Visitor>
+  void forEachUserInArea(const MapPoint &loc, const Visitor &visit,
+                         double squareRadius = CULL_DISTANCE) const {
+    _usersByLocation.forEachInSquare(loc, squareRadius, visit);
+  }
+  template <typename Visitor>
+  void forEachEntityInArea(const MapPoint &loc, const Visitor &visit,
+                           double squareRadius = CULL_DISTANCE) const {
+    _entitiesByLocation.forEachInSquare(loc, squareRadius, visit);
+  }
   ObjectType *findObjectTypeByID(const std::string &id) const;  // Linear
   User *getUserByName(const std::string &username);
   const BuffType *getBuffByName(const Buff::ID &id) const;
@@ -119,17 +141,16 @@ class Server {
   const Terrain *terrainType(char index) const;
 
   // Messages
-  std::queue<std::pair<Socket, std::string>> _messages;
-  static const size_t BUFFER_SIZE = 1023;
-  char _stringInputBuffer[BUFFER_SIZE + 1];
   void sendMessage(const Socket &dstSocket, const Message &msg) const;
+  void sendMessage(const Socket &dstSocket, const SharedMessage &msg) const;
   void sendMessageIfOnline(const std::string username,
                            const Message &msg) const;
   void broadcast(const Message &msg);  // Send a command to all users
   void broadcastToArea(const MapPoint &location, const Message &msg) const;
   void broadcastToCity(const std::string &cityName, const Message &msg) const;
   void broadcastToGroup(Username aMember, const Message &msg);
-  void handleBufferedMessages(const Socket &client, const std::string &msg);
+  void handleBufferedMessages(const Socket &client,
+                              const std::string &messages);
   void sendInventoryMessageInner(const User &user, Serial serial, size_t slot,
                                  const ServerItem::vect_t &itemVect) const;
   void sendInventoryMessage(const User &user, size_t slot,
@@ -189,22 +210,29 @@ class Server {
   static Server *_instance;
   static LogConsole *_debugInstance;
 
-  static const int MAX_CLIENTS = 100;
-
   ms_t _time, _lastTime;
 
   DayChangeClock _dayChangeClock;
   void onDayChange();
 
-  Socket _socket;
+  Socket _socket;  // Listening
+  std::unique_ptr<NetworkThread> _network;  // While running
 
   bool _loop{false};
   bool _running{false};  // True while run() is being executed.
 
   // Clients
-  // All connected sockets, including those without registered users
-  std::set<Socket> _clientSockets;
-  std::set<User> _onlineUsers;  // All connected users
+  using OnlineUsers = SlotMap<User>;
+  OnlineUsers _onlineUsers;  // All connected users
+  // Every connection, including those without registered users.  Once its
+  // user has logged in, messages go straight to them through the handle.
+  struct ClientSession {
+    Socket socket;
+    OnlineUsers::Handle user;
+  };
+  std::unordered_map<SOCKET, ClientSession> _clientSessions;
+  void handleBufferedMessages(ClientSession &session, const char *messages,
+                              size_t length);
   // Pointers to all connected users, ordered by name for faster lookup
   mutable std::map<std::string, const User *> _onlineUsersByName;
   std::string _userFilesPath;
@@ -229,21 +257,125 @@ class Server {
   */
   void addUser(const Socket &socket, const std::string &name,
                const std::string &pwHash, const std::string &classID = {});
-  void checkSockets();
+  // Connections, disconnections and messages, from the network thread
+  void handleNetworkEvents();
+  // Movement is sent at most once per entity per tick, with the entity's
+  // location at the end of the tick, to the users who can see it.
+  void onEntityMoved(const Entity &entity);
+  void broadcastMovement();
+  std::mutex _movedEntitiesMutex;
+  std::set<Serial> _entitiesThatMoved;
+  std::set<std::string> _usersThatMoved;
+  void takeMovedEntities(std::set<Serial> &entities,
+                         std::set<std::string> &users);
+  // Optionally, movement is instead sent in snapshots, at a fixed rate.  Each
+  // user is sent up to a budget of bytes per snapshot, nearest movers first;
+  // the rest wait for the next snapshot, by which time they may have moved
+  // again.
+  static const size_t DEFAULT_SNAPSHOT_BUDGET = 4096;
+  ms_t _snapshotInterval{0};  // 0: every tick, without a budget
+  size_t _snapshotBudget{DEFAULT_SNAPSHOT_BUDGET};
+  ms_t _timeOfLastSnapshot{0};
+  struct PendingLocations {
+    std::set<Serial> entities;
+    std::set<std::string> users;
+    bool empty() const { return entities.empty() && users.empty(); }
+  };
+  std::map<std::string, PendingLocations> _pendingLocations;  // By observer
+  void sendMovementSnapshots();
+  void sendSnapshotTo(const User &observer, PendingLocations &pending);
+  // Users who ask can exchange movement over UDP, on the same port.  TCP is
+  // still used for everything else, including teleports.
+  DatagramSocket _datagramSocket;
+  struct DatagramPeer {
+    uint64_t token{0};
+    bool hasAddress{false};  // Once the client's first datagram arrives
+    sockaddr_in address{};
+    uint32_t lastSequenceReceived{0};
+    // Moves by datagram up to this one were sent before the latest move over
+    // TCP, and are superseded by it.
+    bool hasMovedByTcp{false};
+    uint32_t lastSequenceBeforeTcpMove{0};
+    uint32_t lastSequenceSent{0};
+    std::string unsent;  // Whole messages
+  };
+  std::map<std::string, DatagramPeer> _datagramPeers;  // By username
+  std::map<uint64_t, std::string> _usersByDatagramToken;
+  void openDatagramChannel(const User &user);
+  void closeDatagramChannel(const std::string &username);
+  void handleDatagram(const std::string &datagram, const sockaddr_in &sender);
+  // By datagram if the user has asked for it, or else as normal.  Returns the
+  // number of bytes the message took up.
+  size_t sendMovement(const User &recipient, const Message &message);
+  // Inventory slots that have changed this tick, by recipient then container.
+  // Each container's changes are sent as a single SV_INVENTORY at the end of
+  // the tick, so a craft or a loot-all is one message rather than dozens.
+  struct SlotContents {
+    std::string id;
+    size_t quantity{0};
+    Hitpoints health{0};
+    bool isSoulbound{false};
+    std::string suffix;
+  };
+  using InventoryChanges = std::map<Serial, std::map<size_t, SlotContents> >;
+  mutable std::mutex _inventoryChangesMutex;
+  mutable std::map<std::string, InventoryChanges> _inventoryChanges;
+  void sendInventoryChanges();
+  // Health, energy and their maxima can change many times a second, e.g.,
+  // from regeneration and damage over time.  A change only marks the entity;
+  // at the end of the tick, each user who can see it is sent whichever values
+  // differ from what that user was last told, together.
+  struct Vitals {
+    Hitpoints health{0}, maxHealth{0};
+    Energy energy{0}, maxEnergy{0};
+  };
+  using VitalsSent = std::map<Serial, Vitals>;  // By entity
+  void onVitalsChanged(const Entity &entity) const;
+  // Once the user is told about the entity some other way, or can no longer
+  // see it, the next change is sent in full.
+  void forgetVitalsSentTo(const User &observer, const Entity &entity) const;
+  void forgetVitalsOf(const Entity &entity) const;  // It's being removed.
+  mutable std::mutex _vitalsMutex;
+  mutable std::set<Serial> _entitiesWithChangedVitals;
+  mutable std::set<std::string> _usersWithChangedVitals;
+  mutable std::map<std::string, VitalsSent> _vitalsSent;  // By observer
+  void sendVitalsChanges();
+  void sendVitalsChange(const User &observer, const Entity &entity);
+  void sendDatagram(DatagramPeer &peer);
+  void flushDatagrams();
+  // The CL_MOVE_TOs a user sends in a tick are simulated together, as a single
+  // move through each location: at the end of the tick, or before that user's
+  // next message of another kind.
+  void applyPendingMove(User &user);
+  void applyPendingMoves();
+  std::set<std::string> _usersWithPendingMoves;
+  // Outgoing messages are queued, and sent by the network thread once per
+  // tick.
+  void flushOutgoingMessages();
+  // For a queue that has reached its high-water mark mid-tick
+  void flushSoon(const Socket &socket) const;
+  // A queue this large is flushed immediately, rather than waiting for the
+  // end of the tick.
+  OutboundQueue::Limits _sendQueueLimits;
+  // Messages per second that each client may send, by category
+  RateLimiter::Rates _rateLimits{RateLimiter::defaultRates()};
+  bool _compressionIsAllowed{true};
+  // How to encode what's sent to a client, as requested when it logs in
+  void applyProtocolRequest(const Socket &client,
+                            const ProtocolRequest &request) const;
 
   // Remove traces of a user who has disconnected.
   void removeUser(const Socket &socket);
-  void removeUser(const std::set<User>::iterator &it);
+  void removeUser(OnlineUsers::Handle handle);
 
-  User::byX_t
-      _usersByX;  // This and below are for alerting users in a specific area.
-  User::byY_t _usersByY;
+  // For alerting users in a specific area
+  SpatialGrid<User> _usersByLocation{CULL_DISTANCE};
 
   // World state
   Entities _entities;          // All entities except Users
-  Entity::byX_t _entitiesByX;  // This and below are for alerting users only to
-                               // nearby objects.
-  Entity::byY_t _entitiesByY;
+  // All entities, including users, for alerting users only to nearby ones
+  SpatialGrid<Entity> _entitiesByLocation{CULL_DISTANCE};
+  InterestManager _interest;  // What each user has been told is nearby
   ObjectsByOwner _objectsByOwner;
 
   Wars _wars;
@@ -324,10 +456,10 @@ class Server {
  private:
   // Collision detection
   static const px_t COLLISION_CHUNK_SIZE;
-  CollisionGrid _collisionGrid;
-  CollisionChunk &getCollisionChunk(const MapPoint &p);
-  std::list<const CollisionChunk *> getAllCollisionChunksTouchingRect(
-      const MapRect &r);
+  CollisionGrid _collisionGrid{COLLISION_CHUNK_SIZE};  // Sized to the map
+  CollisionChunk &getCollisionChunk(const MapPoint &p) {
+    return _collisionGrid.chunkAt(p);
+  }
 
  public:
   // thisObject = object to omit from collision detection (usually "this", to
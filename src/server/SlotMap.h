@@ -0,0 +1,116 @@
+#pragma once
+
+#include <cstdint>
+#include <iterator>
+#include <memory>
+#include <utility>
+#include <vector>
+
+// Objects that never move once added, each found in constant time by the
+// handle it was given.  A slot is reused once its object is erased, but with a
+// new generation, so that an old handle finds nothing rather than a stranger.
+template <typename T>
+class SlotMap {
+ public:
+  struct Handle {
+    uint32_t index{NONE};
+    uint32_t generation{0};
+
+    bool isValid() const { return index != NONE; }
+  };
+
+  template <typename... Args>
+  Handle emplace(Args &&... args) {
+    auto index = uint32_t{};
+    if (_freeSlots.empty()) {
+      index = static_cast<uint32_t>(_slots.size());
+      _slots.emplace_back();
+    } else {
+      index = _freeSlots.back();
+      _freeSlots.pop_back();
+    }
+    auto &slot = _slots[index];
+    slot.object = std::make_unique<T>(std::forward<Args>(args)...);
+    ++_size;
+    return {index, slot.generation};
+  }
+
+  // Null if the object has been erased
+  T *find(Handle handle) const {
+    if (handle.index >= _slots.size()) return nullptr;
+    const auto &slot = _slots[handle.index];
+    if (slot.generation != handle.generation) return nullptr;
+    return slot.object.get();
+  }
+
+  void erase(Handle handle) {
+    if (!find(handle)) return;
+    auto &slot = _slots[handle.index];
+    slot.object.reset();
+    ++slot.generation;
+    _freeSlots.push_back(handle.index);
+    --_size;
+  }
+
+  size_t size() const { return _size; }
+  bool empty() const { return _size == 0; }
+
+  // Visits occupied slots only, in slot order.  Erasing the current object, or
+  // adding another, leaves the iterator usable.
+  template <typename Value>
+  class Iterator {
+   public:
+    using iterator_category = std::forward_iterator_tag;
+    using value_type = T;
+    using difference_type = std::ptrdiff_t;
+    using pointer = Value *;
+    using reference = Value &;
+
+    Iterator(const SlotMap *container, size_t index)
+        : _container(container), _index(index) {
+      skipEmptySlots();
+    }
+
+    reference operator*() const { return *_container->_slots[_index].object; }
+    pointer operator->() const { return &**this; }
+    Iterator &operator++() {
+      ++_index;
+      skipEmptySlots();
+      return *this;
+    }
+    bool operator==(const Iterator &rhs) const { return _index == rhs._index; }
+    bool operator!=(const Iterator &rhs) const { return !(*this == rhs); }
+
+    Handle handle() const {
+      return {static_cast<uint32_t>(_index),
+              _container->_slots[_index].generation};
+    }
+
+   private:
+    const SlotMap *_container;
+    size_t _index;
+
+    void skipEmptySlots() {
+      const auto &slots = _container->_slots;
+      while (_index < slots.size() && !slots[_index].object) ++_index;
+    }
+  };
+  using iterator = Iterator<T>;
+  using const_iterator = Iterator<const T>;
+
+  iterator begin() { return {this, 0}; }
+  iterator end() { return {this, _slots.size()}; }
+  const_iterator begin() const { return {this, 0}; }
+  const_iterator end() const { return {this, _slots.size()}; }
+
+ private:
+  static constexpr uint32_t NONE = UINT32_MAX;
+
+  struct Slot {
+    std::unique_ptr<T> object;
+    uint32_t generation{0};
+  };
+  std::vector<Slot> _slots;
+  std::vector<uint32_t> _freeSlots;
+  size_t _size{0};
+};
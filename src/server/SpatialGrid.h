@@ -0,0 +1,112 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+#include "../Point.h"
+
+// Objects indexed by location, in square cells of a fixed size.  A move
+// changes the index only when it crosses into another cell, and queries visit
+// the objects found rather than collecting them.  T must have location().
+template <typename T>
+class SpatialGrid {
+ public:
+  explicit SpatialGrid(double cellSize) : _cellSize(cellSize) {}
+
+  // Adding an object that is already present has no effect.
+  void add(T *object) { addToCell(cellKey(object->location()), object); }
+  void remove(T *object) {
+    removeFromCell(cellKey(object->location()), object);
+  }
+  // For after the object's location has changed
+  void move(T *object, const MapPoint &oldLocation) {
+    const auto oldCell = cellKey(oldLocation),
+               newCell = cellKey(object->location());
+    if (oldCell == newCell) return;
+    removeFromCell(oldCell, object);
+    addToCell(newCell, object);
+  }
+
+  size_t size() const { return _size; }
+  bool empty() const { return _size == 0; }
+
+  // Call visit(T *) for every object no further than squareRadius from the
+  // centre along either axis.  The visitor mustn't change the index.
+  template <typename Visitor>
+  void forEachInSquare(const MapPoint &centre, double squareRadius,
+                       const Visitor &visit) const {
+    const auto isInSquare = [&](const T *object) {
+      const auto &loc = object->location();
+      return std::abs(loc.x - centre.x) <= squareRadius &&
+             std::abs(loc.y - centre.y) <= squareRadius;
+    };
+
+    const auto loX = cellCoord(centre.x - squareRadius),
+               hiX = cellCoord(centre.x + squareRadius),
+               loY = cellCoord(centre.y - squareRadius),
+               hiY = cellCoord(centre.y + squareRadius);
+
+    // A large enough square is cheaper to answer by checking every cell.
+    const auto numCellsInSquare = (static_cast<double>(hiX) - loX + 1) *
+                                  (static_cast<double>(hiY) - loY + 1);
+    if (numCellsInSquare > _cells.size()) {
+      for (const auto &pair : _cells)
+        for (auto *object : pair.second)
+          if (isInSquare(object)) visit(object);
+      return;
+    }
+
+    for (auto x = int64_t{loX}; x <= hiX; ++x)
+      for (auto y = int64_t{loY}; y <= hiY; ++y) {
+        auto it = _cells.find(cellKey(static_cast<int32_t>(x),
+                                      static_cast<int32_t>(y)));
+        if (it == _cells.end()) continue;
+        for (auto *object : it->second)
+          if (isInSquare(object)) visit(object);
+      }
+  }
+
+ private:
+  double _cellSize;
+  using CellKey = uint64_t;
+  // Emptied cells are kept, so that objects moving back and forth between two
+  // of them don't reallocate.
+  std::unordered_map<CellKey, std::vector<T *> > _cells;
+  size_t _size{0};
+
+  int32_t cellCoord(double coord) const {
+    const auto cell = std::floor(coord / _cellSize);
+    return static_cast<int32_t>(
+        std::max<double>(INT32_MIN, std::min<double>(INT32_MAX, cell)));
+  }
+  static CellKey cellKey(int32_t x, int32_t y) {
+    return static_cast<CellKey>(static_cast<uint32_t>(x)) << 32 |
+           static_cast<uint32_t>(y);
+  }
+  CellKey cellKey(const MapPoint &p) const {
+    return cellKey(cellCoord(p.x), cellCoord(p.y));
+  }
+
+  void addToCell(CellKey key, T *object) {
+    auto &cell = _cells[key];
+    for (auto *existing : cell)
+      if (existing == object) return;
+    cell.push_back(object);
+    ++_size;
+  }
+  void removeFromCell(CellKey key, T *object) {
+    auto it = _cells.find(key);
+    if (it == _cells.end()) return;
+    auto &cell = it->second;
+    for (auto &existing : cell) {
+      if (existing != object) continue;
+      existing = cell.back();
+      cell.pop_back();
+      --_size;
+      return;
+    }
+  }
+};
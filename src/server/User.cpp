@@ -3,6 +3,8 @@
 #include <algorithm>
 #include <thread>
 
+#include "../LoginSnapshot.h"
+#include "../MessageSchema.h"
 #include "../curlUtil.h"
 #include "../threadNaming.h"
 #include "Groups.h"
@@ -52,12 +54,6 @@ User::User(const std::string &name, const MapPoint &loc, const Socket *socket)
   }
 }
 
-User::User(const Socket &rhs)
-    : Object(MapPoint{}), _socket(rhs), exploration(0, 0) {}
-
-User::User(const MapPoint &loc)
-    : Object(loc), _socket(Socket::Empty()), exploration(0, 0) {}
-
 void User::initialiseInventoryAndGear() {
   for (size_t i = 0; i != INVENTORY_SIZE; ++i)
     _inventory[i] = {
@@ -107,8 +103,7 @@ void User::sendTimePlayed() const {
 }
 
 Message User::teleportMessage(const MapPoint &destination) const {
-  return {SV_USER_LOCATION_INSTANT,
-          makeArgs(name(), destination.x, destination.y)};
+  return Message::UserLocation(SV_USER_LOCATION_INSTANT, name(), destination);
 }
 
 void User::onTeleport() {
@@ -217,28 +212,6 @@ void User::init() {
   OBJECT_TYPE.baseStats(baseStats);
 }
 
-bool User::compareXThenSocketThenAddress::operator()(const User *a,
-                                                     const User *b) const {
-  if (a->location().x != b->location().x)
-    return a->location().x < b->location().x;
-  if (a->_socket.value() != b->_socket.value())
-    return a->_socket.value() < b->_socket.value();
-  return a < b;
-}
-
-bool User::compareYThenSocketThenAddress::operator()(const User *a,
-                                                     const User *b) const {
-  if (a->location().y != b->location().y)
-    return a->location().y < b->location().y;
-  if (a->_socket.value() != b->_socket.value())
-    return a->_socket.value() < b->_socket.value();
-  return a < b;
-}
-
-std::string User::makeLocationCommand() const {
-  return makeArgs(_name, location().x, location().y);
-}
-
 void User::contact() { _lastContact = SDL_GetTicks(); }
 
 bool User::hasExceededTimeout() const {
@@ -615,23 +588,22 @@ User::ToolSearchResult User::findTool(const std::string &tagName) {
 
   // Check nearby objects
   // Note that checking collision chunks means ignoring non-colliding objects.
-  auto nearbyEntities = server.findEntitiesInArea(location());
-  for (auto *pEnt : nearbyEntities) {
+  server.forEachEntityInArea(location(), [&](Entity *pEnt) {
     auto *pObj = dynamic_cast<Object *>(pEnt);
-    if (!pObj) continue;
-    if (pObj->isBeingBuilt()) continue;
-    if (pObj->isBroken()) continue;
+    if (!pObj) return;
+    if (pObj->isBeingBuilt()) return;
+    if (pObj->isBroken()) return;
     const auto *type = pObj->type();
-    if (!type->hasTag(tagName)) continue;
-    if (distance(*pObj, *this) > Server::ACTION_DISTANCE) continue;
-    if (!pObj->permissions.canUserUseAsTool(_name)) continue;
+    if (!type->hasTag(tagName)) return;
+    if (distance(*pObj, *this) > Server::ACTION_DISTANCE) return;
+    if (!pObj->permissions.canUserUseAsTool(_name)) return;
 
     auto toolSpeed = type->toolSpeed(tagName);
     if (toolIsBetter(toolSpeed)) {
       bestSpeed = toolSpeed;
       bestTool = ToolSearchResult{*pObj, *type, tagName};
     }
-  }
+  });
 
   return bestTool;
 }
@@ -674,8 +646,7 @@ void User::clearInventory() {
   for (auto i = 0; i != INVENTORY_SIZE; ++i)
     if (_inventory[i].hasItem()) {
       _inventory[i] = {};
-      server.sendMessage(socket(), {SV_INVENTORY, makeArgs(Serial::Inventory(),
-                                                           i, ""s, 0, 0, ""s)});
+      server.sendInventoryMessage(*this, i, Serial::Inventory());
     }
 }
 
@@ -684,8 +655,7 @@ void User::clearGear() {
   for (auto i = 0; i != GEAR_SLOTS; ++i)
     if (_gear[i].hasItem()) {
       _gear[i] = {};
-      server.sendMessage(socket(), {SV_INVENTORY, makeArgs(Serial::Gear(), i,
-                                                           ""s, 0, 0, ""s)});
+      server.sendInventoryMessage(*this, i, Serial::Gear());
     }
 }
 
@@ -793,6 +763,12 @@ void User::sendMessage(const Message &msg) const {
   server.sendMessage(_socket.value(), msg);
 }
 
+void User::sendMessage(const SharedMessage &msg) const {
+  if (!_socket.hasValue()) return;
+  const Server &server = Server::instance();
+  server.sendMessage(_socket.value(), msg);
+}
+
 void User::update(ms_t timeElapsed) {
   // Quests
   auto questsToAbandon = std::set<std::string>{};
@@ -1033,17 +1009,17 @@ void User::onMove() {
 
   // Get buffs from objects
   auto buffsToAdd = std::map<const BuffType *, Entity *>{};
-  for (auto *entity : server.findEntitiesInArea(location())) {
+  server.forEachEntityInArea(location(), [&](Entity *entity) {
     const Object *pObj = dynamic_cast<const Object *>(entity);
-    if (pObj == nullptr) continue;
-    if (!pObj->permissions.canUserGetBuffs(_name)) continue;
-    if (pObj->isBeingBuilt()) continue;
+    if (pObj == nullptr) return;
+    if (!pObj->permissions.canUserGetBuffs(_name)) return;
+    if (pObj->isBeingBuilt()) return;
     const auto &objType = pObj->objType();
-    if (!objType.grantsBuff()) continue;
-    if (distance(*pObj, *this) > objType.buffRadius()) continue;
+    if (!objType.grantsBuff()) return;
+    if (distance(*pObj, *this) > objType.buffRadius()) return;
 
     buffsToAdd[objType.buffGranted()] = entity;
-  }
+  });
 
   // Remove any disqualified pre-existing object buffs
   auto buffsToRemove = std::set<std::string>{};
@@ -1136,22 +1112,6 @@ double User::combatDamage() const {
     return stats().magicDamage.addTo(stats().weaponDamage);
 }
 
-void User::onHealthChange() {
-  const Server &server = *Server::_instance;
-  for (const User *userToInform : server.findUsersInArea(location()))
-    server.sendMessage(userToInform->socket(),
-                       {SV_PLAYER_HEALTH, makeArgs(_name, health())});
-  Object::onHealthChange();
-}
-
-void User::onEnergyChange() {
-  const Server &server = *Server::_instance;
-  for (const User *userToInform : server.findUsersInArea(location()))
-    server.sendMessage(userToInform->socket(),
-                       {SV_PLAYER_ENERGY, makeArgs(_name, energy())});
-  Object::onEnergyChange();
-}
-
 void User::onDeath() {
   health(stats().maxHealth);
   energy(stats().maxEnergy);
@@ -1399,14 +1359,14 @@ void User::sendRangedMissMessageTo(const User &userToInform) const {
 
 void User::broadcastDamagedMessage(Hitpoints amount) const {
   Server &server = *Server::_instance;
-  server.broadcastToArea(location(),
-                         {SV_PLAYER_DAMAGED, makeArgs(_name, amount)});
+  server.broadcastToArea(
+      location(), MessageSchema<SV_PLAYER_DAMAGED>::build(_name, amount));
 }
 
 void User::broadcastHealedMessage(Hitpoints amount) const {
   Server &server = *Server::_instance;
   server.broadcastToArea(location(),
-                         {SV_PLAYER_HEALED, makeArgs(_name, amount)});
+                         MessageSchema<SV_PLAYER_HEALED>::build(_name, amount));
 }
 
 void User::updateStats() {
@@ -1439,11 +1399,6 @@ void User::updateStats() {
 
   // Special case: health must change to reflect new max health
   int healthDecrease = oldMaxHealth - newStats.maxHealth;
-  if (healthDecrease != 0) {
-    // Alert nearby users to new max health
-    server.broadcastToArea(
-        location(), {SV_MAX_HEALTH, makeArgs(_name, newStats.maxHealth)});
-  }
   int oldHealth = health();
   auto newHealth = oldHealth - healthDecrease;
   if (newHealth < 1)  // Implicit rule: changing gear can never kill you, only
@@ -1457,11 +1412,6 @@ void User::updateStats() {
   }
 
   int energyDecrease = oldMaxEnergy - newStats.maxEnergy;
-  if (energyDecrease != 0) {
-    // Alert nearby users to new max energy
-    server.broadcastToArea(
-        location(), {SV_MAX_ENERGY, makeArgs(_name, newStats.maxEnergy)});
-  }
   int oldEnergy = energy();
   auto newEnergy = oldEnergy - energyDecrease;
   if (newEnergy < 0)
@@ -1473,25 +1423,28 @@ void User::updateStats() {
     onEnergyChange();
   }
 
+  stats(newStats);
+  server.onVitalsChanged(*this);
+}
+
+void User::sendStatsIfChanged() const {
+  const auto &s = stats();
   auto args = makeArgs(
-      makeArgs(newStats.armor, newStats.maxHealth, newStats.maxEnergy,
-               newStats.hps, newStats.eps),
-      makeArgs(newStats.hit, newStats.crit, newStats.critResist, newStats.dodge,
-               newStats.block, newStats.blockValue),
-      makeArgs(newStats.magicDamage, newStats.physicalDamage, newStats.healing),
-      makeArgs(newStats.airResist, newStats.earthResist, newStats.fireResist,
-               newStats.waterResist),
-      makeArgs(newStats.attackTime, newStats.followerLimit, newStats.speed));
+      makeArgs(s.armor, s.maxHealth, s.maxEnergy, s.hps, s.eps),
+      makeArgs(s.hit, s.crit, s.critResist, s.dodge, s.block, s.blockValue),
+      makeArgs(s.magicDamage, s.physicalDamage, s.healing),
+      makeArgs(s.airResist, s.earthResist, s.fireResist, s.waterResist),
+      makeArgs(s.attackTime, s.followerLimit, s.speed));
 
   for (const auto &stat : Stats::compositeDefinitions) {
     auto statName = stat.first;
-    auto statValue = newStats.getComposite(statName);
+    auto statValue = s.getComposite(statName);
     args = makeArgs(args, statValue);
   }
 
+  if (args == _statsLastSent) return;
+  _statsLastSent = args;
   sendMessage({SV_YOUR_STATS, args});
-
-  stats(newStats);
 }
 
 double User::legalMoveDistance(double requestedDistance,
@@ -1556,22 +1509,26 @@ void User::addConstruction(const std::string &id, bool newlyLearned) {
 
 void User::sendInfoToClient(const User &targetUser, bool isNew) const {
   const Server &server = Server::instance();
+  server.forgetVitalsSentTo(targetUser, *this);
   const Socket &client = targetUser.socket();
 
   bool isSelf = &targetUser == this;
 
   // Location
-  server.sendMessage(client, {SV_USER_LOCATION, makeLocationCommand()});
+  server.sendMessage(client, Message::UserLocation(SV_USER_LOCATION, _name,
+                                                   location()));
 
   // Hitpoints
+  server.sendMessage(
+      client, MessageSchema<SV_MAX_HEALTH>::build(_name, stats().maxHealth));
   server.sendMessage(client,
-                     {SV_MAX_HEALTH, makeArgs(_name, stats().maxHealth)});
-  server.sendMessage(client, {SV_PLAYER_HEALTH, makeArgs(_name, health())});
+                     MessageSchema<SV_PLAYER_HEALTH>::build(_name, health()));
 
   // Energy
+  server.sendMessage(
+      client, MessageSchema<SV_MAX_ENERGY>::build(_name, stats().maxEnergy));
   server.sendMessage(client,
-                     {SV_MAX_ENERGY, makeArgs(_name, stats().maxEnergy)});
-  server.sendMessage(client, {SV_PLAYER_ENERGY, makeArgs(_name, energy())});
+                     MessageSchema<SV_PLAYER_ENERGY>::build(_name, energy()));
 
   // Class
   server.sendMessage(
@@ -1623,21 +1580,14 @@ void User::sendInfoToClient(const User &targetUser, bool isNew) const {
 void User::sendInventorySlot(size_t slotIndex) const {
   const auto &slot = _inventory[slotIndex];
   if (!slot.type()) return;  // Is this right?
-  const auto isSoulbound = slot.isSoulbound() ? "1" : "0";
-  sendMessage(
-      {SV_INVENTORY,
-       makeArgs(Serial::Inventory(), slotIndex, slot.type()->id(),
-                slot.quantity(), slot.health(), isSoulbound, slot.suffix())});
+  Server::instance().sendInventoryMessage(*this, slotIndex,
+                                          Serial::Inventory());
 }
 
 void User::sendGearSlot(size_t slotIndex) const {
   const auto &slot = _gear[slotIndex];
   if (!slot.type()) return;
-  const auto isSoulbound = slot.isSoulbound() ? "1" : "0";
-  sendMessage(
-      {SV_INVENTORY,
-       makeArgs(Serial::Gear(), slotIndex, slot.type()->id(), slot.quantity(),
-                slot.health(), isSoulbound, slot.suffix())});
+  Server::instance().sendInventoryMessage(*this, slotIndex, Serial::Gear());
 }
 
 void User::sendSpawnPoint(bool hasChanged) const {
@@ -1646,28 +1596,58 @@ void User::sendSpawnPoint(bool hasChanged) const {
   sendMessage({code, makeArgs(_respawnPoint.x, _respawnPoint.y)});
 }
 
-void User::sendKnownRecipes() const {
-  if (_knownRecipes.empty()) return;
+void User::sendLoginSnapshot() const {
+  auto snapshot = LoginSnapshot{};
 
-  const auto MAX_BATCH_SIZE = 10;
-  auto batch = std::set<std::string>{};
-  for (const auto &recipeID : _knownRecipes) {
-    batch.insert(recipeID);
+  const auto addOccupiedSlots = [](const ServerItem::vect_t &container,
+                                   std::vector<LoginSnapshot::Item> &items) {
+    for (auto i = size_t{0}; i != container.size(); ++i) {
+      const auto &slot = container[i];
+      if (!slot.hasItem()) continue;
+      items.push_back({i, slot.type()->id(), slot.quantity(), slot.health(),
+                       slot.isSoulbound(), slot.suffix()});
+    }
+  };
+  addOccupiedSlots(_inventory, snapshot.inventory);
+  addOccupiedSlots(_gear, snapshot.gear);
 
-    if (batch.size() == MAX_BATCH_SIZE) {
-      sendKnownRecipesBatch(batch);
-      batch.clear();
+  snapshot.recipes.assign(_knownRecipes.begin(), _knownRecipes.end());
+  snapshot.constructions.assign(_knownConstructions.begin(),
+                                _knownConstructions.end());
+  snapshot.spells = getClass().knownSpellIDs();
+
+  auto treesWithTalents = std::set<std::string>{};
+  for (const auto &pair : getClass().talentRanks()) {
+    snapshot.talentRanks.push_back({pair.first->name(), pair.second});
+    treesWithTalents.insert(pair.first->tree());
+  }
+  for (const auto &tree : treesWithTalents)
+    snapshot.pointsInTrees.push_back(
+        {tree, static_cast<int>(getClass().pointsInTree(tree))});
+
+  const auto &server = Server::instance();
+  for (const auto &pair : _quests) {
+    const auto *quest = server.findQuest(pair.first);
+    if (!quest) continue;
+    auto state = LoginSnapshot::QuestState{};
+    state.id = pair.first;
+    state.canBeFinished = quest->objectives.empty();
+    for (auto i = size_t{0}; i != quest->objectives.size(); ++i) {
+      const auto &objective = quest->objectives[i];
+      const auto progress =
+          questProgress(pair.first, objective.type, objective.id);
+      if (progress != 0) state.progress.push_back({i, progress});
     }
+    snapshot.quests.push_back(state);
   }
-  if (!batch.empty()) sendKnownRecipesBatch(batch);
-}
-void User::sendKnownRecipesBatch(const std::set<std::string> &batch) const {
-  auto args = makeArgs(batch.size());
-  for (auto id : batch) args = makeArgs(args, id);
-  sendMessage({SV_YOUR_RECIPES, args});
+
+  exploration.writeTo(snapshot);
+
+  sendMessage(MessageSchema<SV_LOGIN_SNAPSHOT>::build(snapshot));
 }
 
 void User::onOutOfRange(const Entity &rhs) const {
+  Server::instance().forgetVitalsSentTo(*this, rhs);
   if (rhs.shouldAlwaysBeKnownToUser(*this)) return;
   sendMessage(rhs.outOfRangeMessage());
 }
@@ -1698,12 +1678,10 @@ void User::moveToSpawnPoint(bool isNewPlayer) {
 
   if (isNewPlayer) return;
 
-  server.broadcastToArea(
-      oldLoc,
-      {SV_USER_LOCATION_INSTANT, makeArgs(name(), location().x, location().y)});
-  server.broadcastToArea(
-      location(),
-      {SV_USER_LOCATION_INSTANT, makeArgs(name(), location().x, location().y)});
+  const auto locationMessage =
+      Message::UserLocation(SV_USER_LOCATION_INSTANT, name(), location());
+  server.broadcastToArea(oldLoc, locationMessage);
+  server.broadcastToArea(location(), locationMessage);
 
   server.sendRelevantEntitiesToUser(*this);
 }
@@ -75,6 +75,8 @@ class User : public Object {  // TODO: Don't inherit from Object
 
   ServerItem::vect_t _inventory, _gear;
 
+  mutable std::string _statsLastSent;  // The arguments of SV_YOUR_STATS
+
   struct HotbarAction {
     HotbarCategory category{HOTBAR_NONE};
     std::string id{};
@@ -114,15 +116,8 @@ class User : public Object {  // TODO: Don't inherit from Object
 
  public:
   User(const std::string &name, const MapPoint &loc, const Socket *socket);
-  User(const Socket &rhs);  // for use with set::find(), allowing find-by-socket
-  User(const MapPoint
-           &loc);  // for use with set::find(), allowing find-by-location
   virtual ~User() {}
 
-  bool operator<(const User &rhs) const {
-    return _socket.value() < rhs._socket.value();
-  }
-
   // May be run only after User object is in its permanent location.
   void initialiseInventoryAndGear();
 
@@ -184,6 +179,9 @@ class User : public Object {  // TODO: Don't inherit from Object
 
   bool isWaitingForDeathAcknowledgement{false};
 
+  // Locations requested with CL_MOVE_TO, in order, not yet simulated
+  std::vector<MapPoint> pendingMoveTargets;
+
   // Inventory getters/setters
   const ServerItem::Instance &inventory(size_t index) const {
     return _inventory[index];
@@ -207,6 +205,8 @@ class User : public Object {  // TODO: Don't inherit from Object
   }
 
   void updateStats() override;
+  // Sent at the end of the tick, with any changes to vitals
+  void sendStatsIfChanged() const;
 
   double legalMoveDistance(double requestedDistance,
                            double timeElapsed) const override;
@@ -238,8 +238,6 @@ class User : public Object {  // TODO: Don't inherit from Object
   void sendLostBuffMsg(const Buff::ID &buff) const override;
   void sendLostDebuffMsg(const Buff::ID &buff) const override;
 
-  void onHealthChange() override;
-  void onEnergyChange() override;
   void onDeath() override;
   void accountForOwnedEntities() const;
   void registerObjectIfPlayerUnique(const ObjectType &type) const;
@@ -261,8 +259,8 @@ class User : public Object {  // TODO: Don't inherit from Object
   void sendInventorySlot(size_t slot) const;
   void sendGearSlot(size_t slot) const;
   void sendSpawnPoint(bool hasChanged = false) const;
-  void sendKnownRecipes() const;
-  void sendKnownRecipesBatch(const std::set<std::string> &batch) const;
+  // Everything about the user themselves that's sent on login
+  void sendLoginSnapshot() const;
 
   void onOutOfRange(const Entity &rhs) const override;
   Message outOfRangeMessage() const override;
@@ -345,7 +343,6 @@ class User : public Object {  // TODO: Don't inherit from Object
   void cancelAction();  // Cancel any action in progress, and alert the client
   void finishAction();  // An action has just ended; clean up the state.
 
-  std::string makeLocationCommand() const;
 
   static const size_t INVENTORY_SIZE = 15;
   static const size_t GEAR_SLOTS = 8;
@@ -383,6 +380,7 @@ class User : public Object {  // TODO: Don't inherit from Object
   bool didDayChangeWhileOffline() const { return _dayChangedWhileOffline; }
 
   void sendMessage(const Message &msg) const;
+  void sendMessage(const SharedMessage &msg) const;
 
   void update(ms_t timeElapsed);
 
@@ -420,15 +418,6 @@ class User : public Object {  // TODO: Don't inherit from Object
     return _quests.find(id) != _quests.end();
   }
   bool canStartQuest(const Quest::ID &quest) const;
-
-  struct compareXThenSocketThenAddress {
-    bool operator()(const User *a, const User *b) const;
-  };
-  struct compareYThenSocketThenAddress {
-    bool operator()(const User *a, const User *b) const;
-  };
-  typedef std::set<const User *, User::compareXThenSocketThenAddress> byX_t;
-  typedef std::set<const User *, User::compareYThenSocketThenAddress> byY_t;
 };
 
 #endif
@@ -1,4 +1,3 @@
-#include <list>
 #include <utility>
 
 #include "CollisionChunk.h"
@@ -43,19 +42,14 @@ bool Server::isLocationValid(const MapRect &rect,
     if (!allowedTerrain.allows(terrainType)) return false;
 
   // Objects
-  auto superChunk = getAllCollisionChunksTouchingRect(rect);
-  for (const auto *chunk : superChunk)
-    for (const auto &pair : chunk->entities()) {
-      const Entity *pEnt = pair.second;
-      if (pEnt == thisEntity) continue;
-      if (!pEnt->collides()) continue;
+  return _collisionGrid.forEachEntityNear(rect, [&](const Entity *pEnt) {
+    if (pEnt == thisEntity) return true;
+    if (!pEnt->collides()) return true;
 
-      if (thisEntity && pEnt->areOverlapsAllowedWith(*thisEntity)) continue;
+    if (thisEntity && pEnt->areOverlapsAllowedWith(*thisEntity)) return true;
 
-      if (rect.overlaps(pEnt->collisionRect())) return false;
-    }
-
-  return true;
+    return !rect.overlaps(pEnt->collisionRect());
+  });
 }
 
 std::pair<size_t, size_t> Server::getTileCoords(const MapPoint &p) const {
@@ -68,43 +62,6 @@ char Server::findTile(const MapPoint &p) const {
   return _map[coords.first][coords.second];
 }
 
-CollisionChunk &Server::getCollisionChunk(const MapPoint &p) {
-  size_t x = static_cast<size_t>(p.x / COLLISION_CHUNK_SIZE),
-         y = static_cast<size_t>(p.y / COLLISION_CHUNK_SIZE);
-  return _collisionGrid[x][y];
-}
-
-std::list<const CollisionChunk *> Server::getAllCollisionChunksTouchingRect(
-    const MapRect &r) {
-  auto chunks = std::list<const CollisionChunk *>{};
-  auto left = static_cast<size_t>(r.x / COLLISION_CHUNK_SIZE),
-       right = static_cast<size_t>((r.x + r.w) / COLLISION_CHUNK_SIZE),
-       top = static_cast<size_t>(r.y / COLLISION_CHUNK_SIZE),
-       bottom = static_cast<size_t>((r.y + r.h) / COLLISION_CHUNK_SIZE);
-
-  // Consider neighbours, in case an object covers two chunks
-  if (left > 0) --left;
-  if (top > 0) --top;
-  ++right;
-  ++bottom;
-
-  for (auto x = left; x <= right; ++x) {
-    const auto rowIt = _collisionGrid.find(x);
-    if (rowIt == _collisionGrid.end()) continue;
-    const auto &row = rowIt->second;
-
-    for (auto y = top; y <= bottom; ++y) {
-      const auto chunkIter = row.find(y);
-      if (chunkIter == row.end()) continue;
-      const auto &chunk = chunkIter->second;
-
-      chunks.push_back(&chunk);
-    }
-  }
-
-  return chunks;
-}
-
 // For the functions below:
 //          USER  NPC    GATE  ITEM OTHER   (this)
 //   USER    T     T      ?     T
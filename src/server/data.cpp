@@ -585,8 +585,8 @@ void Server::loadEntities(XmlReader &xr,
       size_t wareQty = 1, priceQty = 1;
       xr.findAttr(merchant, "wareQty", wareQty);
       xr.findAttr(merchant, "priceQty", priceQty);
-      obj.merchantSlot(slot) =
-          MerchantSlot(&*wareIt, wareQty, &*priceIt, priceQty);
+      obj.setMerchantSlot(
+          slot, MerchantSlot(&*wareIt, wareQty, &*priceIt, priceQty));
     }
 
     obj.clearMaterialsRequired();
@@ -178,6 +178,24 @@ void Server::publishStats() {
   oss << "uptime: " << _time << ",\n";
   oss << "time: " << time(nullptr) << ",\n";
 
+  // Clients falling behind
+  oss << "messagesShed: " << OutboundQueue::totalMessagesShed() << ",\n";
+  oss << "largestSendBacklog: " << OutboundQueue::largestBacklog() << ",\n";
+  if (_network)
+    oss << "clientsDisconnectedForFallingBehind: "
+        << _network->clientsDisconnectedForFallingBehind() << ",\n";
+
+  // Clients sending too quickly
+  if (_network) {
+    oss << "messagesDroppedByRateLimit: {";
+    for (auto i = 0; i != RateLimiter::NUM_CATEGORIES; ++i) {
+      const auto category = static_cast<RateLimiter::Category>(i);
+      oss << RateLimiter::name(category) << ":"
+          << _network->messagesDroppedByRateLimit(category) << ",";
+    }
+    oss << "},\n";
+  }
+
   // Game data
   oss << "recipes: " << _recipes.size() << ",\n";
   oss << "constructions: " << _numBuildableObjects << ",\n";
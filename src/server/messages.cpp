@@ -2,6 +2,7 @@
 #include <set>
 
 #include "../MessageParser.h"
+#include "../MessageSchema.h"
 #include "../versionUtil.h"
 #include "DroppedItem.h"
 #include "Groups.h"
@@ -47,6 +48,7 @@ HANDLE_MESSAGE(CL_PING) {
 HANDLE_MESSAGE(CL_LOGIN_EXISTING) {
   std::string username, passwordHash, clientVersion;
   READ_ARGS(username, passwordHash, clientVersion);
+  applyProtocolRequest(client, extractProtocolRequest(clientVersion));
 
 #ifndef _DEBUG
   if (clientVersion != version()) {
@@ -87,6 +89,7 @@ HANDLE_MESSAGE(CL_LOGIN_EXISTING) {
 HANDLE_MESSAGE(CL_LOGIN_NEW) {
   std::string name, pwHash, classID, clientVersion;
   READ_ARGS(name, pwHash, classID, clientVersion);
+  applyProtocolRequest(client, extractProtocolRequest(clientVersion));
 
 #ifndef _DEBUG
   // Check that version matches
@@ -113,6 +116,12 @@ HANDLE_MESSAGE(CL_REQUEST_TIME_PLAYED) {
   user.sendTimePlayed();
 }
 
+HANDLE_MESSAGE(CL_REQUEST_DATAGRAM_CHANNEL) {
+  CHECK_NO_ARGS;
+
+  openDatagramChannel(user);
+}
+
 HANDLE_MESSAGE(CL_SKIP_TUTORIAL) {
   CHECK_NO_ARGS;
 
@@ -156,34 +165,69 @@ HANDLE_MESSAGE(CL_SKIP_TUTORIAL) {
 
 HANDLE_MESSAGE(CL_MOVE_TO) {
   double x, y;
-  READ_ARGS(x, y);
+  if (!parser.readNextArg(x) || !parser.readNextArg(y)) return;
+  if (!parser.hasReadAllArgs()) {
+    auto lastDatagramSent = uint32_t{};
+    READ_ARGS(lastDatagramSent);
+    auto peerIt = _datagramPeers.find(user.name());
+    if (peerIt != _datagramPeers.end()) {
+      peerIt->second.hasMovedByTcp = true;
+      peerIt->second.lastSequenceBeforeTcpMove = lastDatagramSent;
+    }
+  }
 
   if (user.isWaitingForDeathAcknowledgement) return;
 
   if (user.isStunned()) {
-    client.sendMessage(
-        {SV_USER_LOCATION,
-         makeArgs(user.name(), user.location().x, user.location().y)});
+    user.pendingMoveTargets.clear();
+    client.sendMessage(Message::UserLocation(SV_USER_LOCATION, user.name(),
+                                             user.location()));
     return;
   }
 
   if (user.action() != User::ATTACK) user.cancelAction();
   user.removeInterruptibleBuffs();
 
+  user.pendingMoveTargets.push_back({x, y});
+  _usersWithPendingMoves.insert(user.name());
+}
+
+void Server::applyPendingMove(User &user) {
+  if (user.pendingMoveTargets.empty()) return;
+  auto targets = std::vector<MapPoint>{};
+  targets.swap(user.pendingMoveTargets);
+
+  // The user may have died or been stunned since the moves arrived.
+  if (user.isDead() || user.isWaitingForDeathAcknowledgement) return;
+  if (user.isStunned()) {
+    user.sendMessage(Message::UserLocation(SV_USER_LOCATION, user.name(),
+                                           user.location()));
+    return;
+  }
+
   if (user.isDriving()) {
     // Move vehicle and user together
     auto vehicleSerial = user.driving();
     auto &vehicle = *_entities.find<Vehicle>(vehicleSerial);
-    vehicle.moveLegallyTowards({x, y});
-    auto locationWasCorrected = vehicle.location() != MapPoint{x, y};
+    vehicle.moveLegallyAlong(targets);
+    auto locationWasCorrected = vehicle.location() != targets.back();
     auto shouldSendUpdate = locationWasCorrected ? Entity::AlwaysSendUpdate
                                                  : Entity::OnServerCorrection;
     user.moveLegallyTowards(vehicle.location(), shouldSendUpdate);
   } else {
-    user.moveLegallyTowards({x, y});
+    user.moveLegallyAlong(targets);
   }
 }
 
+void Server::applyPendingMoves() {
+  for (const auto &username : _usersWithPendingMoves) {
+    auto it = _onlineUsersByName.find(username);
+    if (it == _onlineUsersByName.end()) continue;
+    applyPendingMove(const_cast<User &>(*it->second));
+  }
+  _usersWithPendingMoves.clear();
+}
+
 HANDLE_MESSAGE(CL_CANCEL_ACTION) {
   CHECK_NO_ARGS
   user.cancelAction();
@@ -518,9 +562,10 @@ HANDLE_MESSAGE(CL_SWAP_ITEMS) {
 
     // Remove from object requirements
     to.object->remainingMaterials().remove(materialType, qtyToTake);
-    for (const User *otherUser : findUsersInArea(user.location()))
+    forEachUserInArea(user.location(), [&](const User *otherUser) {
       if (to.object->permissions.canUserAccessContainer(otherUser->name()))
         sendConstructionMaterialsMessage(*otherUser, *to.object);
+    });
 
     // Remove items from user
     fromItem.removeItems(qtyToTake);
@@ -531,13 +576,14 @@ HANDLE_MESSAGE(CL_SWAP_ITEMS) {
     if (!to.object->isBeingBuilt()) {
       // Send to all nearby players, since object appearance will
       // change
-      for (const User *otherUser : findUsersInArea(user.location()))
+      forEachUserInArea(user.location(), [&](const User *otherUser) {
         sendConstructionMaterialsMessage(*otherUser, *to.object);
+      });
       for (const std::string &owner :
            to.object->permissions.ownerAsUsernames()) {
         auto pUser = getUserByName(owner);
         if (pUser)
-          sendConstructionMaterialsMessage(pUser->socket(), *to.object);
+          sendConstructionMaterialsMessage(*pUser, *to.object);
       }
 
       // Trigger completing user's unlocks
@@ -643,12 +689,12 @@ HANDLE_MESSAGE(CL_SWAP_ITEMS) {
           itemHealth = toItem.health();
         }
       }
-      for (const User *otherUser : findUsersInArea(user.location())) {
-        if (otherUser == &user) continue;
+      forEachUserInArea(user.location(), [&](const User *otherUser) {
+        if (otherUser == &user) return;
         sendMessage(
             otherUser->socket(),
             {SV_GEAR, makeArgs(user.name(), gearSlot, gearID, itemHealth)});
-      }
+      });
     }
   }
 
@@ -709,8 +755,9 @@ HANDLE_MESSAGE(CL_AUTO_CONSTRUCT) {
     user.giveItem(itemToReturn, pair.second);
   }
 
-  for (const User *nearbyUser : findUsersInArea(obj->location()))
+  forEachUserInArea(obj->location(), [&](const User *nearbyUser) {
     sendConstructionMaterialsMessage(*nearbyUser, *obj);
+  });
 
   if (!obj->isBeingBuilt()) {
     // Trigger completing user's unlocks
@@ -1473,27 +1520,36 @@ HANDLE_MESSAGE(DG_SIMULATE_YIELDS) {
 
 void Server::handleBufferedMessages(const Socket &client,
                                     const std::string &messages) {
-  _debug(messages);
+  auto it = _clientSessions.find(client.getRaw());
+  if (it == _clientSessions.end()) return;  // Already disconnected
+  handleBufferedMessages(it->second, messages.data(), messages.size());
+}
+
+void Server::handleBufferedMessages(ClientSession &session,
+                                    const char *messages, size_t length) {
+  _debug(std::string{messages, length});
+  const auto &client = session.socket;
   char del;
-  MessageParser parser(messages);
+  MessageParser parser(messages, length);
   User *user = nullptr;
   while (parser.hasAnotherMessage()) {
     auto msgCode = parser.nextMessage();
 
-    // Discard message if this client has not yet logged in
-    auto it = _onlineUsers.find(client);
-    auto userHasLoggedIn = it != _onlineUsers.end();
+    // Discard message if this client has not yet logged in.  The handle is
+    // checked each time, as a login message may have just set it.
+    user = _onlineUsers.find(session.user);
+    auto userHasLoggedIn = user != nullptr;
     if (!userHasLoggedIn && !isMessageAllowedBeforeLogin(msgCode)) {
       continue;
     }
 
     if (userHasLoggedIn) {
-      User &userRef = const_cast<User &>(*it);
-      user = &userRef;
       user->contact();
+
+      // Anything else the user does should follow the move that preceded it.
+      if (msgCode != CL_MOVE_TO && msgCode != CL_PING) applyPendingMove(*user);
     }
 
-    auto &iss = parser.iss;
     del = parser.getLastDelimiterRead();
 
     switch (msgCode) {
@@ -1503,6 +1559,7 @@ void Server::handleBufferedMessages(const Socket &client,
       SEND_MESSAGE_TO_HANDLER(CL_LOGIN_NEW)
       SEND_MESSAGE_TO_HANDLER(CL_FINISHED_RECEIVING_LOGIN_INFO)
       SEND_MESSAGE_TO_HANDLER(CL_REQUEST_TIME_PLAYED)
+      SEND_MESSAGE_TO_HANDLER(CL_REQUEST_DATAGRAM_CHANNEL)
       SEND_MESSAGE_TO_HANDLER(CL_SKIP_TUTORIAL)
       SEND_MESSAGE_TO_HANDLER(CL_MOVE_TO)
       SEND_MESSAGE_TO_HANDLER(CL_CANCEL_ACTION)
@@ -1556,8 +1613,7 @@ void Server::handleBufferedMessages(const Socket &client,
 
       case CL_PICK_UP_OBJECT_AS_ITEM: {
         Serial serial;
-        iss >> serial >> del;
-        if (del != MSG_END) return;
+        if (!parser.readArgs(serial)) return;
         if (user->isStunned()) {
           sendMessage(client, WARNING_STUNNED);
           break;
@@ -1594,14 +1650,9 @@ void Server::handleBufferedMessages(const Socket &client,
       case CL_SET_MERCHANT_SLOT: {
         Serial serial;
         size_t slot, wareQty, priceQty;
-        iss >> serial >> del >> slot >> del;
-        iss.get(_stringInputBuffer, BUFFER_SIZE, MSG_DELIM);
-        std::string ware(_stringInputBuffer);
-        iss >> del >> wareQty >> del;
-        iss.get(_stringInputBuffer, BUFFER_SIZE, MSG_DELIM);
-        std::string price(_stringInputBuffer);
-        iss >> del >> priceQty >> del;
-        if (del != MSG_END) return;
+        std::string ware, price;
+        if (!parser.readArgs(serial, slot, ware, wareQty, price, priceQty))
+          return;
         Object *obj = _entities.find<Object>(serial);
         if (!isEntityInRange(client, *user, obj)) break;
         if (obj->isBeingBuilt()) BREAK_WITH(ERROR_UNDER_CONSTRUCTION)
@@ -1614,8 +1665,8 @@ void Server::handleBufferedMessages(const Socket &client,
         if (wareIt == _items.end()) BREAK_WITH(ERROR_INVALID_ITEM)
         auto priceIt = _items.find(price);
         if (priceIt == _items.end()) BREAK_WITH(ERROR_INVALID_ITEM)
-        MerchantSlot &mSlot = obj->merchantSlot(slot);
-        mSlot = MerchantSlot(&*wareIt, wareQty, &*priceIt, priceQty);
+        obj->setMerchantSlot(
+            slot, MerchantSlot(&*wareIt, wareQty, &*priceIt, priceQty));
 
         // Alert watchers
         obj->tellRelevantUsersAboutMerchantSlot(slot);
@@ -1625,8 +1676,7 @@ void Server::handleBufferedMessages(const Socket &client,
       case CL_CLEAR_MERCHANT_SLOT: {
         Serial serial;
         size_t slot;
-        iss >> serial >> del >> slot >> del;
-        if (del != MSG_END) return;
+        if (!parser.readArgs(serial, slot)) return;
         Object *obj = _entities.find<Object>(serial);
         if (!isEntityInRange(client, *user, obj)) break;
         if (obj->isBeingBuilt()) BREAK_WITH(ERROR_UNDER_CONSTRUCTION)
@@ -1635,7 +1685,7 @@ void Server::handleBufferedMessages(const Socket &client,
         size_t slots = obj->objType().merchantSlots();
         if (slots == 0) BREAK_WITH(ERROR_NOT_MERCHANT)
         if (slot >= slots) BREAK_WITH(ERROR_INVALID_MERCHANT_SLOT)
-        obj->merchantSlot(slot) = MerchantSlot();
+        obj->setMerchantSlot(slot, MerchantSlot());
 
         // Alert watchers
         obj->tellRelevantUsersAboutMerchantSlot(slot);
@@ -1644,8 +1694,7 @@ void Server::handleBufferedMessages(const Socket &client,
 
       case CL_REPAIR_OBJECT: {
         Serial serial;
-        iss >> serial >> del;
-        if (del != MSG_END) return;
+        if (!parser.readArgs(serial)) return;
 
         handle_CL_REPAIR_OBJECT(*user, serial);
         break;
@@ -1653,8 +1702,7 @@ void Server::handleBufferedMessages(const Socket &client,
 
       case CL_MOUNT: {
         Serial serial;
-        iss >> serial >> del;
-        if (del != MSG_END) return;
+        if (!parser.readArgs(serial)) return;
         if (user->isStunned()) BREAK_WITH(WARNING_STUNNED)
         Object *obj = _entities.find<Object>(serial);
         if (!isEntityInRange(client, *user, obj)) break;
@@ -1670,9 +1718,10 @@ void Server::handleBufferedMessages(const Socket &client,
         user->driving(v->serial());
         user->teleportTo(v->location());
         // Alert nearby users (including the new driver)
-        for (const User *u : findUsersInArea(user->location()))
+        forEachUserInArea(user->location(), [&](const User *u) {
           sendMessage(u->socket(),
                       {SV_VEHICLE_HAS_DRIVER, makeArgs(serial, user->name())});
+        });
 
         user->onTerrainListChange(v->allowedTerrain().id());
 
@@ -1704,9 +1753,10 @@ void Server::handleBufferedMessages(const Socket &client,
 
         v->driver("");
         user->driving({});
-        for (const User *u : findUsersInArea(user->location()))
+        forEachUserInArea(user->location(), [&](const User *u) {
           sendMessage(u->socket(), {SV_VEHICLE_WAS_UNMOUNTED,
                                     makeArgs(serial, user->name())});
+        });
 
         // Teleport him him, to avoid collision with the vehicle.
         user->teleportTo(dst);
@@ -1720,10 +1770,8 @@ void Server::handleBufferedMessages(const Socket &client,
       case CL_SUE_FOR_PEACE_WITH_CITY:
       case CL_SUE_FOR_PEACE_WITH_PLAYER_AS_CITY:
       case CL_SUE_FOR_PEACE_WITH_CITY_AS_CITY: {
-        iss.get(_stringInputBuffer, BUFFER_SIZE, MSG_END);
-        auto name = std::string{_stringInputBuffer};
-        iss >> del;
-        if (del != MSG_END) return;
+        auto name = std::string{};
+        if (!parser.readArgs(name)) return;
         handle_CL_SUE_FOR_PEACE(*user, static_cast<MessageCode>(msgCode), name);
         break;
       }
@@ -1732,10 +1780,8 @@ void Server::handleBufferedMessages(const Socket &client,
       case CL_CANCEL_PEACE_OFFER_TO_CITY:
       case CL_CANCEL_PEACE_OFFER_TO_PLAYER_AS_CITY:
       case CL_CANCEL_PEACE_OFFER_TO_CITY_AS_CITY: {
-        iss.get(_stringInputBuffer, BUFFER_SIZE, MSG_END);
-        auto name = std::string{_stringInputBuffer};
-        iss >> del;
-        if (del != MSG_END) return;
+        auto name = std::string{};
+        if (!parser.readArgs(name)) return;
         handle_CL_CANCEL_PEACE_OFFER(*user, static_cast<MessageCode>(msgCode),
                                      name);
         break;
@@ -1745,10 +1791,8 @@ void Server::handleBufferedMessages(const Socket &client,
       case CL_ACCEPT_PEACE_OFFER_WITH_CITY:
       case CL_ACCEPT_PEACE_OFFER_WITH_PLAYER_AS_CITY:
       case CL_ACCEPT_PEACE_OFFER_WITH_CITY_AS_CITY: {
-        iss.get(_stringInputBuffer, BUFFER_SIZE, MSG_END);
-        auto name = std::string{_stringInputBuffer};
-        iss >> del;
-        if (del != MSG_END) return;
+        auto name = std::string{};
+        if (!parser.readArgs(name)) return;
         handle_CL_ACCEPT_PEACE_OFFER(*user, static_cast<MessageCode>(msgCode),
                                      name);
         break;
@@ -1767,14 +1811,9 @@ void Server::handleBufferedMessages(const Socket &client,
       }
 
       case CL_ACCEPT_QUEST: {
-        iss.get(_stringInputBuffer, BUFFER_SIZE, MSG_DELIM);
-        auto questID = Quest::ID{_stringInputBuffer};
-        iss >> del;
-
+        auto questID = Quest::ID{};
         auto startSerial = Serial{};
-        iss >> startSerial >> del;
-
-        if (del != MSG_END) return;
+        if (!parser.readArgs(questID, startSerial)) return;
 
         handle_CL_ACCEPT_QUEST(*user, questID, startSerial);
         break;
@@ -1783,10 +1822,7 @@ void Server::handleBufferedMessages(const Socket &client,
       case CL_HOTBAR_BUTTON: {
         auto slot = 0, category = 0;
         auto id = ""s;
-        iss >> slot >> del >> category >> del;
-        iss.get(_stringInputBuffer, BUFFER_SIZE, MSG_END);
-        id = _stringInputBuffer;
-        iss >> del;
+        if (!parser.readArgs(slot, category, id)) break;
         user->setHotbarAction(slot, category, id);
         break;
       }
@@ -1796,10 +1832,8 @@ void Server::handleBufferedMessages(const Socket &client,
         break;
 
       case CL_SAY: {
-        iss.get(_stringInputBuffer, BUFFER_SIZE, MSG_END);
-        std::string message(_stringInputBuffer);
-        iss >> del;
-        if (del != MSG_END) return;
+        std::string message;
+        if (!parser.readArgs(message)) return;
         broadcast({SV_SAY, makeArgs(user->name(), message)});
 
         auto fs = std::ofstream{"chat.log", std::ios_base::app};
@@ -1809,13 +1843,8 @@ void Server::handleBufferedMessages(const Socket &client,
       }
 
       case CL_WHISPER: {
-        iss.get(_stringInputBuffer, BUFFER_SIZE, MSG_DELIM);
-        std::string username(_stringInputBuffer);
-        iss >> del;
-        iss.get(_stringInputBuffer, BUFFER_SIZE, MSG_END);
-        std::string message(_stringInputBuffer);
-        iss >> del;
-        if (del != MSG_END) return;
+        std::string username, message;
+        if (!parser.readArgs(username, message)) return;
         auto it = _onlineUsersByName.find(username);
         if (it == _onlineUsersByName.end()) BREAK_WITH(ERROR_INVALID_USER)
         const User *target = it->second;
@@ -1830,10 +1859,8 @@ void Server::handleBufferedMessages(const Socket &client,
 
       case DG_GIVE: {
         if (!isDebug()) break;
-        iss.get(_stringInputBuffer, BUFFER_SIZE, MSG_END);
-        std::string id(_stringInputBuffer);
-        iss >> del;
-        if (del != MSG_END) return;
+        std::string id;
+        if (!parser.readArgs(id)) return;
         const auto it = _items.find(id);
         if (it == _items.end()) BREAK_WITH(ERROR_INVALID_ITEM)
         const ServerItem &item = *it;
@@ -1852,8 +1879,7 @@ void Server::handleBufferedMessages(const Socket &client,
 
       case DG_TELEPORT: {
         double x, y;
-        iss >> x >> del >> y >> del;
-        if (del != MSG_END) return;
+        if (!parser.readArgs(x, y)) return;
         if (!isDebug()) break;
 
         user->teleportTo({x, y});
@@ -1880,12 +1906,48 @@ void Server::handleBufferedMessages(const Socket &client,
       }
 
       default:
-        _debug << Color::CHAT_ERROR << "Unhandled message: " << messages
+        _debug << Color::CHAT_ERROR << "Unhandled message: " << msgCode
                << Log::endl;
     }
   }
 }
 
+void Server::handleDatagram(const std::string &datagram,
+                            const sockaddr_in &sender) {
+  const auto *cursor = datagram.data();
+  const auto *end = cursor + datagram.size();
+  auto header = DatagramHeader{};
+  if (!header.readFrom(cursor, end)) return;
+
+  auto tokenIt = _usersByDatagramToken.find(header.token);
+  if (tokenIt == _usersByDatagramToken.end()) return;
+  auto userIt = _onlineUsersByName.find(tokenIt->second);
+  if (userIt == _onlineUsersByName.end()) return;
+  auto &user = const_cast<User &>(*userIt->second);
+
+  // The network thread has already checked the sender, and dropped anything
+  // else, or over the user's rate limit.
+  auto &peer = _datagramPeers[user.name()];
+  const auto isStale =
+      peer.hasAddress &&
+      !DatagramHeader::isNewer(header.sequence, peer.lastSequenceReceived);
+  if (isStale) return;
+  peer.hasAddress = true;
+  peer.address = sender;  // Which may change, e.g. behind NAT
+  peer.lastSequenceReceived = header.sequence;
+
+  const auto isSupersededByTcpMove =
+      peer.hasMovedByTcp &&
+      !DatagramHeader::isNewer(header.sequence, peer.lastSequenceBeforeTcpMove);
+  if (isSupersededByTcpMove) return;
+
+  auto parser = MessageParser{cursor, static_cast<size_t>(end - cursor)};
+  while (parser.hasAnotherMessage()) {
+    if (parser.nextMessage() != CL_MOVE_TO) continue;
+    handleMessage<CL_MOVE_TO>(user.socket(), user, parser);
+  }
+}
+
 // TODO: remove
 #undef RETURN_WITH
 #define RETURN_WITH(MSG)   \
@@ -2124,13 +2186,15 @@ void Server::handle_CL_ACCEPT_QUEST(User &user, const Quest::ID &questID,
 }
 
 void Server::broadcast(const Message &msg) {
-  for (const User &user : _onlineUsers) sendMessage(user.socket(), msg);
+  const auto shared = SharedMessage::From(msg);
+  for (const User &user : _onlineUsers) sendMessage(user.socket(), shared);
 }
 
 void Server::broadcastToArea(const MapPoint &location,
                              const Message &msg) const {
-  for (const User *user : this->findUsersInArea(location))
-    user->sendMessage(msg);
+  const auto shared = SharedMessage::From(msg);
+  forEachUserInArea(location,
+                    [&shared](const User *user) { user->sendMessage(shared); });
 }
 
 void Server::broadcastToCity(const std::string &cityName,
@@ -2140,20 +2204,35 @@ void Server::broadcastToCity(const std::string &cityName,
     return;
   }
 
-  for (const auto &citizen : _cities.membersOf(cityName))
-    sendMessageIfOnline(citizen, msg);
+  const auto shared = SharedMessage::From(msg);
+  for (const auto &citizen : _cities.membersOf(cityName)) {
+    auto it = _onlineUsersByName.find(citizen);
+    if (it != _onlineUsersByName.end()) it->second->sendMessage(shared);
+  }
 }
 
 void Server::broadcastToGroup(Username aMember, const Message &msg) {
+  const auto shared = SharedMessage::From(msg);
   auto group = groups->getUsersGroup(aMember);
   for (auto memberName : group) {
     auto *asUser = getUserByName(memberName);
-    asUser->sendMessage(msg);
+    asUser->sendMessage(shared);
   }
 }
 
 void Server::sendMessage(const Socket &dstSocket, const Message &msg) const {
-  _socket.sendMessage(msg, dstSocket);
+  if (_socket.sendMessage(msg, dstSocket)) flushSoon(dstSocket);
+}
+
+void Server::sendMessage(const Socket &dstSocket,
+                         const SharedMessage &msg) const {
+  if (_socket.sendMessage(msg, dstSocket)) flushSoon(dstSocket);
+}
+
+void Server::flushSoon(const Socket &socket) const {
+  if (!_network) return;
+  _network->flushSoon(socket);
+  _network->wakeUp();
 }
 
 void Server::sendMessageIfOnline(const std::string username,
@@ -2169,14 +2248,131 @@ void Server::sendInventoryMessageInner(
   if (slot >= itemVect.size()) RETURN_WITH(ERROR_INVALID_SLOT)
 
   const auto &containerSlot = itemVect[slot];
-  std::string itemID =
-      containerSlot.hasItem() ? containerSlot.type()->id() : "none";
-  auto msg = Message{
-      SV_INVENTORY,
-      makeArgs(serial, slot, itemID, containerSlot.quantity(),
-               containerSlot.health(), containerSlot.isSoulbound() ? 1 : 0,
-               containerSlot.suffix())};
-  sendMessage(user.socket(), msg);
+  auto contents = SlotContents{};
+  contents.id = containerSlot.hasItem() ? containerSlot.type()->id() : "none";
+  contents.quantity = containerSlot.quantity();
+  contents.health = containerSlot.health();
+  contents.isSoulbound = containerSlot.isSoulbound();
+  contents.suffix = containerSlot.suffix();
+
+  // A later change to the same slot this tick replaces this one.
+  std::lock_guard<std::mutex> lock(_inventoryChangesMutex);
+  _inventoryChanges[user.name()][serial][slot] = std::move(contents);
+}
+
+void Server::sendInventoryChanges() {
+  auto changes = decltype(_inventoryChanges){};
+  {
+    std::lock_guard<std::mutex> lock(_inventoryChangesMutex);
+    changes.swap(_inventoryChanges);
+  }
+
+  for (const auto &byRecipient : changes) {
+    auto it = _onlineUsersByName.find(byRecipient.first);
+    if (it == _onlineUsersByName.end()) continue;  // Has since logged out
+    const auto &recipient = *it->second;
+
+    for (const auto &byContainer : byRecipient.second) {
+      auto message = MessageSchema<SV_INVENTORY>::Builder{byContainer.first};
+      for (const auto &slot : byContainer.second) {
+        const auto &contents = slot.second;
+        message.add(slot.first, contents.id, contents.quantity,
+                    contents.health, contents.isSoulbound ? 1 : 0,
+                    contents.suffix);
+      }
+      recipient.sendMessage(message.build());
+    }
+  }
+}
+
+void Server::onVitalsChanged(const Entity &entity) const {
+  std::lock_guard<std::mutex> lock(_vitalsMutex);
+  if (entity.classTag() == 'u')
+    _usersWithChangedVitals.insert(dynamic_cast<const User &>(entity).name());
+  else
+    _entitiesWithChangedVitals.insert(entity.serial());
+}
+
+void Server::forgetVitalsSentTo(const User &observer,
+                                const Entity &entity) const {
+  std::lock_guard<std::mutex> lock(_vitalsMutex);
+  auto it = _vitalsSent.find(observer.name());
+  if (it != _vitalsSent.end()) it->second.erase(entity.serial());
+}
+
+void Server::forgetVitalsOf(const Entity &entity) const {
+  std::lock_guard<std::mutex> lock(_vitalsMutex);
+  for (auto &sentToObserver : _vitalsSent)
+    sentToObserver.second.erase(entity.serial());
+  if (entity.classTag() == 'u')
+    _vitalsSent.erase(dynamic_cast<const User &>(entity).name());
+}
+
+void Server::sendVitalsChanges() {
+  auto entities = std::set<Serial>{};
+  auto users = std::set<std::string>{};
+  {
+    std::lock_guard<std::mutex> lock(_vitalsMutex);
+    entities.swap(_entitiesWithChangedVitals);
+    users.swap(_usersWithChangedVitals);
+  }
+
+  // Anything that has since been removed is skipped.
+  for (auto serial : entities) {
+    const auto *entity = _entities.find(serial);
+    if (!entity) continue;
+    for (const User *observer : _interest.observersOf(*entity))
+      sendVitalsChange(*observer, *entity);
+  }
+
+  for (const auto &username : users) {
+    auto it = _onlineUsersByName.find(username);
+    if (it == _onlineUsersByName.end()) continue;
+    const auto &user = *it->second;
+    sendVitalsChange(user, user);
+    for (const User *observer : _interest.observersOf(user))
+      sendVitalsChange(*observer, user);
+    user.sendStatsIfChanged();
+  }
+}
+
+void Server::sendVitalsChange(const User &observer, const Entity &entity) {
+  const auto current =
+      Vitals{entity.health(), entity.stats().maxHealth, entity.energy(),
+             entity.stats().maxEnergy};
+  auto previous = Vitals{};
+  auto wasKnown = false;
+  {
+    std::lock_guard<std::mutex> lock(_vitalsMutex);
+    auto &sentToObserver = _vitalsSent[observer.name()];
+    auto it = sentToObserver.find(entity.serial());
+    wasKnown = it != sentToObserver.end();
+    if (wasKnown) previous = it->second;
+    sentToObserver[entity.serial()] = current;
+  }
+
+  if (entity.classTag() != 'u') {
+    if (!wasKnown || current.health != previous.health)
+      observer.sendMessage(MessageSchema<SV_ENTITY_HEALTH>::build(
+          entity.serial(), current.health));
+    if (!wasKnown || current.energy != previous.energy)
+      observer.sendMessage(MessageSchema<SV_ENTITY_ENERGY>::build(
+          entity.serial(), current.energy));
+    return;
+  }
+
+  auto vitals = MessageSchema<SV_PLAYER_VITALS>::Builder{
+      dynamic_cast<const User &>(entity).name()};
+  const auto addIfChanged = [&](MessageCode code, unsigned value,
+                                unsigned previousValue) {
+    if (wasKnown && value == previousValue) return;
+    vitals.add(code, value);
+  };
+  addIfChanged(SV_PLAYER_HEALTH, current.health, previous.health);
+  addIfChanged(SV_PLAYER_ENERGY, current.energy, previous.energy);
+  addIfChanged(SV_MAX_HEALTH, current.maxHealth, previous.maxHealth);
+  addIfChanged(SV_MAX_ENERGY, current.maxEnergy, previous.maxEnergy);
+  if (vitals.numGroups() > 0) observer.sendMessage(vitals.build());
 }
 
 void Server::sendInventoryMessage(const User &user, size_t slot,
@@ -2211,16 +2407,7 @@ void Server::sendMerchantSlotMessage(const User &user, const Object &obj,
     SERVER_ERROR("Can't send merchant-slot message: slot index is too high");
     return;
   }
-  const MerchantSlot &mSlot = obj.merchantSlot(slot);
-  if (mSlot)
-    sendMessage(
-        user.socket(),
-        {SV_MERCHANT_SLOT,
-         makeArgs(obj.serial(), slot, mSlot.wareItem->id(), mSlot.wareQty,
-                  mSlot.priceItem->id(), mSlot.priceQty)});
-  else
-    sendMessage(user.socket(),
-                {SV_MERCHANT_SLOT, makeArgs(obj.serial(), slot, "", 0, "", 0)});
+  sendMessage(user.socket(), obj.merchantSlotMessage(slot));
 }
 
 void Server::sendConstructionMaterialsMessage(const User &user,
@@ -2274,23 +2461,7 @@ void Server::sendRelevantEntitiesToUser(const User &user) {
       entitiesToDescribe;  // Multiple sources; a set ensures no duplicates.
 
   // (Nearby)
-  const MapPoint &loc = user.location();
-  auto loX =
-      _entitiesByX.lower_bound(&Dummy::Location(loc.x - CULL_DISTANCE, 0));
-  auto hiX =
-      _entitiesByX.upper_bound(&Dummy::Location(loc.x + CULL_DISTANCE, 0));
-  for (auto it = loX; it != hiX; ++it) {
-    const Entity *entity = *it;
-    if (entity == &user) continue;
-    if (abs(entity->location().y - loc.y) > CULL_DISTANCE)  // Cull y
-      continue;
-    const auto *asObj = dynamic_cast<const Object *>(entity);
-
-    // If owned, it will get picked up in the next section.
-    if (asObj && asObj->objType().isHidden()) continue;
-
-    entitiesToDescribe.insert(entity);
-  }
+  _interest.onMoved(user);
 
   // (Owned objects)
   for (auto pEntity : _entities) {
@@ -2325,6 +2496,7 @@ void Server::sendRelevantEntitiesToUser(const User &user) {
       _debug("Null-type object skipped", Color::CHAT_ERROR);
       continue;
     }
+    if (_interest.isVisibleTo(user, *entity)) continue;  // Already sent
     if (entity->shouldBePropagatedToClients()) entity->sendInfoToClient(user);
   }
 }
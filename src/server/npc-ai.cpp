@@ -11,13 +11,14 @@ void NPC::getNewTargetsFromProximity(ms_t timeElapsed) {
   _timeSinceLookedForTargets =
       _timeSinceLookedForTargets % AI::FREQUENCY_TO_LOOK_FOR_TARGETS;
 
-  auto entitiesInRange =
-      Server::_instance->findEntitiesInArea(location(), AI::AGGRO_RANGE);
-  for (auto *potentialTarget : entitiesInRange) {
-    if (potentialTarget == this) continue;
-    if (!potentialTarget->canBeAttackedBy(*this)) continue;
-    if (potentialTarget->shouldBeIgnoredByAIProximityAggro()) continue;
-    if (distance(*this, *potentialTarget) > AI::AGGRO_RANGE) continue;
-    makeAwareOf(*potentialTarget);
-  }
+  Server::_instance->forEachEntityInArea(
+      location(),
+      [this](Entity *potentialTarget) {
+        if (potentialTarget == this) return;
+        if (!potentialTarget->canBeAttackedBy(*this)) return;
+        if (potentialTarget->shouldBeIgnoredByAIProximityAggro()) return;
+        if (distance(*this, *potentialTarget) > AI::AGGRO_RANGE) return;
+        makeAwareOf(*potentialTarget);
+      },
+      AI::AGGRO_RANGE);
 }
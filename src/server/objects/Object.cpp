@@ -1,5 +1,6 @@
 #include "Object.h"
 
+#include "../../MessageSchema.h"
 #include "../../util.h"
 #include "../Server.h"
 #include "ObjectLoot.h"
@@ -43,18 +44,12 @@ void Object::update(ms_t timeElapsed) {
 }
 
 void Object::onHealthChange() {
-  const Server &server = *Server::_instance;
-  if (classTag() != 'u')
-    for (const User *user : server.findUsersInArea(location()))
-      user->sendMessage({SV_ENTITY_HEALTH, makeArgs(serial(), health())});
+  Server::_instance->onVitalsChanged(*this);
   Entity::onHealthChange();
 }
 
 void Object::onEnergyChange() {
-  const Server &server = *Server::_instance;
-  if (classTag() != 'u')
-    for (const User *user : server.findUsersInArea(location()))
-      user->sendMessage({SV_ENTITY_ENERGY, makeArgs(serial(), energy())});
+  Server::_instance->onVitalsChanged(*this);
   Entity::onEnergyChange();
 }
 
@@ -136,18 +131,32 @@ bool Object::canHaveCustomName() const {
   return false;
 }
 
+void Object::buildIntroduction(std::vector<SharedMessage> &messages) const {
+  messages.push_back(SharedMessage::From(
+      {SV_OBJECT_INFO,
+       makeArgs(serial(), location().x, location().y, type()->id())}));
+
+  // Owner
+  if (permissions.hasOwner()) {
+    const auto &owner = permissions.owner();
+    messages.push_back(SharedMessage::From(
+        {SV_OWNER, makeArgs(serial(), owner.typeString(), owner.name)}));
+  }
+
+  // Merchant slots
+  for (auto i = 0; i != _merchantSlots.size(); ++i)
+    messages.push_back(SharedMessage::From(merchantSlotMessage(i)));
+
+  Entity::buildIntroduction(messages);
+}
+
 void Object::sendInfoToClient(const User &targetUser, bool isNew) const {
   const Server &server = Server::instance();
 
-  targetUser.sendMessage(
-      {SV_OBJECT_INFO,
-       makeArgs(serial(), location().x, location().y, type()->id())});
+  Entity::sendInfoToClient(targetUser, isNew);
 
-  // Owner
   if (permissions.hasOwner()) {
     const auto &owner = permissions.owner();
-    targetUser.sendMessage(
-        {SV_OWNER, makeArgs(serial(), owner.typeString(), owner.name)});
 
     // In case the owner is unknown to the client, tell him the owner's city
     if (owner.type == owner.PLAYER) {
@@ -175,7 +184,8 @@ void Object::sendInfoToClient(const User &targetUser, bool isNew) const {
 
   // Hitpoints
   if (isMissingHealth())
-    targetUser.sendMessage({SV_ENTITY_HEALTH, makeArgs(serial(), health())});
+    targetUser.sendMessage(
+        MessageSchema<SV_ENTITY_HEALTH>::build(serial(), health()));
 
   // Lootable
   if (_loot != nullptr && !_loot->empty()) sendAllLootToTaggers();
@@ -185,10 +195,6 @@ void Object::sendInfoToClient(const User &targetUser, bool isNew) const {
     for (auto i = 0; i != objType().container().slots(); ++i)
       server.sendInventoryMessage(targetUser, i, *this);
 
-  // Merchant slots
-  for (auto i = 0; i != _merchantSlots.size(); ++i)
-    server.sendMerchantSlotMessage(targetUser, *this, i);
-
   // Buffs/debuffs
   for (const auto &buff : buffs())
     targetUser.sendMessage(
@@ -199,25 +205,35 @@ void Object::sendInfoToClient(const User &targetUser, bool isNew) const {
 
   // Quests
   QuestNode::sendQuestsToUser(targetUser);
-
-  Entity::sendInfoToClient(targetUser, isNew);
 }
 
 void Object::tellRelevantUsersAboutInventorySlot(size_t slot) const {
   const Server &server = Server::instance();
-  for (const auto *user : server.findUsersInArea(location())) {
-    if (!permissions.canUserAccessContainer(user->name())) continue;
+  server.forEachUserInArea(location(), [&](const User *user) {
+    if (!permissions.canUserAccessContainer(user->name())) return;
 
     server.sendInventoryMessage(*user, slot, *this);
-  }
+  });
+}
+
+Message Object::merchantSlotMessage(size_t slot) const {
+  const MerchantSlot &mSlot = _merchantSlots[slot];
+  if (!mSlot)
+    return {SV_MERCHANT_SLOT, makeArgs(serial(), slot, "", 0, "", 0)};
+  return {SV_MERCHANT_SLOT,
+          makeArgs(serial(), slot, mSlot.wareItem->id(), mSlot.wareQty,
+                   mSlot.priceItem->id(), mSlot.priceQty)};
 }
 
 void Object::tellRelevantUsersAboutMerchantSlot(size_t slot) const {
+  invalidateIntroduction();
+
   // All users are relevant; those with permissions can change the slots, and
   // those without can use them.
   const Server &server = Server::instance();
-  for (const auto *user : server.findUsersInArea(location()))
+  server.forEachUserInArea(location(), [&](const User *user) {
     server.sendMerchantSlotMessage(*user, *this, slot);
+  });
 }
 
 ServerItem::Instance *Object::getSlotToTakeFromAndSendErrors(size_t slotNum,
@@ -277,12 +293,12 @@ Message Object::outOfRangeMessage() const {
 
 void Object::broadcastDamagedMessage(Hitpoints amount) const {
   Server &server = *Server::_instance;
-  server.broadcastToArea(location(),
-                         {SV_OBJECT_DAMAGED, makeArgs(serial(), amount)});
+  server.broadcastToArea(
+      location(), MessageSchema<SV_OBJECT_DAMAGED>::build(serial(), amount));
 }
 
 void Object::broadcastHealedMessage(Hitpoints amount) const {
   Server &server = *Server::_instance;
-  server.broadcastToArea(location(),
-                         {SV_OBJECT_HEALED, makeArgs(serial(), amount)});
+  server.broadcastToArea(
+      location(), MessageSchema<SV_OBJECT_HEALED>::build(serial(), amount));
 }
@@ -47,7 +47,10 @@ class Object : public Entity, public QuestNode, public DamageOnUse {
   const MerchantSlot &merchantSlot(size_t slot) const {
     return _merchantSlots[slot];
   }
-  MerchantSlot &merchantSlot(size_t slot) { return _merchantSlots[slot]; }
+  void setMerchantSlot(size_t slot, const MerchantSlot &merchantSlot) {
+    _merchantSlots[slot] = merchantSlot;
+    invalidateIntroduction();
+  }
   bool isBeingBuilt() const {
     return !_remainingMaterials.isEmpty() && !isDead();
   }
@@ -89,8 +92,10 @@ class Object : public Entity, public QuestNode, public DamageOnUse {
 
   void sendInfoToClient(const User &targetUser,
                         bool isNew = false) const override;
+  void buildIntroduction(std::vector<SharedMessage> &messages) const override;
   void tellRelevantUsersAboutInventorySlot(size_t slot) const;
   void tellRelevantUsersAboutMerchantSlot(size_t slot) const;
+  Message merchantSlotMessage(size_t slot) const;
   ServerItem::Instance *getSlotToTakeFromAndSendErrors(
       size_t slotNum, const User &user) override;
   bool areOverlapsAllowedWith(const Entity &rhs) const override;
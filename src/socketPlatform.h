@@ -0,0 +1,68 @@
+#pragma once
+
+// Platform-specific socket headers and types, so that the rest of the code can
+// use a single set of names whether it's built against Winsock or BSD sockets.
+
+#ifdef _WIN32
+
+#include <windows.h>
+
+using SockAddrLength = int;
+const int SOCKET_SEND_FLAGS = 0;
+
+inline int lastSocketError() { return WSAGetLastError(); }
+inline void closeRawSocket(SOCKET s) { closesocket(s); }
+inline bool wasSocketErrorWouldBlock(int error) {
+  return error == WSAEWOULDBLOCK;
+}
+inline size_t bytesWaitingToBeRead(SOCKET s) {
+  auto bytesWaiting = u_long{0};
+  if (ioctlsocket(s, FIONREAD, &bytesWaiting) == SOCKET_ERROR) return 0;
+  return bytesWaiting;
+}
+inline void allowAddressReuse(SOCKET) {}
+inline void makeSocketNonBlocking(SOCKET s) {
+  auto nonBlocking = u_long{1};
+  ioctlsocket(s, FIONBIO, &nonBlocking);
+}
+
+#else
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+using SOCKET = int;
+const SOCKET INVALID_SOCKET = -1;
+const int SOCKET_ERROR = -1;
+using SockAddrLength = socklen_t;
+using u_short = unsigned short;
+// A dropped connection should be reported by send(), not kill the process.
+const int SOCKET_SEND_FLAGS = MSG_NOSIGNAL;
+
+inline int lastSocketError() { return errno; }
+inline void closeRawSocket(SOCKET s) { ::close(s); }
+inline bool wasSocketErrorWouldBlock(int error) {
+  return error == EWOULDBLOCK || error == EAGAIN;
+}
+inline size_t bytesWaitingToBeRead(SOCKET s) {
+  auto bytesWaiting = int{0};
+  if (ioctl(s, FIONREAD, &bytesWaiting) == SOCKET_ERROR) return 0;
+  return static_cast<size_t>(bytesWaiting);
+}
+inline void allowAddressReuse(SOCKET s) {
+  auto yes = int{1};
+  setsockopt(s, SOL_SOCKET, SO_REUSEADDR, &yes, sizeof(yes));
+}
+inline void makeSocketNonBlocking(SOCKET s) {
+  auto flags = fcntl(s, F_GETFL, 0);
+  fcntl(s, F_SETFL, flags | O_NONBLOCK);
+}
+
+#endif
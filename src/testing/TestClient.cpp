@@ -1,5 +1,6 @@
 #include "TestClient.h"
 
+#include <algorithm>
 #include <cassert>
 #include <thread>
 
@@ -159,6 +160,12 @@ bool TestClient::waitForMessage(MessageCode desiredMsg, ms_t timeout) const {
   return false;
 }
 
+size_t TestClient::numMessagesReceived(MessageCode code) const {
+  std::lock_guard<std::mutex> guard(_client->_messagesReceivedMutex);
+  const auto &received = _client->_messagesReceived;
+  return std::count(received.begin(), received.end(), code);
+}
+
 bool TestClient::messageWasReceivedSince(MessageCode desiredMsg,
                                          size_t startingIndex) const {
   std::lock_guard<std::mutex> guard(_client->_messagesReceivedMutex);
@@ -101,6 +101,9 @@ class TestClient {
   const Connection::State connectionState() const {
     return _client->_connection.state();
   }
+  bool hasReceivedDatagram() const {
+    return _client->_connection.hasReceivedDatagram();
+  }
 
   Avatar &getFirstOtherUser();
   ClientNPC &getFirstNPC();
@@ -123,9 +126,19 @@ class TestClient {
   void sendMessage(MessageCode code, const std::string &args = "") const {
     _client->sendMessage({code, args});
   }
+  bool hasDatagramChannel() const {
+    return _client->_connection.hasDatagramChannel();
+  }
+  void sendByDatagram(MessageCode code, const std::string &args = "") const {
+    _client->_connection.sendByDatagram({code, args});
+  }
+  uint32_t lastDatagramSequenceSent() const {
+    return _client->_connection.lastDatagramSequenceSent();
+  }
   MessageCode getNextMessage() const;
   bool waitForMessage(MessageCode desiredMsg,
                       ms_t timeout = DEFAULT_TIMEOUT) const;
+  size_t numMessagesReceived(MessageCode code) const;
   void waitForRedraw();
   void simulateMouseMove(const ScreenPoint &position);
   void simulateClick(Uint8 button);
@@ -186,7 +186,7 @@ const BuffType &TestServer::findBuff(const std::string &id) const {
 
 User &TestServer::getFirstUser() {
   REQUIRE(!_server->_onlineUsers.empty());
-  return const_cast<User &>(*_server->_onlineUsers.begin());
+  return *_server->_onlineUsers.begin();
 }
 
 Object &TestServer::getFirstObject() {
@@ -28,10 +28,15 @@ class TestServer {
 
   std::set<const ObjectType *> &objectTypes() { return _server->_objectTypes; }
   Entities &entities() { return _server->_entities; }
-  Entity::byX_t &entitiesByX() { return _server->_entitiesByX; }
+  SpatialGrid<Entity> &entitiesByLocation() {
+    return _server->_entitiesByLocation;
+  }
   std::set<ServerItem> &items() { return _server->_items; }
   const std::set<ServerItem> &items() const { return _server->_items; }
-  std::set<User> &users() { return _server->_onlineUsers; }
+  Server::OnlineUsers &users() { return _server->_onlineUsers; }
+  size_t messagesDroppedByRateLimit(RateLimiter::Category category) const {
+    return _server->_network->messagesDroppedByRateLimit(category);
+  }
   std::vector<Spawner> &spawners() { return _server->_spawners; }
   Wars &wars() { return _server->_wars; }
   Cities &cities() { return _server->_cities; }
@@ -1,3 +1,5 @@
+#include "../LoginSnapshot.h"
+#include "../MessageParser.h"
 #include "TestClient.h"
 #include "TestFixtures.h"
 #include "TestServer.h"
@@ -36,7 +38,7 @@ TEST_CASE("Removed users are removed from co-ord indices", "[connection]") {
   s.waitForUsers(0);
 
   // Then that user is not represented in the x-indexed objects list
-  CHECK(s.entitiesByX().empty());
+  CHECK(s.entitiesByLocation().empty());
 }
 
 TEST_CASE("Server remains functional with unresponsive client",
@@ -172,3 +174,65 @@ TEST_CASE("The finished-loggin-in message", "[connection]") {
     CHECK(c.waitForMessage(SV_LOGIN_INFO_HAS_FINISHED));
   }
 }
+
+TEST_CASE("A returning user's state arrives in a single snapshot",
+          "[connection]") {
+  GIVEN("Alice has an item") {
+    const auto data = R"(
+      <item id="rock" stackSize="10" />
+    )";
+    auto s = TestServer::WithDataString(data);
+    {
+      auto c = TestClient::WithUsernameAndDataString("Alice", data);
+      s.waitForUsers(1);
+      s.getFirstUser().giveItem(&s.getFirstItem(), 3);
+    }
+
+    WHEN("she logs back in") {
+      auto c = TestClient::WithUsernameAndDataString("Alice", data);
+
+      THEN("she is sent a login snapshot") {
+        CHECK(c.waitForMessage(SV_LOGIN_SNAPSHOT));
+
+        AND_THEN("she has the item") {
+          WAIT_UNTIL(c.inventory()[0].second == 3);
+        }
+      }
+    }
+  }
+}
+
+TEST_CASE("Login snapshots survive being sent") {
+  GIVEN("a snapshot with an item, a quest and a partly explored map") {
+    auto snapshot = LoginSnapshot{};
+    snapshot.inventory.push_back({2, "rock", 3, 10, true, ""});
+    auto quest = LoginSnapshot::QuestState{};
+    quest.id = "fetchRocks";
+    quest.progress.push_back({0, 2});
+    snapshot.quests.push_back(quest);
+    auto map = LoginSnapshot::ExplorationMap(4, std::vector<bool>(3, false));
+    map[1][2] = map[2][0] = map[3][2] = true;
+    snapshot.exploration(map);
+
+    WHEN("it is compiled and read back") {
+      const auto compiled = snapshot.toMessage().compile();
+      auto parser = MessageParser{compiled.data(), compiled.size()};
+      REQUIRE(parser.hasAnotherMessage());
+      REQUIRE(parser.nextMessage() == SV_LOGIN_SNAPSHOT);
+      auto received = LoginSnapshot{};
+      REQUIRE(received.readFrom(parser));
+
+      THEN("the contents are unchanged") {
+        REQUIRE(received.inventory.size() == 1);
+        CHECK(received.inventory[0].slot == 2);
+        CHECK(received.inventory[0].id == "rock");
+        CHECK(received.inventory[0].quantity == 3);
+        CHECK(received.inventory[0].isSoulbound);
+        CHECK(received.inventory[0].suffix.empty());
+        REQUIRE(received.quests.size() == 1);
+        CHECK(received.quests[0].progress.size() == 1);
+        CHECK(received.exploration() == map);
+      }
+    }
+  }
+}
@@ -87,7 +87,7 @@ TEST_CASE("Merchant can use same slot for ware and price",
     auto &store = s.getFirstObject();
     const auto *diamond = s->findItem("diamond");
     const auto *coin = s->findItem("coin");
-    store.merchantSlot(0) = {diamond, 1, coin, 1};
+    store.setMerchantSlot(0, {diamond, 1, coin, 1});
     store.container().addItems(diamond);
 
     WHEN("a user with the price tries to buy the ware") {
@@ -432,3 +432,26 @@ TEST_CASE_METHOD(ServerAndClientWithData,
     }
   }
 }
+
+TEST_CASE_METHOD(ServerAndClientWithData,
+                 "Changes to several slots are sent together", "[containers]") {
+  GIVEN("an item that doesn't stack") {
+    useData(R"(
+      <item id="rock" />
+    )");
+
+    WHEN("the user is given three at once") {
+      const auto messagesBefore = client->numMessagesReceived(SV_INVENTORY);
+      user->giveItem(&server->getFirstItem(), 3);
+
+      THEN("the client knows about all three") {
+        WAIT_UNTIL(client->inventory()[2].second == 1);
+
+        AND_THEN("they weren't sent one at a time") {
+          const auto messagesAfter = client->numMessagesReceived(SV_INVENTORY);
+          CHECK(messagesAfter - messagesBefore < 3);
+        }
+      }
+    }
+  }
+}
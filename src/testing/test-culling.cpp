@@ -181,6 +181,41 @@ TEST_CASE("Unwatching NPCs", "[.flaky]") {
   }
 }
 
+TEST_CASE("Objects are forgotten and rediscovered as users move") {
+  GIVEN("a user who is aware of a nearby signpost") {
+    auto s = TestServer::WithData("signpost");
+    auto c = TestClient::WithData("signpost");
+    s.addObject("signpost", {10, 15});
+    s.waitForUsers(1);
+    WAIT_UNTIL(c.objects().size() == 1);
+    auto &user = s.getFirstUser();
+
+    WHEN("he teleports just beyond the cull distance") {
+      user.teleportTo({10.0 + Server::CULL_DISTANCE + 10, 15});
+
+      THEN("he is not yet told that it is out of range") {
+        CHECK_FALSE(c.waitForMessage(SV_OBJECT_OUT_OF_RANGE));
+      }
+    }
+
+    WHEN("he teleports far away") {
+      user.teleportTo({1000, 15});
+
+      THEN("he is told that it is out of range") {
+        CHECK(c.waitForMessage(SV_OBJECT_OUT_OF_RANGE));
+
+        AND_WHEN("he teleports back") {
+          user.teleportTo({10, 10});
+
+          THEN("he finds out about it again") {
+            WAIT_UNTIL(c.objects().size() == 1);
+          }
+        }
+      }
+    }
+  }
+}
+
 TEST_CASE("Out-of-range objects are forgotten", "[.slow]") {
   // Given a server and client with signpost objects;
   TestServer s = TestServer::WithData("signpost");
@@ -203,3 +238,27 @@ TEST_CASE("Out-of-range objects are forgotten", "[.slow]") {
   }
   CHECK(c.objects().size() == 0);
 }
+
+TEST_CASE("Entities are found where they have moved to") {
+  GIVEN("a signpost") {
+    auto s = TestServer::WithData("signpost");
+    auto &signpost = s.addObject("signpost", {10, 15});
+
+    WHEN("it is moved a long way") {
+      signpost.location({3000, 3000});
+
+      THEN("it is found only around its new location") {
+        CHECK(s->findEntitiesInArea({10, 15}).count(&signpost) == 0);
+        CHECK(s->findEntitiesInArea({3000, 3000}).count(&signpost) == 1);
+      }
+    }
+
+    WHEN("it is moved a little, within the same area") {
+      signpost.location({12, 15});
+
+      THEN("it is found there") {
+        CHECK(s->findEntitiesInArea({12, 15}, 1).count(&signpost) == 1);
+      }
+    }
+  }
+}
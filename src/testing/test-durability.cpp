@@ -861,7 +861,7 @@ TEST_CASE_METHOD(ServerAndClientWithData, "Broken items can't be traded",
     const auto *apple = &server->findItem("apple");
     auto &appleCart =
         server->addObject("appleCart", {10, 15}, "someOtherOwner");
-    appleCart.merchantSlot(0) = {apple, 1, coin, 1};
+    appleCart.setMerchantSlot(0, {apple, 1, coin, 1});
     appleCart.container().addItems(apple);
 
     user->giveItem(coin);
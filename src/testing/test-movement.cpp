@@ -3,6 +3,8 @@
 #include "TestServer.h"
 #include "testing.h"
 
+extern Args cmdLineArgs;
+
 TEST_CASE("Thin objects block movement") {
   // Given a server and client;
   auto s = TestServer::WithData("thin_wall");
@@ -149,6 +151,35 @@ TEST_CASE("Pets walking through gates") {
   }
 }
 
+TEST_CASE("Objects straddling collision chunks block both sides") {
+  GIVEN("a wall on the boundary between two collision chunks") {
+    auto s = TestServer::WithDataString(R"(
+      <terrain index="." id="grass" />
+      <list id="default" default="1" >
+        <allow id="grass" />
+      </list>
+      <size x="30" y="2" />
+      <row y= "0" terrain = ".............................." />
+      <row y= "1" terrain = ".............................." />
+      <objectType id="wall">
+        <collisionRect x="-5" y="-5" w="10" h="10" />
+      </objectType>
+    )");
+    const auto &wall = *s->findObjectTypeByID("wall");
+    s.addObject("wall", {480, 30});
+
+    THEN("another can't be put just to either side of it") {
+      CHECK_FALSE(s->isLocationValid({474, 30}, wall));
+      CHECK_FALSE(s->isLocationValid({486, 30}, wall));
+    }
+
+    THEN("another can be put a little further away, or across the map") {
+      CHECK(s->isLocationValid({500, 30}, wall));
+      CHECK(s->isLocationValid({900, 30}, wall));
+    }
+  }
+}
+
 TEST_CASE_METHOD(ServerAndClientWithData, "Boat-on-land glitch") {
   GIVEN("a vehicle on forbidden terrain") {
     useData(R"(
@@ -181,3 +212,205 @@ TEST_CASE_METHOD(ServerAndClientWithData, "Boat-on-land glitch") {
     }
   }
 }
+
+TEST_CASE("Movement can be sent in fixed-rate snapshots") {
+  GIVEN("a server that sends movement 20 times per second") {
+    cmdLineArgs.add("snapshot-rate", "20");
+    auto s = TestServer{};
+    cmdLineArgs.remove("snapshot-rate");
+
+    AND_GIVEN("Bob can see Alice") {
+      auto cAlice = TestClient::WithUsername("Alice");
+      auto cBob = TestClient::WithUsername("Bob");
+      s.waitForUsers(2);
+      WAIT_UNTIL(cBob.otherUsers().size() == 1);
+      const auto &aliceAsSeenByBob = cBob.getFirstOtherUser();
+      const auto originalX = aliceAsSeenByBob.location().x;
+
+      WHEN("Alice moves") {
+        const auto &alice = s.findUser("Alice");
+        const auto destination = alice.location() + MapPoint{10, 0};
+        cAlice.sendMessage(CL_MOVE_TO, makeArgs(destination.x, destination.y));
+
+        THEN("Bob sees her move") {
+          WAIT_UNTIL(aliceAsSeenByBob.location().x > originalX);
+        }
+      }
+    }
+  }
+}
+
+TEST_CASE_METHOD(ServerAndClientWithData,
+                 "Snapshots send the nearest movers first, within a budget") {
+  GIVEN("snapshots once a second, with room for one mover in each") {
+    cmdLineArgs.add("snapshot-rate", "1");
+    cmdLineArgs.add("snapshot-budget", "1");
+    useData(R"(
+      <newPlayerSpawn x="10" y="10" range="0" />
+      <terrain index="." id="grass" />
+      <list id="default" default="1" >
+        <allow id="grass" />
+      </list>
+      <size x="30" y="2" />
+      <row y= "0" terrain = ".............................." />
+      <row y= "1" terrain = ".............................." />
+      <npcType id="rabbit" maxHealth="1" speed="100" >
+        <collisionRect x="-2" y="-2" w="4" h="4" />
+      </npcType>
+    )");
+    cmdLineArgs.remove("snapshot-rate");
+    cmdLineArgs.remove("snapshot-budget");
+
+    AND_GIVEN("a rabbit near the user, and another further away") {
+      auto &nearRabbit = server->addNPC("rabbit", {40, 30});
+      auto &farRabbit = server->addNPC("rabbit", {300, 30});
+      WAIT_UNTIL(client->objects().size() == 2);
+      const auto &nearAsSeen = *client->objects()[nearRabbit.serial()];
+      const auto &farAsSeen = *client->objects()[farRabbit.serial()];
+      const auto nearX = nearAsSeen.location().x,
+                 farX = farAsSeen.location().x;
+
+      WHEN("both move at once") {
+        SDL_Delay(200);  // So that they are allowed to move
+        farRabbit.moveLegallyTowards(farRabbit.location() + MapPoint{5, 0});
+        nearRabbit.moveLegallyTowards(nearRabbit.location() + MapPoint{5, 0});
+
+        THEN("the user sees the nearer one move first") {
+          WAIT_UNTIL(nearAsSeen.location().x > nearX);
+          CHECK(farAsSeen.location().x == farX);
+
+          AND_THEN("the further one in the next snapshot") {
+            WAIT_UNTIL(farAsSeen.location().x > farX);
+          }
+        }
+      }
+    }
+  }
+}
+
+TEST_CASE("Movement can be received by datagram") {
+  GIVEN("Bob has asked for a datagram channel, and can see Alice") {
+    auto s = TestServer{};
+    auto cAlice = TestClient::WithUsername("Alice");
+    cmdLineArgs.add("datagram-channel");
+    auto cBob = TestClient::WithUsername("Bob");
+    cmdLineArgs.remove("datagram-channel");
+    s.waitForUsers(2);
+    WAIT_UNTIL(cBob.otherUsers().size() == 1);
+    const auto &aliceAsSeenByBob = cBob.getFirstOtherUser();
+    const auto originalX = aliceAsSeenByBob.location().x;
+
+    WHEN("Alice moves") {
+      const auto &alice = s.findUser("Alice");
+      const auto destination = alice.location() + MapPoint{10, 0};
+      cAlice.sendMessage(CL_MOVE_TO, makeArgs(destination.x, destination.y));
+
+      THEN("Bob sees her move") {
+        WAIT_UNTIL(aliceAsSeenByBob.location().x > originalX);
+
+        AND_THEN("it arrived by datagram") {
+          WAIT_UNTIL(cBob.hasReceivedDatagram());
+        }
+      }
+    }
+  }
+}
+
+TEST_CASE("A move by datagram is ignored if a later one came by TCP") {
+  GIVEN("Alice has a datagram channel") {
+    auto s = TestServer{};
+    cmdLineArgs.add("datagram-channel");
+    auto c = TestClient::WithUsername("Alice");
+    cmdLineArgs.remove("datagram-channel");
+    s.waitForUsers(1);
+    WAIT_UNTIL(c.hasDatagramChannel());
+    const auto &alice = s.findUser("Alice");
+    const auto start = alice.location();
+    SDL_Delay(500);  // So that she is allowed to move
+
+    WHEN("she stops, confirming it by TCP, after a move sent by datagram") {
+      const auto stop = start + MapPoint{5, 0};
+      const auto datagramSentBeforeStopping = c.lastDatagramSequenceSent() + 1;
+      c.sendMessage(CL_MOVE_TO,
+                    makeArgs(stop.x, stop.y, datagramSentBeforeStopping));
+      WAIT_UNTIL(distance(alice.location(), stop) < 1);
+
+      AND_WHEN("that datagram arrives late") {
+        const auto stale = start + MapPoint{10, 0};
+        c.sendByDatagram(CL_MOVE_TO, makeArgs(stale.x, stale.y));
+
+        THEN("she stays where she stopped") {
+          REPEAT_FOR_MS(500) { REQUIRE(distance(alice.location(), stop) < 1); }
+        }
+      }
+    }
+  }
+}
+
+TEST_CASE("Movement by datagram counts against the movement rate limit") {
+  GIVEN("Alice may move only once, and has a datagram channel") {
+    cmdLineArgs.add("rate-limit-movement", "0");
+    auto s = TestServer{};
+    cmdLineArgs.remove("rate-limit-movement");
+    cmdLineArgs.add("datagram-channel");
+    auto c = TestClient::WithUsername("Alice");
+    cmdLineArgs.remove("datagram-channel");
+    s.waitForUsers(1);
+    WAIT_UNTIL(c.hasDatagramChannel());
+
+    WHEN("she sends two moves by datagram") {
+      const auto &alice = s.findUser("Alice");
+      const auto destination = alice.location() + MapPoint{5, 0};
+      const auto args = makeArgs(destination.x, destination.y);
+      c.sendByDatagram(CL_MOVE_TO, args);
+      c.sendByDatagram(CL_MOVE_TO, args);
+
+      THEN("the second is dropped") {
+        WAIT_UNTIL(s.messagesDroppedByRateLimit(RateLimiter::MOVEMENT) == 1);
+      }
+    }
+  }
+}
+
+TEST_CASE_METHOD(ServerAndClientWithData,
+                 "A batch of moves is simulated as a single path") {
+  GIVEN("a user who hasn't moved for a while, near the corner of a wall") {
+    useData(R"(
+      <newPlayerSpawn x="10" y="10" range="0" />
+      <terrain index="." id="grass" />
+      <list id="default" default="1" >
+        <allow id="grass" />
+      </list>
+      <size x="30" y="2" />
+      <row y= "0" terrain = ".............................." />
+      <row y= "1" terrain = ".............................." />
+      <objectType id="wall">
+        <collisionRect x="0" y="0" w="20" h="35" />
+      </objectType>
+    )");
+    server->addObject("wall", {25, 0});
+    SDL_Delay(1200);  // Enough time to walk round the corner
+
+    WHEN("moves round the corner arrive together") {
+      const auto down = Message{CL_MOVE_TO, makeArgs(10, 50)}.compile();
+      const auto across = Message{CL_MOVE_TO, makeArgs(40, 50)}.compile();
+      server->handleBufferedMessages(user->socket(), down + across);
+
+      THEN("the user reaches the far side, rather than walking into it") {
+        WAIT_UNTIL(distance(user->location(), {40, 50}) < 1);
+      }
+    }
+
+    WHEN("a move, something else, and a move back arrive together") {
+      const auto away = Message{CL_MOVE_TO, makeArgs(10, 55)}.compile();
+      const auto chat = Message{CL_SAY, "hello"}.compile();
+      const auto back = Message{CL_MOVE_TO, makeArgs(10, 10)}.compile();
+      server->handleBufferedMessages(user->socket(), away + chat + back);
+
+      THEN("the first move is simulated on its own, before the time is up") {
+        // The move back, with little time since, doesn't get far.
+        WAIT_UNTIL(user->location().y > 30);
+      }
+    }
+  }
+}
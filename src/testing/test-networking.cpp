@@ -1,8 +1,17 @@
 #include <cstdio>
+#include <thread>
 
+#include "../MessageParser.h"
+#include "../MessageSchema.h"
+#include "../OutboundQueue.h"
+#include "../ReceiveBuffer.h"
+#include "../WireProtocol.h"
 #include "../Socket.h"
+#include "../SpscQueue.h"
 #include "../curlUtil.h"
 #include "../server/ProgressLock.h"
+#include "../server/RateLimiter.h"
+#include "../server/SlotMap.h"
 #include "TestClient.h"
 #include "TestServer.h"
 #include "testing.h"
@@ -125,3 +134,589 @@ TEST_CASE("Real-world locations can be determined from IP addresses") {
   const auto result = getLocationFromIP("20.43.161.105"s);
   CHECK(result.find("\"status\":\"success\"") != std::string::npos);
 }
+
+TEST_CASE("A message split across reads is reassembled") {
+  GIVEN("a receive buffer") {
+    auto buffer = ReceiveBuffer{};
+    auto receive = [&buffer](const std::string &data) {
+      for (auto i = size_t{0}; i != data.size();) {
+        auto *space = buffer.spaceToWrite();
+        auto chunk = std::min(buffer.spaceAvailable(), data.size() - i);
+        memcpy(space, data.data() + i, chunk);
+        buffer.onBytesWritten(chunk);
+        i += chunk;
+      }
+    };
+    const auto message = Message{CL_SAY, "Hello"s}.compile();
+
+    WHEN("the first half of a message arrives") {
+      receive(message.substr(0, 4));
+
+      THEN("there are no complete messages") {
+        CHECK_FALSE(buffer.hasCompleteMessages());
+
+        AND_WHEN("the rest arrives") {
+          receive(message.substr(4));
+
+          THEN("it is a single complete message") {
+            CHECK(buffer.completeMessagesAsString() == message);
+          }
+        }
+      }
+    }
+
+    WHEN("one and a half messages arrive") {
+      receive(message + message.substr(0, 4));
+
+      THEN("only the first is complete") {
+        CHECK(buffer.completeMessagesAsString() == message);
+
+        AND_WHEN("the complete message is discarded and the rest arrives") {
+          buffer.discardCompleteMessages();
+          receive(message.substr(4));
+
+          THEN("the second message is complete") {
+            CHECK(buffer.completeMessagesAsString() == message);
+          }
+        }
+      }
+    }
+
+    WHEN("many messages arrive at once") {
+      auto burst = ""s;
+      for (auto i = 0; i != 1000; ++i) burst += message;
+      receive(burst);
+
+      THEN("they are all complete") {
+        CHECK(buffer.completeMessagesLength() == burst.size());
+      }
+    }
+
+    WHEN("a batch of messages is only partly handled") {
+      const auto other = Message{CL_PING, 5}.compile();
+      buffer.append((message + other + message).data(),
+                    message.size() * 2 + other.size());
+      auto parser = MessageParser{buffer.completeMessages(),
+                                  buffer.completeMessagesLength()};
+      parser.hasAnotherMessage();
+      parser.nextMessage();
+      buffer.discardMessages(parser.lengthUpToEndOfMessage());
+
+      THEN("the rest are kept, intact") {
+        CHECK(buffer.completeMessagesAsString() == other + message);
+      }
+    }
+  }
+}
+
+TEST_CASE("Outgoing messages are queued until flushed") {
+  GIVEN("an outbound queue with a small high-water mark") {
+    const auto message = Message{SV_SYSTEM_MESSAGE, "x"s};
+    const auto messageLength = message.compile().size();
+    auto limits = OutboundQueue::Limits{};
+    limits.highWaterMark = messageLength * 3;
+    auto queue = OutboundQueue{limits};
+
+    WHEN("two messages are queued") {
+      auto reachedHighWaterMark = queue.append(message);
+      reachedHighWaterMark = queue.append(message) || reachedHighWaterMark;
+
+      THEN("they are held, and there's no need to flush yet") {
+        CHECK(queue.bytesQueued() == messageLength * 2);
+        CHECK_FALSE(reachedHighWaterMark);
+
+        AND_WHEN("a third is queued") {
+          THEN("the queue needs to be flushed") {
+            CHECK(queue.append(message));
+
+            AND_WHEN("a fourth is queued before it has been flushed") {
+              THEN("it isn't asked for again") {
+                CHECK_FALSE(queue.append(message));
+              }
+            }
+          }
+        }
+      }
+    }
+  }
+}
+
+TEST_CASE("Clients that fall behind lose cosmetic messages, then are cut off") {
+  GIVEN("an outbound queue with small limits") {
+    const auto chat = Message{SV_SAY, makeArgs("Alice", "Hello")};
+    const auto important = Message{SV_SYSTEM_MESSAGE, "x"s};
+    const auto importantLength = important.compile().size();
+    auto limits = OutboundQueue::Limits{};
+    limits.softLimit = importantLength * 2;
+    limits.hardLimit = importantLength * 4;
+    auto queue = OutboundQueue{limits};
+
+    WHEN("it is filled past the soft limit") {
+      queue.append(important);
+      queue.append(important);
+
+      THEN("chat is dropped") {
+        queue.append(chat);
+        CHECK(queue.bytesQueued() == importantLength * 2);
+        CHECK(queue.stats().messagesShed == 1);
+      }
+
+      THEN("other messages are still queued") {
+        queue.append(important);
+        CHECK(queue.bytesQueued() == importantLength * 3);
+        CHECK_FALSE(queue.hasExceededHardLimit());
+      }
+
+      AND_WHEN("it is filled past the hard limit") {
+        queue.append(important);
+        queue.append(important);
+        queue.append(important);
+
+        THEN("the client should be disconnected") {
+          CHECK(queue.hasExceededHardLimit());
+          CHECK(queue.bytesQueued() == importantLength * 4);
+        }
+      }
+    }
+  }
+}
+
+TEST_CASE("Bulk transfers are sent a little at a time") {
+  GIVEN("a queue that sends one chunk of bulk data per flush") {
+    auto limits = OutboundQueue::Limits{};
+    limits.bulkBudget = 1;
+    auto queue = OutboundQueue{limits};
+
+    WHEN("a large map transfer is queued, followed by a combat message") {
+      const auto mapData = Message{SV_MAP_EXPLORATION_DATA,
+                                   std::string(OutboundQueue::CHUNK_SIZE, 'x')};
+      queue.append(mapData);
+      queue.append(mapData);
+      queue.append(Message{SV_ENTITY_HIT_ENTITY, makeArgs(1, 2)});
+
+      AND_WHEN("it is flushed") {
+        queue.flush(INVALID_SOCKET);
+
+        THEN("only some of the map data has been scheduled") {
+          CHECK(queue.stats().bytesDeferred == mapData.compile().size());
+        }
+      }
+    }
+  }
+
+  SECTION("Combat feedback is sent ahead of other messages") {
+    CHECK(OutboundQueue::laneOf(SV_ENTITY_HIT_ENTITY) ==
+          OutboundQueue::CRITICAL);
+    CHECK(OutboundQueue::laneOf(SV_MAP_EXPLORATION_DATA) ==
+          OutboundQueue::BULK);
+    CHECK(OutboundQueue::laneOf(SV_LOGIN_SNAPSHOT) == OutboundQueue::BULK);
+  }
+}
+
+TEST_CASE("A message for many recipients is encoded only once") {
+  GIVEN("a long message to be sent to two clients") {
+    const auto message = Message{SV_SYSTEM_MESSAGE, std::string(2000, 'x')};
+    const auto shared = SharedMessage::From(message);
+    auto alice = OutboundQueue{}, bob = OutboundQueue{};
+
+    WHEN("it is queued for both") {
+      alice.append(shared);
+      bob.append(shared);
+
+      THEN("they share a single encoding") {
+        const auto encoding = shared.encoded(TEXT_PROTOCOL);
+        CHECK(*encoding == message.compile());
+        CHECK(encoding.use_count() == 4);  // Here, the cache and two queues
+        CHECK(alice.bytesQueued() == encoding->size());
+      }
+    }
+  }
+
+  SECTION("Binary locations can't be shared, as they depend on the client") {
+    const auto shared = SharedMessage::From(
+        Message::UserLocation(SV_USER_LOCATION, "Alice", {16, 32}));
+    CHECK(shared.encoded(TEXT_PROTOCOL));
+    CHECK_FALSE(shared.encoded(BINARY_PROTOCOL));
+  }
+}
+
+TEST_CASE("Clients sending too quickly have messages ignored") {
+  GIVEN("a limit of two chat messages per second") {
+    auto rates = RateLimiter::defaultRates();
+    rates[RateLimiter::CHAT] = 2;
+    const auto burst = 2 * RateLimiter::BURST_DURATION / 1000;
+    auto limiter = RateLimiter{rates, 0};
+
+    WHEN("a client uses up its burst allowance") {
+      for (auto i = 0; i != burst; ++i)
+        CHECK(limiter.check(CL_SAY, 0) == RateLimiter::ALLOWED);
+
+      THEN("its next message is dropped, with a warning") {
+        CHECK(limiter.check(CL_SAY, 0) == RateLimiter::DROPPED_AND_WARN);
+
+        AND_THEN("further messages are dropped silently") {
+          CHECK(limiter.check(CL_WHISPER, 0) == RateLimiter::DROPPED);
+        }
+      }
+
+      THEN("other categories are unaffected") {
+        CHECK(limiter.check(CL_CRAFT, 0) == RateLimiter::ALLOWED);
+        CHECK(limiter.check(CL_PING, 0) == RateLimiter::ALLOWED);
+      }
+
+      AND_WHEN("half a second passes") {
+        THEN("it may send one more") {
+          CHECK(limiter.check(CL_SAY, 500) == RateLimiter::ALLOWED);
+          CHECK(limiter.check(CL_SAY, 500) != RateLimiter::ALLOWED);
+        }
+      }
+    }
+  }
+
+  SECTION("Excess movement is dropped without a warning") {
+    auto rates = RateLimiter::defaultRates();
+    rates[RateLimiter::MOVEMENT] = 0;
+    auto limiter = RateLimiter{rates, 0};
+    CHECK(limiter.check(CL_MOVE_TO, 0) == RateLimiter::ALLOWED);
+    CHECK(limiter.check(CL_MOVE_TO, 0) == RateLimiter::DROPPED);
+  }
+}
+
+TEST_CASE("A queue between two threads delivers everything, in order") {
+  auto queue = SpscQueue<int>{};
+  const auto NUM_VALUES = 100000;
+
+  auto producer = std::thread([&queue, NUM_VALUES]() {
+    for (auto i = 0; i != NUM_VALUES; ++i) queue.push(i);
+  });
+
+  auto valuesReceived = 0, value = 0;
+  auto allWereInOrder = true;
+  while (valuesReceived != NUM_VALUES) {
+    if (!queue.pop(value)) continue;
+    if (value != valuesReceived) allWereInOrder = false;
+    ++valuesReceived;
+  }
+  producer.join();
+
+  CHECK(allWereInOrder);
+  CHECK_FALSE(queue.pop(value));
+}
+
+TEST_CASE("Binary messages are decoded to their text equivalents") {
+  auto decoder = ServerStreamDecoder{};
+  auto encodeInBinary = [](const Message &msg) {
+    auto encoded = ""s;
+    msg.appendTo(encoded, BINARY_PROTOCOL);
+    return encoded;
+  };
+
+  SECTION("A message with text arguments") {
+    const auto message = Message{SV_SYSTEM_MESSAGE, makeArgs("Hello", 42)};
+    const auto binary = encodeInBinary(message);
+    CHECK(decoder.toText(binary.data(), binary.size()) == message.compile());
+  }
+
+  SECTION("A message with no arguments") {
+    const auto message = Message{SV_WELCOME};
+    const auto binary = encodeInBinary(message);
+    CHECK(decoder.toText(binary.data(), binary.size()) == message.compile());
+  }
+
+  SECTION("An entity's location is less than half the size") {
+    const auto serial = Serial::Generate();
+    const auto message =
+        Message::EntityLocation(SV_ENTITY_LOCATION, serial, {1234.5, 2345.25});
+    const auto binary = encodeInBinary(message);
+    CHECK(binary.size() * 2 <= message.compile().size());
+
+    // The code alone, with the location kept aside
+    CHECK(decoder.toText(binary.data(), binary.size()) ==
+          Message{SV_ENTITY_LOCATION}.compile());
+    auto decoded = DecodedLocation{};
+    REQUIRE(decoder.nextLocation(decoded));
+    CHECK(decoded.serial == serial);
+    CHECK(decoded.location == MapPoint{1234.5, 2345.25});
+    CHECK_FALSE(decoder.nextLocation(decoded));
+  }
+
+  SECTION("A user's location") {
+    const auto message =
+        Message::UserLocation(SV_USER_LOCATION, "Alice", {-10.0, 0.0625});
+    const auto binary = encodeInBinary(message);
+    CHECK(decoder.toText(binary.data(), binary.size()) ==
+          Message{SV_USER_LOCATION}.compile());
+    auto decoded = DecodedLocation{};
+    REQUIRE(decoder.nextLocation(decoded));
+    CHECK(decoded.username == "Alice");
+    CHECK(decoded.location == MapPoint{-10.0, 0.0625});
+  }
+
+  SECTION("A frame split across reads, between text messages") {
+    const auto textMessage = Message{SV_SYSTEM_MESSAGE, "x"s}.compile();
+    const auto binaryMessage =
+        Message::UserLocation(SV_USER_LOCATION, "Alice", {1.0, 2.0});
+    const auto stream =
+        textMessage + encodeInBinary(binaryMessage) + textMessage;
+
+    auto decoded = decoder.toText(stream.data(), 5);
+    decoded += decoder.toText(stream.data() + 5, stream.size() - 5);
+
+    CHECK(decoded ==
+          textMessage + Message{SV_USER_LOCATION}.compile() + textMessage);
+    auto location = DecodedLocation{};
+    CHECK(decoder.nextLocation(location));
+  }
+}
+
+TEST_CASE("Movement is sent as deltas, with periodic keyframes") {
+  auto baselines = LocationBaselines{};
+  auto decoder = ServerStreamDecoder{};
+  const auto serial = Serial::Generate();
+  auto encode = [&](const MapPoint &location) {
+    auto encoded = ""s;
+    Message::EntityLocation(SV_ENTITY_LOCATION, serial, location)
+        .appendTo(encoded, BINARY_PROTOCOL, &baselines);
+    return encoded;
+  };
+  auto decode = [&](const std::string &encoded) {
+    decoder.toText(encoded.data(), encoded.size());
+    auto decoded = DecodedLocation{};
+    decoder.nextLocation(decoded);
+    return decoded.location;
+  };
+
+  GIVEN("an entity's first location has been sent") {
+    const auto first = encode({1000, 1000});
+    CHECK(decode(first) == MapPoint{1000, 1000});
+
+    WHEN("it moves a little") {
+      const auto second = encode({1001.5, 999.25});
+
+      THEN("the update is smaller, and decodes to the new location") {
+        CHECK(second.size() < first.size());
+        CHECK(decode(second) == MapPoint{1001.5, 999.25});
+      }
+    }
+
+    WHEN("it keeps moving") {
+      auto sizes = std::vector<size_t>{};
+      for (auto i = 1; i <= LocationBaselines::KEYFRAME_INTERVAL + 1; ++i) {
+        const auto location = MapPoint{1000.0 + i, 1000};
+        const auto update = encode(location);
+        sizes.push_back(update.size());
+        REQUIRE(decode(update) == location);
+      }
+
+      THEN("an absolute keyframe is sent periodically") {
+        CHECK(sizes.back() == first.size());
+        CHECK(sizes.front() < first.size());
+      }
+    }
+  }
+}
+
+TEST_CASE("Clients request a wire protocol along with their version") {
+  SECTION("Old clients get the text protocol") {
+    auto version = "1.0"s;
+    const auto request = extractProtocolRequest(version);
+    CHECK(request.protocol == TEXT_PROTOCOL);
+    CHECK_FALSE(request.compression);
+    CHECK(version == "1.0");
+  }
+
+  SECTION("A request for the binary protocol is recognised and removed") {
+    auto request = ProtocolRequest{};
+    request.protocol = BINARY_PROTOCOL;
+    auto version = versionWithProtocolRequest("1.0", request);
+    CHECK(extractProtocolRequest(version).protocol == BINARY_PROTOCOL);
+    CHECK(version == "1.0");
+  }
+
+  SECTION("Compression can be requested too") {
+    auto request = ProtocolRequest{};
+    request.protocol = BINARY_PROTOCOL;
+    request.compression = true;
+    auto version = versionWithProtocolRequest("1.0", request);
+    const auto extracted = extractProtocolRequest(version);
+    CHECK(extracted.protocol == BINARY_PROTOCOL);
+    CHECK(extracted.compression);
+    CHECK(version == "1.0");
+  }
+}
+
+TEST_CASE("Messages are parsed in place") {
+  auto parse = [](const std::string &messages) {
+    return MessageParser{messages.data(), messages.size()};
+  };
+
+  SECTION("Numbers and strings") {
+    const auto messages =
+        Message{CL_SAY, makeArgs(42, 1.5, "Hello", Serial::Gear())}.compile();
+    auto parser = parse(messages);
+    REQUIRE(parser.hasAnotherMessage());
+    CHECK(parser.nextMessage() == CL_SAY);
+
+    auto integer = 0;
+    auto decimal = 0.0;
+    auto text = ""s;
+    auto serial = Serial{};
+    REQUIRE(parser.readArgs(integer, decimal, text, serial));
+    CHECK(integer == 42);
+    CHECK(decimal == 1.5);
+    CHECK(text == "Hello");
+    CHECK(serial.isGear());
+  }
+
+  SECTION("The last string contains the rest of the message") {
+    const auto messages = Message{CL_SAY, makeArgs("a", "b", "c")}.compile();
+    auto parser = parse(messages);
+    parser.hasAnotherMessage();
+    parser.nextMessage();
+
+    auto first = ""s, rest = ""s;
+    REQUIRE(parser.readArgs(first, rest));
+    CHECK(rest == makeArgs("b", "c"));
+  }
+
+  SECTION("Malformed arguments are rejected") {
+    const auto messages = Message{CL_SAY, makeArgs(1, "x")}.compile();
+    auto parser = parse(messages);
+    parser.hasAnotherMessage();
+    parser.nextMessage();
+
+    auto a = 0, b = 0;
+    CHECK_FALSE(parser.readArgs(a, b));
+  }
+
+  SECTION("An unread message is skipped") {
+    const auto messages = Message{CL_SAY, "unread"s}.compile() +
+                          Message{CL_PING, 5}.compile() +
+                          Message{CL_SAY}.compile().substr(0, 3);
+    auto parser = parse(messages);
+    parser.hasAnotherMessage();
+    parser.nextMessage();
+
+    REQUIRE(parser.hasAnotherMessage());
+    CHECK(parser.nextMessage() == CL_PING);
+
+    AND_THEN("an incomplete message is left unparsed") {
+      CHECK_FALSE(parser.hasAnotherMessage());
+      CHECK(parser.lengthParsed() == messages.size() - 3);
+    }
+  }
+}
+
+TEST_CASE("Messages with a schema are read as they were built") {
+  const auto messages =
+      MessageSchema<SV_PLAYER_HIT_ENTITY>::build("Alice", Serial::Gear())
+          .compile();
+  auto parser = MessageParser{messages.data(), messages.size()};
+  REQUIRE(parser.hasAnotherMessage());
+  REQUIRE(parser.nextMessage() == SV_PLAYER_HIT_ENTITY);
+
+  auto username = ""s;
+  auto serial = Serial{};
+  REQUIRE(MessageSchema<SV_PLAYER_HIT_ENTITY>::read(parser, username, serial));
+  CHECK(username == "Alice");
+  CHECK(serial.isGear());
+
+  SECTION("The arguments are those makeArgs() would produce") {
+    CHECK(MessageSchema<SV_PLAYER_HIT_ENTITY>::build("Alice", Serial::Gear())
+              .args == makeArgs("Alice", Serial::Gear()));
+  }
+}
+
+TEST_CASE("Messages with repeated fields are read as they were built") {
+  using Schema = MessageSchema<SV_PLAYER_VITALS>;
+  auto builder = Schema::Builder{"Alice"};
+  builder.add(SV_PLAYER_HEALTH, 5);
+  builder.add(SV_MAX_ENERGY, 20);
+  CHECK(builder.numGroups() == 2);
+  const auto messages = builder.build().compile();
+
+  auto parser = MessageParser{messages.data(), messages.size()};
+  REQUIRE(parser.hasAnotherMessage());
+  REQUIRE(parser.nextMessage() == SV_PLAYER_VITALS);
+  auto username = ""s;
+  REQUIRE(Schema::readLeadingFields(parser, username));
+  CHECK(username == "Alice");
+
+  auto vital = 0;
+  auto value = unsigned{};
+  REQUIRE(Schema::readNextGroup(parser, vital, value));
+  CHECK(vital == SV_PLAYER_HEALTH);
+  CHECK(value == 5);
+  REQUIRE(Schema::readNextGroup(parser, vital, value));
+  CHECK(vital == SV_MAX_ENERGY);
+  CHECK(value == 20);
+  CHECK_FALSE(Schema::readNextGroup(parser, vital, value));
+}
+
+TEST_CASE("A compressed stream is decoded") {
+  if (!isCompressionAvailable()) return;
+
+  GIVEN("a stream that switches to compression after its first message") {
+    const auto message = Message{SV_SYSTEM_MESSAGE, "Hello"s}.compile();
+    auto uncompressed = ""s;
+    for (auto i = 0; i != 100; ++i) uncompressed += message;
+
+    auto compressed = ""s;
+    auto compressor = StreamCompressor{};
+    compressor.compress(uncompressed.data(), uncompressed.size(), compressed);
+    const auto stream = message + MSG_START_COMPRESSION + compressed;
+
+    THEN("the compressed part is much smaller") {
+      CHECK(compressed.size() * 5 < uncompressed.size());
+    }
+
+    WHEN("it arrives in small pieces") {
+      auto decoder = ServerStreamDecoder{};
+      auto decoded = ""s;
+      for (auto i = size_t{0}; i < stream.size(); i += 7)
+        decoded += decoder.toText(stream.data() + i,
+                                  std::min<size_t>(7, stream.size() - i));
+
+      THEN("the decoder produces all of the original messages") {
+        CHECK(decoded == message + uncompressed);
+      }
+    }
+  }
+}
+
+TEST_CASE("A handle to a departed user finds nothing") {
+  GIVEN("a user who has gone, and another who took their slot") {
+    auto users = SlotMap<std::string>{};
+    const auto alice = users.emplace("Alice");
+    users.erase(alice);
+    const auto bob = users.emplace("Bob");
+
+    THEN("Alice's handle finds nothing") { CHECK(!users.find(alice)); }
+
+    THEN("Bob is found, in the reused slot") {
+      REQUIRE(users.find(bob));
+      CHECK(*users.find(bob) == "Bob");
+      CHECK(bob.index == alice.index);
+    }
+
+    THEN("only Bob is visited") {
+      auto names = std::vector<std::string>{};
+      for (const auto &name : users) names.push_back(name);
+      CHECK(names == std::vector<std::string>{"Bob"});
+    }
+  }
+
+  GIVEN("three users") {
+    auto users = SlotMap<std::string>{};
+    users.emplace("Alice");
+    users.emplace("Bob");
+    users.emplace("Charlie");
+
+    WHEN("each is removed while they are being iterated over") {
+      for (auto it = users.begin(); it != users.end(); ++it)
+        users.erase(it.handle());
+
+      THEN("none are left") { CHECK(users.empty()); }
+    }
+  }
+}
@@ -598,3 +598,31 @@ TEST_CASE_METHOD(TwoClientsWithData, "Newly built hidden objects are hidden") {
     }
   }
 }
+
+TEST_CASE_METHOD(ServerAndClientWithData,
+                 "An object's introduction is rebuilt only when it changes") {
+  GIVEN("an object") {
+    useData(R"(
+      <objectType id="chair" />
+    )");
+    auto &chair = server->addObject("chair", {10, 10});
+
+    WHEN("its introduction is needed twice") {
+      const auto first =
+          chair.introduction().front().encoded(TEXT_PROTOCOL).get();
+      const auto second =
+          chair.introduction().front().encoded(TEXT_PROTOCOL).get();
+
+      THEN("it was encoded only once") { CHECK(first == second); }
+    }
+
+    WHEN("it is given an owner") {
+      const auto numMessagesBefore = chair.introduction().size();
+      chair.permissions.setPlayerOwner("Alice");
+
+      THEN("its introduction includes the owner") {
+        CHECK(chair.introduction().size() == numMessagesBefore + 1);
+      }
+    }
+  }
+}
@@ -518,6 +518,24 @@ TEST_CASE_METHOD(ServerAndClient, "Health regen", "[stats]") {
   }
 }
 
+TEST_CASE_METHOD(ServerAndClient, "Rapid changes to health are sent together",
+                 "[stats]") {
+  WHEN("a user is damaged many times in quick succession") {
+    const auto messagesBefore = client->numMessagesReceived(SV_PLAYER_VITALS);
+    for (auto i = 0; i != 20; ++i) user->reduceHealth(1);
+
+    THEN("the client learns the final health") {
+      WAIT_UNTIL(client->character().health() == user->health());
+
+      AND_THEN("it wasn't told about every change") {
+        const auto messagesAfter =
+            client->numMessagesReceived(SV_PLAYER_VITALS);
+        CHECK(messagesAfter - messagesBefore < 20);
+      }
+    }
+  }
+}
+
 TEST_CASE("Regen display", "[stats][ui]") {
   StatsMod stats;
   CHECK(stats.toStrings().empty());
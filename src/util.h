@@ -1,14 +1,18 @@
 #ifndef UTIL_H
 #define UTIL_H
 
+#include <charconv>
 #include <cstdlib>
 #include <set>
 #include <sstream>
+#include <string_view>
+#include <type_traits>
 #include <vector>
 
 #include "Color.h"
 #include "Point.h"
 #include "Rect.h"
+#include "Serial.h"
 #include "combatTypes.h"
 #include "messageCodes.h"
 
@@ -63,64 +67,47 @@ std::string toString(T val) {
   return oss.str();
 }
 
-template <typename T1>
-std::string makeArgs(T1 val1) {
-  return toString(val1);
-}
-
-template <typename T1, typename T2>
-std::string makeArgs(T1 val1, T2 val2) {
-  std::ostringstream oss;
-  oss << makeArgs(val1) << MSG_DELIM << val2;
-  return oss.str();
-}
-
-template <typename T1, typename T2, typename T3>
-std::string makeArgs(T1 val1, T2 val2, T3 val3) {
-  std::ostringstream oss;
-  oss << makeArgs(val1, val2) << MSG_DELIM << val3;
-  return oss.str();
-}
-
-template <typename T1, typename T2, typename T3, typename T4>
-std::string makeArgs(T1 val1, T2 val2, T3 val3, T4 val4) {
-  std::ostringstream oss;
-  oss << makeArgs(val1, val2, val3) << MSG_DELIM << val4;
-  return oss.str();
-}
-
-template <typename T1, typename T2, typename T3, typename T4, typename T5>
-std::string makeArgs(T1 val1, T2 val2, T3 val3, T4 val4, T5 val5) {
-  std::ostringstream oss;
-  oss << makeArgs(val1, val2, val3, val4) << MSG_DELIM << val5;
-  return oss.str();
-}
-
-template <typename T1, typename T2, typename T3, typename T4, typename T5,
-          typename T6>
-std::string makeArgs(T1 val1, T2 val2, T3 val3, T4 val4, T5 val5, T6 val6) {
+template <typename T>
+void streamArg(std::string &args, const T &val) {
   std::ostringstream oss;
-  oss << makeArgs(val1, val2, val3, val4, val5) << MSG_DELIM << val6;
-  return oss.str();
+  oss << val;
+  args.append(oss.str());
 }
 
-template <typename T1, typename T2, typename T3, typename T4, typename T5,
-          typename T6, typename T7>
-std::string makeArgs(T1 val1, T2 val2, T3 val3, T4 val4, T5 val5, T6 val6,
-                     T7 val7) {
-  std::ostringstream oss;
-  oss << makeArgs(val1, val2, val3, val4, val5, val6) << MSG_DELIM << val7;
-  return oss.str();
+// Message arguments are appended to a single buffer.  Integers are formatted
+// without a stream; anything else is streamed, as toString() would.
+template <typename T>
+void appendArg(std::string &args, const T &val) {
+  if constexpr (std::is_same_v<T, bool>)
+    args.push_back(val ? '1' : '0');
+  else if constexpr (std::is_same_v<T, char> ||
+                     std::is_same_v<T, signed char> ||
+                     std::is_same_v<T, unsigned char>)
+    args.push_back(static_cast<char>(val));
+  else if constexpr (std::is_integral_v<T>) {
+    char digits[24];
+    const auto result = std::to_chars(digits, digits + sizeof(digits), val);
+    args.append(digits, result.ptr);
+  } else if constexpr (std::is_same_v<T, Serial>)
+    appendArg(args, val.asNumber());
+  else if constexpr (std::is_enum_v<T>) {
+    using Underlying = std::underlying_type_t<T>;
+    if constexpr (std::is_convertible_v<T, Underlying>)
+      appendArg(args, +static_cast<Underlying>(val));
+    else
+      streamArg(args, val);  // Scoped, so it may have its own operator<<
+  } else if constexpr (std::is_convertible_v<const T &, std::string_view>)
+    args.append(std::string_view{val});
+  else
+    streamArg(args, val);
 }
 
-template <typename T1, typename T2, typename T3, typename T4, typename T5,
-          typename T6, typename T7, typename T8>
-std::string makeArgs(T1 val1, T2 val2, T3 val3, T4 val4, T5 val5, T6 val6,
-                     T7 val7, T8 val8) {
-  std::ostringstream oss;
-  oss << makeArgs(val1, val2, val3, val4, val5, val6, val7) << MSG_DELIM
-      << val8;
-  return oss.str();
+template <typename T, typename... Ts>
+std::string makeArgs(const T &first, const Ts &... rest) {
+  auto args = std::string{};
+  appendArg(args, first);
+  ((args.push_back(MSG_DELIM), appendArg(args, rest)), ...);
+  return args;
 }
 
 #undef min